@@ -0,0 +1,228 @@
+// Microbenchmarks of the ECS, so that changes to it can be measured
+// against the previous version. Every benchmark runs a few times on a
+// fresh world and reports the fastest run, which is the least disturbed
+// by the rest of the system.
+// NOTE: Usage: ecs_benchmark [number of entities]
+
+#include "ECS/CommandBuffer.h"
+#include "ECS/ECS.h"
+#include "ECS/SystemScheduler.h"
+#include "ECS/TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace SR;
+
+GLOBAL constexpr uint32_t NUM_RUNS = 5;
+GLOBAL constexpr uint32_t DEFAULT_NUM_ENTITIES = 200000;
+
+GLOBAL volatile float g_Sink = 0.0f; // NOTE: Keeps the compiler from removing the loops that only read
+
+using Clock = std::chrono::steady_clock;
+
+INTERNAL double elapsed_ms(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Runs `setup` and then `function` on a fresh world NUM_RUNS times, only
+// `function` is timed
+INTERNAL void run_benchmark(const char* name, uint32_t numEntities, const std::function<void()>& setup, const std::function<void()>& function) {
+	double best = 0.0;
+
+	for (uint32_t run = 0; run < NUM_RUNS; ++run) {
+		ECS::destroy();
+		ECS::initialize();
+		setup();
+
+		const Clock::time_point start = Clock::now();
+		function();
+		const double milliseconds = elapsed_ms(start);
+
+		best = run == 0 ? milliseconds : std::min(best, milliseconds);
+	}
+
+	std::printf("%-44s %10.3f ms %10.1f ns/entity\n", name, best, 1e6 * best / numEntities);
+}
+
+// Entities with a Transform, a Renderable and a Material, added one at a
+// time, the way the scenes are built
+INTERNAL void create_scene_entities(uint32_t count, std::vector<entity_id>& entities) {
+	for (uint32_t i = 0; i < count; ++i) {
+		const entity_id entity = ECS::create_entity();
+		ECS::get_component<Transform>(entity)->position.x = static_cast<float>(i);
+		ECS::add_component<Renderable>(entity, Renderable{});
+		ECS::add_component<Material>(entity, Material{});
+		entities.push_back(entity);
+	}
+}
+
+int main(int argc, char** argv) {
+	const uint32_t numEntities = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : DEFAULT_NUM_ENTITIES;
+
+	if (numEntities == 0) {
+		std::fprintf(stderr, "Usage: ecs_benchmark [number of entities]\n");
+		return 1;
+	}
+
+	std::printf("%u entities, fastest of %u runs\n\n", numEntities, NUM_RUNS);
+
+	std::vector<entity_id> entities = {};
+	entities.reserve(numEntities);
+	std::vector<entity_id> shuffled = {};
+	std::vector<Transform> transforms(numEntities);
+	uint32_t version = 0;
+
+	// -------------------------------- Creation --------------------------------
+	run_benchmark("create_entity + add_component x2", numEntities, [&]() {
+		entities.clear();
+	}, [&]() {
+		create_scene_entities(numEntities, entities);
+	});
+
+	run_benchmark("create_entities", numEntities, [&]() {
+		entities.clear();
+	}, [&]() {
+		ECS::create_entities(numEntities, entities);
+	});
+
+	run_benchmark("instantiate (prefab, per-entity transforms)", numEntities, [&]() {
+		entities.clear();
+	}, [&]() {
+		ECS::Prefab prefab = {};
+		prefab.set_component(Renderable{}).set_component(Material{});
+		ECS::instantiate(prefab, numEntities, transforms, entities);
+	});
+
+	run_benchmark("CommandBuffer record + playback", numEntities, []() {}, [&]() {
+		ECS::CommandBuffer commands = {};
+
+		for (uint32_t i = 0; i < numEntities; ++i) {
+			const entity_id placeholder = commands.create_entity();
+			commands.add_component<Material>(placeholder, Material{});
+		}
+
+		commands.playback();
+	});
+
+	// --------------------------------- Access ---------------------------------
+	run_benchmark("get_component x3, random order", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+		shuffled = entities;
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+	}, [&]() {
+		float sum = 0.0f;
+
+		for (entity_id entity : shuffled) {
+			sum += ECS::read_component<Transform>(entity)->position.x;
+			sum += ECS::read_component<Material>(entity)->roughness;
+			sum += ECS::read_component<Renderable>(entity)->model != nullptr ? 1.0f : 0.0f;
+		}
+
+		g_Sink = sum;
+	});
+
+	run_benchmark("view<Transform, Renderable, Material>", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+	}, [&]() {
+		float sum = 0.0f;
+
+		ECS::view<const Transform, const Renderable, const Material>().for_each([&sum](entity_id, const Transform& transform, const Renderable& renderable, const Material& material) {
+			sum += transform.position.x + material.roughness + (renderable.model != nullptr ? 1.0f : 0.0f);
+		});
+
+		g_Sink = sum;
+	});
+
+	run_benchmark("SystemScheduler, one chunk system", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+	}, [&]() {
+		ECS::SystemScheduler scheduler = {};
+		ECS::System* system = scheduler.add_system("Move");
+		system->add_write<Transform>();
+		system->set_chunk_callback([](const ECS::ChunkView& chunk, float dt) {
+			Transform* transforms = chunk.get<Transform>();
+
+			for (uint32_t i = 0; i < chunk.count; ++i) {
+				transforms[i].position.y += dt;
+			}
+		});
+
+		scheduler.run(1.0f);
+	});
+
+	run_benchmark("get_changed_entities<Transform>, 1% changed", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+		version = ECS::advance_version();
+
+		for (uint32_t i = 0; i < numEntities; i += 100) {
+			ECS::get_component<Transform>(entities[i])->position.y = 1.0f;
+		}
+
+		shuffled.clear();
+	}, [&]() {
+		ECS::get_changed_entities<Transform>(version, shuffled);
+	});
+
+	// -------------------------------- Hierarchy -------------------------------
+	// NOTE: Every entity but the first of each group of 8 has the previous
+	// one as its parent, so the hierarchy is 8 levels deep
+	const auto create_hierarchy = [&]() {
+		entities.clear();
+		ECS::create_entities(numEntities, entities);
+
+		for (uint32_t i = 0; i < numEntities; ++i) {
+			ECS::get_component<Transform>(entities[i])->position.x = 1.0f;
+
+			if (i % 8 != 0) {
+				ECS::add_component<Parent>(entities[i], Parent{ entities[i - 1] });
+			}
+		}
+	};
+
+	run_benchmark("update_world_transforms, rebuild", numEntities, create_hierarchy, []() {
+		ECS::update_world_transforms();
+	});
+
+	run_benchmark("update_world_transforms, 1% changed", numEntities, [&]() {
+		create_hierarchy();
+		ECS::update_world_transforms();
+
+		for (uint32_t i = 0; i < numEntities; i += 100) {
+			ECS::get_component<Transform>(entities[i])->position.y = 1.0f;
+		}
+	}, []() {
+		ECS::update_world_transforms();
+	});
+
+	// -------------------------------- Deletion --------------------------------
+	run_benchmark("destroy_entity", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+	}, [&]() {
+		for (entity_id entity : entities) {
+			ECS::destroy_entity(entity);
+		}
+	});
+
+	run_benchmark("destroy_entities", numEntities, [&]() {
+		entities.clear();
+		create_scene_entities(numEntities, entities);
+	}, [&]() {
+		ECS::destroy_entities(entities);
+	});
+
+	ECS::destroy();
+
+	return 0;
+}
@@ -0,0 +1,517 @@
+// NOTE: Requires bindless.glsl, light_bvh.glsl, ray_payload.glsl,
+// ray_tracing_math.glsl, visibility.glsl and GL_EXT_shader_atomic_float, and
+// has to be included after `rayPayload` and `g_PushConstants`.
+//
+// Bidirectional path tracing with MIS over all connection strategies. Every
+// camera sample traces its own light subpath, whose vertices are connected to
+// the camera (light tracing, splatted into the light film) and to every
+// vertex of the camera subpath. MIS weights use the recursive dVCM and dVC
+// quantities from "Implementing Vertex Connection and Merging" by Georgiev
+// (2012), with vertex merging disabled and the balance heuristic.
+//
+// Surfaces are approximated by a Lambertian lobe and an ideal mirror, see
+// query_surface() in the closest hit shader. Mirrors can't be connected to,
+// so caustics seen through them are found by light tracing instead.
+
+const uint INTEGRATOR_PATH_TRACING = 0;
+const uint INTEGRATOR_BIDIRECTIONAL = 1;
+const uint BDPT_MAX_LIGHT_VERTICES = 8;
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) buffer LightFilm {
+    float values[]; // NOTE: RGB per pixel, summed over all light subpaths since the last reset
+} g_LightFilms[];
+
+struct BDPTSurface {
+    vec3 pos;
+    vec3 normal; // NOTE: Faces the side the path arrived from
+    vec3 dirFix; // NOTE: Direction towards the previous path vertex
+    vec3 color; // NOTE: Albedo, or emission for lights
+    float specularProbability;
+    float area; // NOTE: Lights only
+    bool isLight;
+};
+
+struct BDPTPathState {
+    vec3 origin;
+    vec3 dir;
+    vec3 throughput;
+    uint pathLength; // NOTE: Number of segments
+    float dVCM;
+    float dVC;
+};
+
+struct BDPTLightVertex {
+    BDPTSurface surface;
+    vec3 throughput;
+    uint pathLength;
+    float dVCM;
+    float dVC;
+};
+
+struct BDPTCamera {
+    vec3 pos;
+    vec3 forward;
+    float imagePlaneDist; // NOTE: In pixels, so that a pixel has unit area
+    mat4 viewProjection;
+};
+
+BDPTCamera bdpt_camera() {
+    const mat4 invViewProjection = g_PerFrameData[g_PushConstants.frameIndex].invViewProjection;
+    const vec4 nearCenter = invViewProjection * vec4(0.0, 0.0, 0.0, 1.0);
+    const vec4 farCenter = invViewProjection * vec4(0.0, 0.0, 1.0, 1.0);
+    const mat4 projection = g_PerFrameData[g_PushConstants.frameIndex].projectionMatrix;
+
+    BDPTCamera camera;
+    camera.pos = g_PerFrameData[g_PushConstants.frameIndex].cameraPosition;
+    camera.forward = normalize(farCenter.xyz / farCenter.w - nearCenter.xyz / nearCenter.w);
+    camera.imagePlaneDist = 0.5 * float(gl_LaunchSizeEXT.y) * abs(projection[1][1]);
+    camera.viewProjection = projection * g_PerFrameData[g_PushConstants.frameIndex].viewMatrix;
+
+    return camera;
+}
+
+float bdpt_light_subpath_count() {
+    return float(gl_LaunchSizeEXT.x * gl_LaunchSizeEXT.y);
+}
+
+// Traces the next segment of a subpath. On a miss, `surface.color` holds the
+// sky color and false is returned.
+bool bdpt_trace(BDPTPathState state, out BDPTSurface surface, out float dist) {
+    rayPayload.isPrimaryRay = false;
+    rayPayload.isSurfaceQuery = true;
+
+    traceRayEXT(g_TLAS, gl_RayFlagsNoneEXT, 0xFF, 0, 0, 0, state.origin, 0.001, state.dir, 10000.0, 0);
+
+    surface.color = rayPayload.color;
+    dist = rayPayload.distance;
+
+    if (rayPayload.distance < 0.0) {
+        return false;
+    }
+
+    surface.pos = state.origin + rayPayload.distance * state.dir;
+    surface.dirFix = -state.dir;
+    surface.normal = dot(rayPayload.scatterDir, surface.dirFix) < 0.0 ? -rayPayload.scatterDir : rayPayload.scatterDir;
+    surface.specularProbability = rayPayload.specularProbability;
+    surface.area = rayPayload.surfaceArea;
+    surface.isLight = !rayPayload.isScattered;
+
+    return true;
+}
+
+// Accounts for the segment that was just traced. Returns false for hits that
+// can't continue the path.
+bool bdpt_update_at_hit(inout BDPTPathState state, BDPTSurface surface, float dist) {
+    const float cosFix = dot(surface.normal, surface.dirFix);
+
+    if (cosFix <= 1e-6) {
+        return false;
+    }
+
+    state.dVCM *= dist * dist;
+    state.dVCM /= cosFix;
+    state.dVC /= cosFix;
+
+    return true;
+}
+
+bool bdpt_is_delta(BDPTSurface surface) {
+    return surface.specularProbability >= 1.0;
+}
+
+// Lambertian lobe for scattering from `surface.dirFix` into `wo`, along with
+// the pdfs of sampling `wo` (dir) and of sampling `dirFix` from `wo` (rev).
+// NOTE: The mirror lobe is zero for any direction that wasn't sampled.
+vec3 bdpt_evaluate_bsdf(BDPTSurface surface, vec3 wo, out float cosOut, out float dirPdfW, out float revPdfW) {
+    const float diffuseProbability = 1.0 - surface.specularProbability;
+    const float cosIn = dot(surface.normal, surface.dirFix);
+    cosOut = dot(surface.normal, wo);
+
+    if (cosOut <= 0.0 || cosIn <= 0.0 || diffuseProbability <= 0.0) {
+        dirPdfW = 0.0;
+        revPdfW = 0.0;
+        return vec3(0.0);
+    }
+
+    dirPdfW = diffuseProbability * cosOut / PI;
+    revPdfW = diffuseProbability * cosIn / PI;
+
+    return diffuseProbability * surface.color / PI;
+}
+
+bool bdpt_sample_scattering(BDPTSurface surface, inout BDPTPathState state, inout uint rngSeed) {
+    vec3 dir;
+
+    if (RandomFloat(rngSeed) < surface.specularProbability) {
+        // NOTE: The mirror pdfs are the same in both directions and cancel out
+        dir = reflect(-surface.dirFix, surface.normal);
+
+        state.dVCM = 0.0;
+        state.dVC *= dot(surface.normal, dir);
+    }
+    else {
+        dir = normalize(surface.normal + normalize(RandomInUnitSphere(rngSeed)));
+
+        const float diffuseProbability = 1.0 - surface.specularProbability;
+        const float cosOut = dot(surface.normal, dir);
+        const float dirPdfW = diffuseProbability * cosOut / PI;
+        const float revPdfW = diffuseProbability * dot(surface.normal, surface.dirFix) / PI;
+
+        if (dirPdfW <= 0.0) {
+            return false;
+        }
+
+        state.dVC = (cosOut / dirPdfW) * (state.dVC * revPdfW + state.dVCM);
+        state.dVCM = 1.0 / dirPdfW;
+    }
+
+    // NOTE: Either lobe is picked with the probability it is weighted by
+    state.throughput *= surface.color;
+    state.origin = surface.pos;
+    state.dir = dir;
+
+    return true;
+}
+
+// Picks a light proportional to its power. NOTE: Unlike the light BVH, this
+// doesn't depend on the receiving point, which the MIS weights rely on.
+uint bdpt_pick_light(float u, out float pickProbability) {
+    const uint trianglesIndex = g_PushConstants.lightTrianglesIndex;
+    uint first = 0;
+    uint last = g_LightTriangles[trianglesIndex].lights.length() - 1;
+
+    while (first < last) {
+        const uint middle = (first + last) / 2;
+
+        if (u < g_LightTriangles[trianglesIndex].lights[middle].cdf) {
+            last = middle;
+        }
+        else {
+            first = middle + 1;
+        }
+    }
+
+    pickProbability = g_LightTriangles[trianglesIndex].lights[first].pickProbability;
+    return first;
+}
+
+// Probability of bdpt_pick_light() returning a light that was hit by a ray
+float bdpt_light_pick_probability(BDPTSurface light) {
+    const float luminance = dot(light.color, vec3(0.2126, 0.7152, 0.0722));
+    const float totalPower = g_LightBVHNodes[g_PushConstants.lightBVHNodesIndex].nodes[0].power;
+
+    return 2.0 * PI * light.area * luminance / totalPower;
+}
+
+void bdpt_generate_light_sample(out BDPTPathState state, inout uint rngSeed) {
+    float pickProbability;
+    const uint lightIndex = bdpt_pick_light(RandomFloat(rngSeed), pickProbability);
+    const LightTriangle light = g_LightTriangles[g_PushConstants.lightTrianglesIndex].lights[lightIndex];
+
+    // Two-sided emitter, so pick a side before sampling a cosine weighted
+    // direction around it
+    vec3 normal = light_triangle_normal(light);
+
+    if (RandomFloat(rngSeed) < 0.5) {
+        normal = -normal;
+    }
+
+    const vec3 dir = normalize(normal + normalize(RandomInUnitSphere(rngSeed)));
+    const float cosLight = max(dot(normal, dir), 1e-6);
+
+    const float directPdfA = pickProbability / light.area;
+    const float emissionPdfW = directPdfA * 0.5 * cosLight / PI;
+
+    state.origin = sample_light_triangle(light, vec2(RandomFloat(rngSeed), RandomFloat(rngSeed)));
+    state.dir = dir;
+    state.throughput = light.emission * cosLight / emissionPdfW;
+    state.pathLength = 1;
+    state.dVCM = directPdfA / emissionPdfW;
+    state.dVC = cosLight / emissionPdfW;
+}
+
+void bdpt_generate_camera_sample(vec3 origin, vec3 dir, BDPTCamera camera, out BDPTPathState state) {
+    const float cosAtCamera = dot(camera.forward, dir);
+    const float imagePointToCameraDist = camera.imagePlaneDist / cosAtCamera;
+    const float cameraPdfW = imagePointToCameraDist * imagePointToCameraDist / cosAtCamera;
+
+    state.origin = origin;
+    state.dir = dir;
+    state.throughput = vec3(1.0);
+    state.pathLength = 1;
+    state.dVCM = bdpt_light_subpath_count() / cameraPdfW;
+    state.dVC = 0.0;
+}
+
+void bdpt_splat(ivec2 pixel, vec3 value) {
+    if (any(isnan(value)) || any(isinf(value))) {
+        return;
+    }
+
+    const uint offset = 3 * (uint(pixel.y) * gl_LaunchSizeEXT.x + uint(pixel.x));
+
+    atomicAdd(g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 0], value.r);
+    atomicAdd(g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 1], value.g);
+    atomicAdd(g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 2], value.b);
+}
+
+vec3 bdpt_light_film(ivec2 pixel) {
+    const uint offset = 3 * (uint(pixel.y) * gl_LaunchSizeEXT.x + uint(pixel.x));
+
+    return vec3(
+        g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 0],
+        g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 1],
+        g_LightFilms[g_PushConstants.lightFilmIndex].values[offset + 2]
+    );
+}
+
+// Light tracing: connects a light subpath vertex to the camera and splats
+// the contribution into the pixel it lands in
+void bdpt_connect_to_camera(BDPTSurface surface, BDPTPathState state, BDPTCamera camera) {
+    const vec4 clip = camera.viewProjection * vec4(surface.pos, 1.0);
+
+    if (clip.w <= 0.0) {
+        return;
+    }
+
+    vec2 ndc = clip.xy / clip.w;
+    ndc.y *= -1.0;
+
+    const ivec2 pixel = ivec2(floor((ndc * 0.5 + 0.5) * vec2(gl_LaunchSizeEXT.xy)));
+
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, ivec2(gl_LaunchSizeEXT.xy)))) {
+        return;
+    }
+
+    const vec3 toCamera = camera.pos - surface.pos;
+    const float dist2 = dot(toCamera, toCamera);
+    const float dist = sqrt(dist2);
+    const vec3 wo = toCamera / dist;
+
+    float cosToCamera;
+    float dirPdfW;
+    float revPdfW;
+    const vec3 bsdf = bdpt_evaluate_bsdf(surface, wo, cosToCamera, dirPdfW, revPdfW);
+    const float cosAtCamera = dot(camera.forward, -wo);
+
+    if (dirPdfW <= 0.0 || cosAtCamera <= 0.0) {
+        return;
+    }
+
+    // Pdf of the camera generating a primary ray through this point, as an
+    // area density on the surface
+    const float imagePointToCameraDist = camera.imagePlaneDist / cosAtCamera;
+    const float imageToSolidAngleFactor = imagePointToCameraDist * imagePointToCameraDist / cosAtCamera;
+    const float imageToSurfaceFactor = imageToSolidAngleFactor * cosToCamera / dist2;
+    const float lightSubpathCount = bdpt_light_subpath_count();
+
+    const float wLight = (imageToSurfaceFactor / lightSubpathCount) * (state.dVCM + state.dVC * revPdfW);
+    const float misWeight = 1.0 / (wLight + 1.0);
+
+    if (!is_visible(surface.pos, wo, dist)) {
+        return;
+    }
+
+    bdpt_splat(pixel, misWeight * state.throughput * bsdf * imageToSurfaceFactor / lightSubpathCount);
+}
+
+// Emission found by the camera subpath
+vec3 bdpt_light_radiance(BDPTSurface light, BDPTPathState state) {
+    if (state.pathLength == 1) {
+        return light.color;
+    }
+
+    const float directPdfA = bdpt_light_pick_probability(light) / light.area;
+    const float emissionPdfW = directPdfA * 0.5 * dot(light.normal, light.dirFix) / PI;
+    const float wCamera = directPdfA * state.dVCM + emissionPdfW * state.dVC;
+
+    return light.color / (1.0 + wCamera);
+}
+
+// Next event estimation, i.e. connecting to a new light subpath vertex
+vec3 bdpt_direct_illumination(BDPTSurface surface, BDPTPathState state, inout uint rngSeed) {
+    float pickProbability;
+    const uint lightIndex = bdpt_pick_light(RandomFloat(rngSeed), pickProbability);
+    const LightTriangle light = g_LightTriangles[g_PushConstants.lightTrianglesIndex].lights[lightIndex];
+    const vec3 lightPos = sample_light_triangle(light, vec2(RandomFloat(rngSeed), RandomFloat(rngSeed)));
+
+    const vec3 toLight = lightPos - surface.pos;
+    const float dist2 = dot(toLight, toLight);
+    const float dist = sqrt(dist2);
+    const vec3 wi = toLight / dist;
+    const float cosAtLight = abs(dot(light_triangle_normal(light), wi));
+
+    float cosToLight;
+    float dirPdfW;
+    float revPdfW;
+    const vec3 bsdf = bdpt_evaluate_bsdf(surface, wi, cosToLight, dirPdfW, revPdfW);
+
+    if (dirPdfW <= 0.0 || cosAtLight <= 0.0 || pickProbability <= 0.0) {
+        return vec3(0.0);
+    }
+
+    const float directPdfW = dist2 / (light.area * cosAtLight);
+    const float emissionPdfW = 0.5 * cosAtLight / (light.area * PI);
+
+    const float wLight = dirPdfW / (pickProbability * directPdfW);
+    const float wCamera = (emissionPdfW * cosToLight / (directPdfW * cosAtLight)) * (state.dVCM + state.dVC * revPdfW);
+    const float misWeight = 1.0 / (wLight + 1.0 + wCamera);
+
+    if (!is_visible(surface.pos, wi, dist)) {
+        return vec3(0.0);
+    }
+
+    return (misWeight * cosToLight / (pickProbability * directPdfW)) * light.emission * bsdf;
+}
+
+// Connects a camera subpath vertex to a stored light subpath vertex
+vec3 bdpt_connect_vertices(BDPTLightVertex lightVertex, BDPTSurface surface, BDPTPathState state) {
+    const vec3 toLight = lightVertex.surface.pos - surface.pos;
+    const float dist2 = dot(toLight, toLight);
+    const float dist = sqrt(dist2);
+    const vec3 dir = toLight / dist;
+
+    float cosCamera;
+    float cameraDirPdfW;
+    float cameraRevPdfW;
+    const vec3 cameraBsdf = bdpt_evaluate_bsdf(surface, dir, cosCamera, cameraDirPdfW, cameraRevPdfW);
+
+    float cosLight;
+    float lightDirPdfW;
+    float lightRevPdfW;
+    const vec3 lightBsdf = bdpt_evaluate_bsdf(lightVertex.surface, -dir, cosLight, lightDirPdfW, lightRevPdfW);
+
+    if (cameraDirPdfW <= 0.0 || lightDirPdfW <= 0.0) {
+        return vec3(0.0);
+    }
+
+    const float geometryTerm = cosLight * cosCamera / dist2;
+    const float cameraDirPdfA = cameraDirPdfW * cosLight / dist2;
+    const float lightDirPdfA = lightDirPdfW * cosCamera / dist2;
+
+    const float wLight = cameraDirPdfA * (lightVertex.dVCM + lightVertex.dVC * lightRevPdfW);
+    const float wCamera = lightDirPdfA * (state.dVCM + state.dVC * cameraRevPdfW);
+    const float misWeight = 1.0 / (wLight + 1.0 + wCamera);
+
+    if (!is_visible(surface.pos, dir, dist)) {
+        return vec3(0.0);
+    }
+
+    return (misWeight * geometryTerm) * cameraBsdf * lightBsdf;
+}
+
+// One bidirectional sample through a primary ray. Returns the estimate of
+// the camera subpath, light tracing contributions go to the light film.
+vec3 bdpt_sample(vec3 origin, vec3 dir, inout uint rngSeed, out float primaryDistance, out uint primaryInstanceID) {
+    const uint maxPathLength = SPEC_RAY_BOUNCES;
+    const BDPTCamera camera = bdpt_camera();
+
+    // ---------------------------- Light Subpath ----------------------------
+    BDPTLightVertex lightVertices[BDPT_MAX_LIGHT_VERTICES];
+    uint numLightVertices = 0;
+
+    BDPTPathState lightState;
+    bdpt_generate_light_sample(lightState, rngSeed);
+
+    rayPayload.coneWidth = 0.0;
+    rayPayload.coneSpread = 0.0;
+
+    for (;;) {
+        BDPTSurface surface;
+        float dist;
+
+        // NOTE: Emitters don't reflect light
+        if (!bdpt_trace(lightState, surface, dist) || surface.isLight) {
+            break;
+        }
+
+        if (!bdpt_update_at_hit(lightState, surface, dist)) {
+            break;
+        }
+
+        if (!bdpt_is_delta(surface)) {
+            if (numLightVertices < BDPT_MAX_LIGHT_VERTICES) {
+                lightVertices[numLightVertices].surface = surface;
+                lightVertices[numLightVertices].throughput = lightState.throughput;
+                lightVertices[numLightVertices].pathLength = lightState.pathLength;
+                lightVertices[numLightVertices].dVCM = lightState.dVCM;
+                lightVertices[numLightVertices].dVC = lightState.dVC;
+                numLightVertices++;
+            }
+
+            if (lightState.pathLength + 1 <= maxPathLength) {
+                bdpt_connect_to_camera(surface, lightState, camera);
+            }
+        }
+
+        if (lightState.pathLength + 2 > maxPathLength || !bdpt_sample_scattering(surface, lightState, rngSeed)) {
+            break;
+        }
+
+        lightState.pathLength++;
+    }
+
+    // ---------------------------- Camera Subpath ---------------------------
+    BDPTPathState cameraState;
+    bdpt_generate_camera_sample(origin, dir, camera, cameraState);
+
+    rayPayload.coneWidth = 0.0;
+    rayPayload.coneSpread = g_PushConstants.pixelSpreadAngle;
+
+    primaryDistance = -1.0;
+    primaryInstanceID = RAY_PAYLOAD_NO_INSTANCE;
+
+    vec3 color = vec3(0.0);
+
+    for (;;) {
+        BDPTSurface surface;
+        float dist;
+        const bool isHit = bdpt_trace(cameraState, surface, dist);
+
+        if (cameraState.pathLength == 1) {
+            primaryDistance = dist;
+            primaryInstanceID = rayPayload.instanceID;
+        }
+
+        // NOTE: The sky can only be reached by the camera subpath, so it
+        // doesn't need a MIS weight
+        if (!isHit) {
+            color += cameraState.throughput * surface.color;
+            break;
+        }
+
+        if (!bdpt_update_at_hit(cameraState, surface, dist)) {
+            break;
+        }
+
+        if (surface.isLight) {
+            color += cameraState.throughput * bdpt_light_radiance(surface, cameraState);
+            break;
+        }
+
+        if (cameraState.pathLength >= maxPathLength) {
+            break;
+        }
+
+        if (!bdpt_is_delta(surface)) {
+            color += cameraState.throughput * bdpt_direct_illumination(surface, cameraState, rngSeed);
+
+            for (uint i = 0; i < numLightVertices; i++) {
+                if (lightVertices[i].pathLength + 1 + cameraState.pathLength > maxPathLength) {
+                    break;
+                }
+
+                color += cameraState.throughput * lightVertices[i].throughput *
+                    bdpt_connect_vertices(lightVertices[i], surface, cameraState);
+            }
+        }
+
+        if (!bdpt_sample_scattering(surface, cameraState, rngSeed)) {
+            break;
+        }
+
+        cameraState.pathLength++;
+    }
+
+    return color;
+}
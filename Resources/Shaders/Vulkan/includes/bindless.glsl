@@ -21,6 +21,9 @@ layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_UBOS_BINDING) uniform
     mat4 invViewProjection;
     vec3 cameraPosition;
     uint pad1;
+    mat4 prevViewProjection;
+    vec3 prevCameraPosition;
+    uint pad2;
 } g_PerFrameData[];
 layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_TEXTURES_BINDING) uniform texture2D g_Textures[];
 layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SAMPLERS_BINDING) uniform sampler g_Samplers[];
@@ -0,0 +1,151 @@
+// NOTE: Requires bindless.glsl and GL_EXT_scalar_block_layout. Matches
+// LightTriangle and LightBVH::Node on the CPU side, see Data/LightBVH.h
+
+struct LightTriangle {
+    vec3 p0;
+    float area;
+    vec3 p1;
+    float cdf; // NOTE: Light selection proportional to power
+    vec3 p2;
+    float pickProbability;
+    vec3 emission;
+    float pad3;
+};
+
+struct LightBVHNode {
+    vec3 boundsMin;
+    float power;
+    vec3 boundsMax;
+    float cosThetaO;
+    vec3 axis;
+    float cosThetaE;
+    uint secondChildOrLightIndex;
+    uint isLeaf;
+    uint pad1;
+    uint pad2;
+};
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) readonly buffer LightBVHNodes {
+    LightBVHNode nodes[];
+} g_LightBVHNodes[];
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) readonly buffer LightTriangles {
+    LightTriangle lights[];
+} g_LightTriangles[];
+
+// Uniformly distributed point on a light triangle from two random numbers
+vec3 sample_light_triangle(LightTriangle light, vec2 u) {
+    const float su = sqrt(u.x);
+    return light.p0 * (1.0 - su) + light.p1 * (su * (1.0 - u.y)) + light.p2 * (su * u.y);
+}
+
+vec3 light_triangle_normal(LightTriangle light) {
+    return normalize(cross(light.p1 - light.p0, light.p2 - light.p0));
+}
+
+// cos(max(0, a - b)) given the sines and cosines of a and b
+float cos_sub_clamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) {
+        return 1.0;
+    }
+
+    return cosA * cosB + sinA * sinB;
+}
+
+float sin_sub_clamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) {
+        return 0.0;
+    }
+
+    return sinA * cosB - cosA * sinB;
+}
+
+// Conservative estimate of the light a node can contribute to a point with
+// the given normal. Emitters are two-sided, so only the absolute cosine to
+// the orientation cone axis matters.
+float light_bvh_importance(LightBVHNode node, vec3 pos, vec3 normal) {
+    const vec3 center = 0.5 * (node.boundsMin + node.boundsMax);
+    const float radius = 0.5 * length(node.boundsMax - node.boundsMin);
+    const float dist2 = dot(pos - center, pos - center);
+
+    if (dist2 <= radius * radius) {
+        // NOTE: Inside the bounds, every orientation is possible
+        return node.power / max(radius * radius, 1e-8);
+    }
+
+    const vec3 wi = (pos - center) / sqrt(dist2);
+
+    // Angle between the cone axis and the direction to the point
+    const float cosThetaW = abs(dot(node.axis, wi));
+    const float sinThetaW = sqrt(max(0.0, 1.0 - cosThetaW * cosThetaW));
+
+    // Angle subtended by the bounds
+    const float sin2ThetaB = radius * radius / dist2;
+    const float cosThetaB = sqrt(max(0.0, 1.0 - sin2ThetaB));
+    const float sinThetaB = sqrt(sin2ThetaB);
+
+    const float cosThetaO = node.cosThetaO;
+    const float sinThetaO = sqrt(max(0.0, 1.0 - cosThetaO * cosThetaO));
+
+    const float cosThetaX = cos_sub_clamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float sinThetaX = sin_sub_clamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    const float cosThetaP = cos_sub_clamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+    if (cosThetaP <= node.cosThetaE) {
+        return 0.0;
+    }
+
+    // Receiving surface
+    const float cosThetaI = abs(dot(wi, normal));
+    const float sinThetaI = sqrt(max(0.0, 1.0 - cosThetaI * cosThetaI));
+    const float cosThetaPrimeI = cos_sub_clamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+
+    return max(0.0, node.power * cosThetaP * cosThetaPrimeI / max(dist2, 0.25 * radius * radius));
+}
+
+// Stochastically walks down the hierarchy, picking each child with a
+// probability proportional to its importance. Returns false when no light
+// can contribute to `pos`.
+bool sample_light_bvh(uint nodesIndex, vec3 pos, vec3 normal, float u, out uint lightIndex, out float pmf) {
+    uint nodeIndex = 0;
+    lightIndex = 0;
+    pmf = 1.0;
+
+    LightBVHNode node = g_LightBVHNodes[nodesIndex].nodes[0];
+
+    if (light_bvh_importance(node, pos, normal) <= 0.0) {
+        return false;
+    }
+
+    while (node.isLeaf == 0) {
+        const uint firstChild = nodeIndex + 1;
+        const uint secondChild = node.secondChildOrLightIndex;
+        const LightBVHNode firstNode = g_LightBVHNodes[nodesIndex].nodes[firstChild];
+        const LightBVHNode secondNode = g_LightBVHNodes[nodesIndex].nodes[secondChild];
+
+        const float firstImportance = light_bvh_importance(firstNode, pos, normal);
+        const float secondImportance = light_bvh_importance(secondNode, pos, normal);
+
+        if (firstImportance <= 0.0 && secondImportance <= 0.0) {
+            return false;
+        }
+
+        const float firstProb = firstImportance / (firstImportance + secondImportance);
+
+        if (u < firstProb) {
+            nodeIndex = firstChild;
+            node = firstNode;
+            u = min(u / firstProb, 0.99999994);
+            pmf *= firstProb;
+        }
+        else {
+            nodeIndex = secondChild;
+            node = secondNode;
+            u = min((u - firstProb) / (1.0 - firstProb), 0.99999994);
+            pmf *= 1.0 - firstProb;
+        }
+    }
+
+    lightIndex = node.secondChildOrLightIndex;
+    return true;
+}
@@ -0,0 +1,171 @@
+// NOTE: Requires bindless.glsl, ray_tracing_math.glsl, GL_EXT_scalar_block_layout
+// and GL_EXT_shader_atomic_float. Matches SDTree on the CPU side, see
+// Data/SDTree.h
+
+const uint GUIDING_MODE_SAMPLE = 1;
+const uint GUIDING_MODE_TRAIN = 2;
+const uint GUIDING_MAX_SPATIAL_NODES = 1 << 16;
+const uint GUIDING_MAX_DIRECTIONAL_DEPTH = 20;
+const float GUIDING_BSDF_FRACTION = 0.5; // NOTE: One-sample MIS between cosine and guided sampling
+
+struct GuidingSpatialNode {
+    uint firstChild;
+    uint axis;
+    uint directionalRoot;
+    uint isLeaf;
+};
+
+struct GuidingDirectionalNode {
+    vec4 sums;
+    uvec4 children; // NOTE: 0 for leaf quadrants
+};
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) readonly buffer GuidingTree {
+    vec3 boundsMin;
+    uint numSpatialNodes;
+    vec3 boundsMax;
+    uint numDirectionalNodes;
+    GuidingSpatialNode nodes[];
+} g_GuidingTrees[];
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) readonly buffer GuidingDirectionalNodes {
+    GuidingDirectionalNode nodes[];
+} g_GuidingDirectionalNodes[];
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) buffer GuidingTraining {
+    uint sampleCounts[GUIDING_MAX_SPATIAL_NODES];
+    float energies[]; // NOTE: Four per directional node
+} g_GuidingTraining[];
+
+// Cylindrical mapping between directions and [0, 1]^2, which preserves area
+vec2 guiding_dir_to_canonical(vec3 dir) {
+    const float cosTheta = clamp(dir.z, -1.0, 1.0);
+    float phi = atan(dir.y, dir.x);
+
+    if (phi < 0.0) {
+        phi += PI2;
+    }
+
+    return clamp(vec2(0.5 * (cosTheta + 1.0), phi / PI2), vec2(0.0), vec2(0.99999994));
+}
+
+vec3 guiding_canonical_to_dir(vec2 p) {
+    const float cosTheta = 2.0 * p.x - 1.0;
+    const float sinTheta = sqrt(max(0.0, 1.0 - cosTheta * cosTheta));
+    const float phi = PI2 * p.y;
+
+    return vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+}
+
+uint guiding_find_spatial_leaf(uint treeIndex, vec3 pos) {
+    vec3 p = clamp(
+        (pos - g_GuidingTrees[treeIndex].boundsMin) / (g_GuidingTrees[treeIndex].boundsMax - g_GuidingTrees[treeIndex].boundsMin),
+        vec3(0.0),
+        vec3(1.0)
+    );
+
+    uint nodeIndex = 0;
+    GuidingSpatialNode node = g_GuidingTrees[treeIndex].nodes[0];
+
+    while (node.isLeaf == 0) {
+        if (p[node.axis] < 0.5) {
+            p[node.axis] *= 2.0;
+            nodeIndex = node.firstChild;
+        }
+        else {
+            p[node.axis] = 2.0 * p[node.axis] - 1.0;
+            nodeIndex = node.firstChild + 1;
+        }
+
+        node = g_GuidingTrees[treeIndex].nodes[nodeIndex];
+    }
+
+    return nodeIndex;
+}
+
+vec3 guiding_sample(uint directionalIndex, uint root, inout uint rngSeed) {
+    uint nodeIndex = root;
+    vec2 origin = vec2(0.0);
+    float size = 1.0;
+
+    for (uint depth = 0; depth <= GUIDING_MAX_DIRECTIONAL_DEPTH; depth++) {
+        const GuidingDirectionalNode node = g_GuidingDirectionalNodes[directionalIndex].nodes[nodeIndex];
+        const float total = node.sums.x + node.sums.y + node.sums.z + node.sums.w;
+
+        if (total <= 0.0) {
+            break;
+        }
+
+        // Pick a quadrant proportional to its energy
+        float u = RandomFloat(rngSeed) * total;
+        uint quadrant = 0;
+
+        while (quadrant < 3 && (u >= node.sums[quadrant] || node.sums[quadrant] <= 0.0)) {
+            u -= node.sums[quadrant];
+            quadrant++;
+        }
+
+        size *= 0.5;
+        origin += size * vec2(quadrant & 1, quadrant >> 1);
+
+        if (node.children[quadrant] == 0) {
+            break;
+        }
+
+        nodeIndex = node.children[quadrant];
+    }
+
+    return guiding_canonical_to_dir(origin + size * vec2(RandomFloat(rngSeed), RandomFloat(rngSeed)));
+}
+
+// Solid angle pdf of guiding_sample()
+float guiding_pdf(uint directionalIndex, uint root, vec3 dir) {
+    vec2 p = guiding_dir_to_canonical(dir);
+    uint nodeIndex = root;
+    float pdf = 1.0;
+
+    for (uint depth = 0; depth <= GUIDING_MAX_DIRECTIONAL_DEPTH; depth++) {
+        const GuidingDirectionalNode node = g_GuidingDirectionalNodes[directionalIndex].nodes[nodeIndex];
+        const float total = node.sums.x + node.sums.y + node.sums.z + node.sums.w;
+
+        if (total <= 0.0) {
+            break;
+        }
+
+        const uvec2 q = uvec2(greaterThanEqual(p, vec2(0.5)));
+        const uint quadrant = q.x + 2 * q.y;
+
+        pdf *= 4.0 * node.sums[quadrant] / total;
+        p = 2.0 * p - vec2(q);
+
+        if (node.children[quadrant] == 0) {
+            break;
+        }
+
+        nodeIndex = node.children[quadrant];
+    }
+
+    return pdf / (4.0 * PI);
+}
+
+// Adds a radiance estimate to the training data of the current iteration
+void guiding_splat(uint trainingIndex, uint directionalIndex, uint spatialNode, uint root, vec3 dir, float value) {
+    atomicAdd(g_GuidingTraining[trainingIndex].sampleCounts[spatialNode], 1);
+
+    vec2 p = guiding_dir_to_canonical(dir);
+    uint nodeIndex = root;
+
+    for (uint depth = 0; depth <= GUIDING_MAX_DIRECTIONAL_DEPTH; depth++) {
+        const uvec2 q = uvec2(greaterThanEqual(p, vec2(0.5)));
+        const uint quadrant = q.x + 2 * q.y;
+        const uint child = g_GuidingDirectionalNodes[directionalIndex].nodes[nodeIndex].children[quadrant];
+
+        if (child == 0) {
+            atomicAdd(g_GuidingTraining[trainingIndex].energies[4 * nodeIndex + quadrant], value);
+            return;
+        }
+
+        p = 2.0 * p - vec2(q);
+        nodeIndex = child;
+    }
+}
@@ -1,8 +1,19 @@
+const uint RAY_PAYLOAD_NO_INSTANCE = 0xFFFFFFFF;
+
 struct RayPayload {
 	vec3 color;
 	float distance;
 	vec3 scatterDir;
 	bool isScattered;
 	uint rngSeed;
-	vec3 incomingLight;
+	vec3 incomingLight; // NOTE: Direct light estimate at the hit, already weighted by the BSDF
+	bool sampledDirectLight; // NOTE: Emission found by the scattered ray is already in `incomingLight`
+	uint instanceID; // NOTE: RAY_PAYLOAD_NO_INSTANCE on miss
+	bool isPrimaryRay; // NOTE: Set by the ray generation shader before tracing
+	float guidingPdf; // NOTE: Solid angle pdf of `scatterDir` if it can be used for guiding, otherwise 0
+	float coneWidth; // NOTE: Ray cone width at the ray origin
+	float coneSpread; // NOTE: Ray cone spread angle in radians
+	bool isSurfaceQuery; // NOTE: Set by the ray generation shader to only fetch the surface, see bdpt.glsl
+	float specularProbability; // NOTE: Surface queries only
+	float surfaceArea; // NOTE: Surface queries only, world space area of the hit triangle
 };
\ No newline at end of file
@@ -93,4 +93,28 @@ Vertex barycentric_lerp(Vertex v0, Vertex v1, Vertex v2, vec3 barycentrics) {
 	vtx.matIndex = v0.matIndex;
 
     return vtx;
-}
\ No newline at end of file
+}
+
+// --------------------------- Octahedral Encoding -----------------------------
+// Maps a unit vector onto [-1, 1]^2, see "A Survey of Efficient
+// Representations for Independent Unit Vectors" (Cigolle et al. 2014)
+vec2 oct_encode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+
+    if (n.z < 0.0) {
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return e;
+}
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return normalize(n);
+}
@@ -0,0 +1,97 @@
+// NOTE: Requires light_bvh.glsl and ray_tracing_math.glsl. See
+// "Spatiotemporal Reservoir Resampling for Real-Time Ray Tracing with
+// Dynamic Direct Lighting" (Bitterli et al. 2020)
+
+const uint RESERVOIR_NO_LIGHT = 0xFFFFFFFF;
+const uint RESTIR_NO_SURFACE = 0xFFFFFFFF;
+
+struct Reservoir {
+    uint lightIndex;
+    vec2 lightUV; // NOTE: Random numbers used for sample_light_triangle()
+    float weightSum;
+    float W; // NOTE: Unbiased contribution weight of the selected sample
+    float M; // NOTE: Number of candidates seen
+};
+
+Reservoir empty_reservoir() {
+    Reservoir r;
+    r.lightIndex = RESERVOIR_NO_LIGHT;
+    r.lightUV = vec2(0.0);
+    r.weightSum = 0.0;
+    r.W = 0.0;
+    r.M = 0.0;
+
+    return r;
+}
+
+// Streams a candidate into the reservoir, returns true if it was selected
+bool reservoir_update(inout Reservoir r, uint lightIndex, vec2 lightUV, float weight, float M, inout uint rngSeed) {
+    r.weightSum += weight;
+    r.M += M;
+
+    if (weight > 0.0 && RandomFloat(rngSeed) * r.weightSum < weight) {
+        r.lightIndex = lightIndex;
+        r.lightUV = lightUV;
+        return true;
+    }
+
+    return false;
+}
+
+// Reservoir layout in the RGBA32F attachment: (light index, packed light
+// UV, W, M). NOTE: Light UVs have to be quantized before use, so that the
+// sample evaluated now is exactly the one that is reused later.
+vec2 quantize_light_uv(vec2 u) {
+    return unpackUnorm2x16(packUnorm2x16(u));
+}
+
+vec4 pack_reservoir(Reservoir r) {
+    return vec4(uintBitsToFloat(r.lightIndex), uintBitsToFloat(packUnorm2x16(r.lightUV)), r.W, r.M);
+}
+
+Reservoir unpack_reservoir(vec4 data) {
+    Reservoir r;
+    r.lightIndex = floatBitsToUint(data.x);
+    r.lightUV = unpackUnorm2x16(floatBitsToUint(data.y));
+    r.weightSum = 0.0;
+    r.W = data.z;
+    r.M = data.w;
+
+    return r;
+}
+
+// Surface layout in the RGBA32F attachment: (position, packed normal)
+vec4 pack_surface(vec3 pos, vec3 normal) {
+    return vec4(pos, uintBitsToFloat(packSnorm2x16(oct_encode(normal))));
+}
+
+vec3 unpack_surface_normal(vec4 surface) {
+    return oct_decode(unpackSnorm2x16(floatBitsToUint(surface.w)));
+}
+
+bool is_valid_surface(vec4 surface) {
+    return floatBitsToUint(surface.w) != RESTIR_NO_SURFACE;
+}
+
+// Marks a pixel whose primary ray did not reach a shadeable surface
+void restir_store_no_surface(uint reservoirsIndex, uint surfaceIndex, ivec2 pixel) {
+    imageStore(g_RWTexturesRGBA32f[reservoirsIndex], pixel, pack_reservoir(empty_reservoir()));
+    imageStore(g_RWTexturesRGBA32f[surfaceIndex], pixel, vec4(0.0, 0.0, 0.0, uintBitsToFloat(RESTIR_NO_SURFACE)));
+}
+
+// Unshadowed light contribution, used as the resampling target function
+float restir_target_pdf(LightTriangle light, vec2 lightUV, vec3 pos, vec3 normal) {
+    const vec3 toLight = sample_light_triangle(light, lightUV) - pos;
+    const float dist2 = dot(toLight, toLight);
+    const vec3 wi = toLight * inversesqrt(dist2);
+
+    const float cosSurface = dot(normal, wi);
+    const float cosLight = abs(dot(light_triangle_normal(light), wi));
+
+    if (cosSurface <= 0.0 || cosLight <= 0.0) {
+        return 0.0;
+    }
+
+    const float luminance = dot(light.emission, vec3(0.2126, 0.7152, 0.0722));
+    return luminance * cosSurface * cosLight / dist2;
+}
@@ -0,0 +1,10 @@
+// Feature toggles that are fixed for a whole frame. They are specialization
+// constants rather than push constants, so that every pipeline variant is
+// compiled without the branches it doesn't take. Matches
+// RayTracingPass::Specialization on the CPU side.
+
+layout (constant_id = 0) const uint SPEC_RAY_BOUNCES = 8;
+layout (constant_id = 1) const bool SPEC_USE_NORMAL_MAPS = true;
+layout (constant_id = 2) const bool SPEC_USE_SKYBOX = true;
+layout (constant_id = 3) const bool SPEC_HAS_EMISSIVE_MATERIALS = true; // NOTE: False if no material is a diffuse light
+layout (constant_id = 4) const uint SPEC_INTEGRATOR = 0;
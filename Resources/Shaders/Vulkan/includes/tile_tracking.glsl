@@ -0,0 +1,56 @@
+// NOTE: Requires bindless.glsl, GL_EXT_scalar_block_layout and `g_PushConstants`
+// with a `tileStatesIndex`. Matches RayTracingPass::TileState on the CPU side.
+//
+// Every tile of the image records which instances the paths through its
+// pixels have touched since its accumulation last started over, in a small
+// bloom filter. After a scene edit, only the tiles that might have seen an
+// edited instance are reset. False positives merely reset a few more tiles.
+
+const uint TILE_SIZE = 16;
+const uint TILE_FILTER_WORDS = 8; // NOTE: 256 bits
+
+struct TileState {
+    uint reset; // NOTE: Set by the CPU, discards the tile's history for one frame
+    uint filter[TILE_FILTER_WORDS];
+};
+
+layout (set = BINDLESS_DESCRIPTOR_SET, binding = BINDLESS_SSBOS_BINDING, scalar) buffer TileStates {
+    TileState tiles[];
+} g_TileStates[];
+
+uint tile_index(uvec2 pixel) {
+    const uint tilesX = (gl_LaunchSizeEXT.x + TILE_SIZE - 1) / TILE_SIZE;
+    return (pixel.y / TILE_SIZE) * tilesX + pixel.x / TILE_SIZE;
+}
+
+bool is_tile_reset(uvec2 pixel) {
+    return g_TileStates[g_PushConstants.tileStatesIndex].tiles[tile_index(pixel)].reset != 0;
+}
+
+// NOTE: "lowbias32" by Chris Wellons, must match the CPU side
+uint tile_filter_hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Marks an instance as touched by the path of the current launch
+void tile_record_instance(uint instanceID) {
+    const uint tile = tile_index(gl_LaunchIDEXT.xy);
+    const uint hash = tile_filter_hash(instanceID);
+
+    for (uint i = 0; i < 2; i++) {
+        const uint bit = (hash >> (8 * i)) & 255;
+        const uint word = bit >> 5;
+        const uint mask = 1u << (bit & 31);
+
+        // NOTE: Most paths hit instances that are already recorded, so the
+        // atomic is skipped whenever possible to avoid contention
+        if ((g_TileStates[g_PushConstants.tileStatesIndex].tiles[tile].filter[word] & mask) == 0) {
+            atomicOr(g_TileStates[g_PushConstants.tileStatesIndex].tiles[tile].filter[word], mask);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+// NOTE: Requires GL_EXT_ray_query, `g_TLAS` and tile_tracking.glsl
+
+// Shadow ray between two points, stopping just short of the end point
+bool is_visible(vec3 pos, vec3 wi, float dist) {
+    rayQueryEXT rayQuery;
+    rayQueryInitializeEXT(
+        rayQuery,
+        g_TLAS,
+        gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT,
+        0xFF,
+        pos,
+        0.001,
+        wi,
+        dist * 0.999
+    );
+
+    while (rayQueryProceedEXT(rayQuery)) {}
+
+    if (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionNoneEXT) {
+        return true;
+    }
+
+    // NOTE: Occluders affect the pixel just as much as the surfaces it sees
+    tile_record_instance(rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, true));
+    return false;
+}
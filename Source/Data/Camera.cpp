@@ -1,5 +1,7 @@
 #include "Camera.h"
 
+#include <cmath>
+
 namespace SR {
 	Camera::Camera(const glm::vec3& position, const glm::quat& orientation, float verticalFOV, float aspectRatio, float zNear, float zFar) :
 		m_Position(position), m_Orientation(orientation),
@@ -70,6 +72,12 @@ namespace SR {
 		m_AspectRatio = aspectRatio;
 	}
 
+	float Camera::get_pixel_spread_angle(uint32_t imageHeight) const noexcept {
+		// Angle subtended by a single pixel, see "Texture Level of Detail
+		// Strategies for Real-Time Ray Tracing" (Ray Tracing Gems, ch. 20)
+		return std::atan(2.0f * std::tan(0.5f * glm::radians(m_VerticalFOV)) / static_cast<float>(imageHeight));
+	}
+
 	void Camera::update_view_matrix() {
 		m_ViewMatrix = glm::lookAt(m_Position, m_Position + m_Forward, m_Up);
 	}
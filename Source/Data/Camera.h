@@ -3,6 +3,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <cstdint>
+
 namespace SR {
 	class Camera {
 	public:
@@ -39,6 +41,8 @@ namespace SR {
 		inline glm::vec3 get_up() const noexcept { return m_Up; }
 		inline glm::vec3 get_forward() const noexcept { return m_Forward; }
 
+		float get_pixel_spread_angle(uint32_t imageHeight) const noexcept; // NOTE: In radians
+
 	private:
 		void update_view_matrix();
 		void update_proj_matrix();
@@ -0,0 +1,284 @@
+#include "GeometryCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <Windows.h>
+
+namespace SR {
+	// Page view
+	GeometryCache::PageView::~PageView() {
+		if (m_Cache != nullptr) {
+			m_Cache->release(m_Page);
+		}
+	}
+
+	GeometryCache::PageView::PageView(PageView&& other) noexcept :
+		m_Cache(std::exchange(other.m_Cache, nullptr)),
+		m_Page(other.m_Page),
+		m_Vertices(other.m_Vertices),
+		m_Indices(other.m_Indices),
+		m_NumVertices(other.m_NumVertices),
+		m_NumIndices(other.m_NumIndices) {
+	}
+
+	GeometryCache::PageView& GeometryCache::PageView::operator=(PageView&& other) noexcept {
+		if (this != &other) {
+			if (m_Cache != nullptr) {
+				m_Cache->release(m_Page);
+			}
+
+			m_Cache = std::exchange(other.m_Cache, nullptr);
+			m_Page = other.m_Page;
+			m_Vertices = other.m_Vertices;
+			m_Indices = other.m_Indices;
+			m_NumVertices = other.m_NumVertices;
+			m_NumIndices = other.m_NumIndices;
+		}
+
+		return *this;
+	}
+
+	// Geometry cache
+	GeometryCache::GeometryCache(const std::filesystem::path& directory) {
+		// NOTE: One file per process, so that several instances can run side by side
+		const std::filesystem::path path = directory / ("stingray_geometry_" + std::to_string(GetCurrentProcessId()) + ".bin");
+
+		m_File = CreateFileW(
+			path.c_str(),
+			GENERIC_READ | GENERIC_WRITE,
+			0,
+			nullptr,
+			CREATE_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+			nullptr
+		);
+
+		if (m_File == INVALID_HANDLE_VALUE) {
+			m_File = nullptr;
+			throw std::runtime_error("FILE ERROR: Failed to create geometry cache file!");
+		}
+
+		SYSTEM_INFO systemInfo = {};
+		GetSystemInfo(&systemInfo);
+		m_AllocationGranularity = systemInfo.dwAllocationGranularity;
+	}
+
+	GeometryCache::~GeometryCache() {
+		for (Page& page : m_Pages) {
+			assert(page.pinCount == 0 && "Geometry pages must be released before the cache");
+			unmap_page(page);
+		}
+
+		if (m_Mapping != nullptr) {
+			CloseHandle(m_Mapping);
+		}
+
+		if (m_File != nullptr) {
+			CloseHandle(m_File);
+		}
+	}
+
+	void GeometryCache::page_out(Model& model) {
+		for (Mesh& mesh : model.meshes) {
+			for (MeshPrimitive& primitive : mesh.primitives) {
+				assert(primitive.baseVertex + primitive.numVertices <= model.vertices.size());
+				assert(primitive.baseIndex + primitive.numIndices <= model.indices.size());
+
+				page_out(primitive, model.vertices.data() + primitive.baseVertex, model.indices.data() + primitive.baseIndex);
+			}
+		}
+
+		model.vertices = {};
+		model.indices = {};
+	}
+
+	void GeometryCache::page_out(MeshPrimitive& primitive, const ModelVertex* vertices, const uint32_t* indices) {
+		// NOTE: Kept in memory, so that the bounds never require paging
+		primitive.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		primitive.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+		for (uint32_t i = 0; i < primitive.numVertices; ++i) {
+			primitive.boundsMin = glm::min(primitive.boundsMin, vertices[i].position);
+			primitive.boundsMax = glm::max(primitive.boundsMax, vertices[i].position);
+		}
+
+		primitive.geometryPage = add_page(vertices, primitive.numVertices, indices, primitive.numIndices);
+	}
+
+	GeometryCache::PageView GeometryCache::acquire(uint32_t index) {
+		assert(index < m_Pages.size());
+		Page& page = m_Pages[index];
+
+		if (page.view == nullptr) {
+			map_page(page, index);
+		}
+
+		// NOTE: Pinned before evicting, so that the page itself stays
+		page.pinCount++;
+
+		if (page.view != nullptr) {
+			m_LRU.splice(m_LRU.begin(), m_LRU, page.lruPosition);
+			evict();
+		}
+
+		const uint8_t* data = static_cast<const uint8_t*>(page.view) + (page.offset % m_AllocationGranularity);
+
+		PageView view = {};
+		view.m_Cache = this;
+		view.m_Page = index;
+		view.m_NumVertices = page.numVertices;
+		view.m_NumIndices = page.numIndices;
+
+		if (page.view != nullptr) {
+			view.m_Vertices = reinterpret_cast<const ModelVertex*>(data);
+			view.m_Indices = reinterpret_cast<const uint32_t*>(data + sizeof(ModelVertex) * page.numVertices);
+		}
+
+		return view;
+	}
+
+	void GeometryCache::prefetch(const uint32_t* pages, size_t numPages) {
+		std::vector<WIN32_MEMORY_RANGE_ENTRY> ranges = {};
+
+		for (size_t i = 0; i < numPages; ++i) {
+			assert(pages[i] < m_Pages.size());
+			Page& page = m_Pages[pages[i]];
+
+			if (page.view != nullptr) {
+				continue;
+			}
+
+			map_page(page, pages[i]);
+
+			if (page.view == nullptr) {
+				continue;
+			}
+
+			// NOTE: Prefetching never pushes out pages that are in use
+			if (m_ResidentBytes > m_ResidentBudget) {
+				unmap_page(page);
+				break;
+			}
+
+			ranges.push_back({ page.view, static_cast<SIZE_T>(page.viewSize) });
+		}
+
+		// The mapped pages are read asynchronously by the memory manager
+		if (!ranges.empty()) {
+			PrefetchVirtualMemory(GetCurrentProcess(), ranges.size(), ranges.data(), 0);
+		}
+	}
+
+	uint32_t GeometryCache::add_page(const ModelVertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices) {
+		Page page = {
+			.offset = m_FileSize,
+			.numVertices = numVertices,
+			.numIndices = numIndices
+		};
+
+		const auto write = [this](const void* data, uint64_t size) {
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+			while (size > 0) {
+				const DWORD chunk = static_cast<DWORD>(std::min<uint64_t>(size, 1u << 30));
+				DWORD written = 0;
+
+				if (!WriteFile(m_File, bytes, chunk, &written, nullptr) || written != chunk) {
+					throw std::runtime_error("FILE ERROR: Failed to write to geometry cache file!");
+				}
+
+				bytes += chunk;
+				size -= chunk;
+				m_FileSize += chunk;
+			}
+		};
+
+		write(vertices, sizeof(ModelVertex) * static_cast<uint64_t>(numVertices));
+		write(indices, sizeof(uint32_t) * static_cast<uint64_t>(numIndices));
+
+		m_Pages.push_back(page);
+		return static_cast<uint32_t>(m_Pages.size() - 1);
+	}
+
+	void GeometryCache::map_page(Page& page, uint32_t index) {
+		const uint64_t size = sizeof(ModelVertex) * static_cast<uint64_t>(page.numVertices) + sizeof(uint32_t) * static_cast<uint64_t>(page.numIndices);
+
+		if (size == 0) {
+			return;
+		}
+
+		// NOTE: Views that are already mapped stay valid when the mapping
+		// is recreated for a file that has grown since
+		if (m_MappingSize < m_FileSize) {
+			if (m_Mapping != nullptr) {
+				CloseHandle(m_Mapping);
+			}
+
+			m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+			if (m_Mapping == nullptr) {
+				throw std::runtime_error("FILE ERROR: Failed to map geometry cache file!");
+			}
+
+			m_MappingSize = m_FileSize;
+		}
+
+		const uint64_t viewOffset = page.offset - page.offset % m_AllocationGranularity;
+		page.viewSize = page.offset + size - viewOffset;
+		page.view = MapViewOfFile(
+			m_Mapping,
+			FILE_MAP_READ,
+			static_cast<DWORD>(viewOffset >> 32),
+			static_cast<DWORD>(viewOffset & 0xFFFFFFFF),
+			static_cast<SIZE_T>(page.viewSize)
+		);
+
+		if (page.view == nullptr) {
+			throw std::runtime_error("FILE ERROR: Failed to map geometry page!");
+		}
+
+		m_LRU.push_front(index);
+		page.lruPosition = m_LRU.begin();
+		m_ResidentBytes += page.viewSize;
+	}
+
+	void GeometryCache::unmap_page(Page& page) {
+		if (page.view == nullptr) {
+			return;
+		}
+
+		UnmapViewOfFile(page.view);
+		m_LRU.erase(page.lruPosition);
+		m_ResidentBytes -= page.viewSize;
+
+		page.view = nullptr;
+		page.viewSize = 0;
+	}
+
+	void GeometryCache::evict() {
+		auto it = m_LRU.end();
+
+		while (m_ResidentBytes > m_ResidentBudget && it != m_LRU.begin()) {
+			--it;
+			Page& page = m_Pages[*it];
+
+			if (page.pinCount > 0) {
+				continue;
+			}
+
+			// NOTE: Erasing only invalidates the iterator of the evicted page
+			it = std::next(it);
+			unmap_page(page);
+		}
+	}
+
+	void GeometryCache::release(uint32_t index) {
+		assert(m_Pages[index].pinCount > 0);
+		m_Pages[index].pinCount--;
+	}
+}
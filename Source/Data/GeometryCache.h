@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Data/Model.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <vector>
+
+namespace SR {
+	// Keeps the CPU copy of model geometry out of core. The vertices and
+	// indices of each primitive are appended to a memory-mapped file as one
+	// page, either while the model is loaded or once it has been uploaded
+	// to the GPU. Pages
+	// are mapped in on demand and the least recently used ones are unmapped
+	// again once the resident set exceeds the budget, so scenes larger than
+	// memory get slower instead of running out of it.
+	// NOTE: Not thread-safe, pages are only accessed from the render thread.
+	class GeometryCache {
+	public:
+		// The geometry of one page, mapped in for as long as the view lives
+		class PageView {
+		public:
+			PageView() = default;
+			~PageView();
+
+			PageView(const PageView&) = delete;
+			PageView& operator=(const PageView&) = delete;
+			PageView(PageView&& other) noexcept;
+			PageView& operator=(PageView&& other) noexcept;
+
+			inline const ModelVertex* get_vertices() const { return m_Vertices; }
+			inline const uint32_t* get_indices() const { return m_Indices; }
+			inline uint32_t get_num_vertices() const { return m_NumVertices; }
+			inline uint32_t get_num_indices() const { return m_NumIndices; }
+
+		private:
+			friend class GeometryCache;
+
+			GeometryCache* m_Cache = nullptr;
+			uint32_t m_Page = 0;
+			const ModelVertex* m_Vertices = nullptr;
+			const uint32_t* m_Indices = nullptr;
+			uint32_t m_NumVertices = 0;
+			uint32_t m_NumIndices = 0;
+		};
+
+		// NOTE: The backing file is created in `directory` and deleted again
+		// along with the cache
+		GeometryCache(const std::filesystem::path& directory);
+		~GeometryCache();
+
+		GeometryCache(const GeometryCache&) = delete;
+		GeometryCache& operator=(const GeometryCache&) = delete;
+
+		// Writes the geometry of every primitive of `model` to its own page
+		// and releases the in-memory copy. NOTE: Indices stay relative to
+		// the primitive's first vertex.
+		void page_out(Model& model);
+
+		// Writes the geometry of a single primitive to its own page, so that
+		// loaders never need to hold more than one primitive in memory. Sets
+		// the bounds and the page of `primitive`, whose vertex and index
+		// counts must already be set.
+		void page_out(MeshPrimitive& primitive, const ModelVertex* vertices, const uint32_t* indices);
+
+		PageView acquire(uint32_t page);
+
+		// Starts reading pages that are about to be acquired, as long as they
+		// fit into the budget without evicting anything
+		void prefetch(const uint32_t* pages, size_t numPages);
+
+		inline uint64_t get_resident_bytes() const { return m_ResidentBytes; }
+
+		uint64_t m_ResidentBudget = 512ull << 20; // NOTE: In bytes, pinned pages may exceed it
+
+	private:
+		struct Page {
+			uint64_t offset = 0;
+			uint32_t numVertices = 0;
+			uint32_t numIndices = 0;
+
+			void* view = nullptr; // NOTE: Starts at the allocation granularity below `offset`
+			uint64_t viewSize = 0;
+			uint32_t pinCount = 0;
+			std::list<uint32_t>::iterator lruPosition = {};
+		};
+
+		uint32_t add_page(const ModelVertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices);
+		void map_page(Page& page, uint32_t index);
+		void unmap_page(Page& page);
+		void evict();
+		void release(uint32_t page);
+
+		void* m_File = nullptr;
+		void* m_Mapping = nullptr;
+		uint64_t m_FileSize = 0;
+		uint64_t m_MappingSize = 0;
+		uint64_t m_AllocationGranularity = 0;
+
+		std::vector<Page> m_Pages = {};
+		std::list<uint32_t> m_LRU = {}; // NOTE: Mapped pages, most recently used first
+		uint64_t m_ResidentBytes = 0;
+	};
+}
@@ -0,0 +1,346 @@
+#include "LightBVH.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+
+namespace SR {
+	// Subtrees with at least this many lights are built and refit on a
+	// separate thread, as long as they are close enough to the root, see
+	// get_fork_depth()
+	static constexpr size_t PARALLEL_THRESHOLD = 2048;
+	static constexpr size_t NUM_SPLIT_BINS = 12;
+	static constexpr float PI = 3.14159265358979f;
+
+	static float safe_acos(float x) {
+		return std::acos(std::clamp(x, -1.0f, 1.0f));
+	}
+
+	// Only the top levels of the tree fork, so that there are about as many
+	// threads as cores, and never one per subtree
+	static uint32_t get_fork_depth() {
+		const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		uint32_t depth = 0;
+
+		while ((1u << depth) < numThreads) {
+			depth++;
+		}
+
+		return depth;
+	}
+
+	static float light_power(const LightTriangle& light) {
+		const float luminance = glm::dot(light.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		return 2.0f * PI * light.area * luminance; // NOTE: Two-sided diffuse emitter
+	}
+
+	static LightBVH::Node make_leaf(const LightTriangle& light, uint32_t lightIndex) {
+		const glm::vec3 normal = glm::cross(light.p1 - light.p0, light.p2 - light.p0);
+
+		LightBVH::Node node = {};
+		node.boundsMin = glm::min(light.p0, glm::min(light.p1, light.p2));
+		node.boundsMax = glm::max(light.p0, glm::max(light.p1, light.p2));
+		node.power = light_power(light);
+		node.axis = glm::normalize(normal);
+		node.cosThetaO = 1.0f;
+		node.cosThetaE = 0.0f; // NOTE: cos(pi / 2), i.e. a diffuse emitter
+		node.secondChildOrLightIndex = lightIndex;
+		node.isLeaf = 1;
+
+		return node;
+	}
+
+	// Smallest cone containing both cones. Since emitters are two-sided, an
+	// axis and its negation describe the same set of orientations.
+	static void merge_cones(
+		const glm::vec3& axisA, float cosA, glm::vec3 axisB, float cosB,
+		glm::vec3& outAxis, float& outCos) {
+
+		if (glm::dot(axisA, axisB) < 0.0f) {
+			axisB = -axisB;
+		}
+
+		const float thetaA = safe_acos(cosA);
+		const float thetaB = safe_acos(cosB);
+		const float thetaD = safe_acos(glm::dot(axisA, axisB));
+
+		if (std::min(thetaD + thetaB, PI) <= thetaA) {
+			outAxis = axisA;
+			outCos = cosA;
+			return;
+		}
+
+		if (std::min(thetaD + thetaA, PI) <= thetaB) {
+			outAxis = axisB;
+			outCos = cosB;
+			return;
+		}
+
+		const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+		const glm::vec3 rotationAxis = glm::cross(axisA, axisB);
+
+		if (thetaO >= PI || glm::dot(rotationAxis, rotationAxis) == 0.0f) {
+			outAxis = axisA;
+			outCos = -1.0f;
+			return;
+		}
+
+		outAxis = glm::normalize(glm::angleAxis(thetaO - thetaA, glm::normalize(rotationAxis)) * axisA);
+		outCos = std::cos(thetaO);
+	}
+
+	static LightBVH::Node merge_nodes(const LightBVH::Node& a, const LightBVH::Node& b) {
+		if (a.power == 0.0f) {
+			return b;
+		}
+
+		if (b.power == 0.0f) {
+			return a;
+		}
+
+		LightBVH::Node node = {};
+		node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+		node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+		node.power = a.power + b.power;
+		node.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+		merge_cones(a.axis, a.cosThetaO, b.axis, b.cosThetaO, node.axis, node.cosThetaO);
+
+		return node;
+	}
+
+	static float surface_area(const LightBVH::Node& node) {
+		const glm::vec3 d = node.boundsMax - node.boundsMin;
+		return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+	}
+
+	// Orientation measure M_Omega of the surface area orientation heuristic
+	static float orientation_measure(const LightBVH::Node& node) {
+		const float thetaO = safe_acos(node.cosThetaO);
+		const float thetaE = safe_acos(node.cosThetaE);
+		const float thetaW = std::min(thetaO + thetaE, PI);
+		const float sinThetaO = std::sqrt(std::max(0.0f, 1.0f - node.cosThetaO * node.cosThetaO));
+
+		return 2.0f * PI * (1.0f - node.cosThetaO) + 0.5f * PI * (
+			2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) -
+			2.0f * thetaO * sinThetaO + node.cosThetaO
+		);
+	}
+
+	static float split_cost(const LightBVH::Node& node) {
+		return node.power * orientation_measure(node) * surface_area(node);
+	}
+
+	void LightBVH::build(const std::vector<LightTriangle>& lights) {
+		m_Lights = lights;
+		m_Nodes.clear();
+
+		if (m_Lights.empty()) {
+			return;
+		}
+
+		update_light_distribution();
+
+		std::vector<BuildLight> buildLights(m_Lights.size());
+
+		for (size_t i = 0; i < m_Lights.size(); ++i) {
+			const LightTriangle& light = m_Lights[i];
+
+			buildLights[i].bounds = make_leaf(light, static_cast<uint32_t>(i));
+			buildLights[i].centroid = (light.p0 + light.p1 + light.p2) / 3.0f;
+			buildLights[i].lightIndex = static_cast<uint32_t>(i);
+		}
+
+		// NOTE: A binary tree with N leaves always has 2N - 1 nodes, so every
+		// subtree knows its node range up front and can be built independently
+		m_Nodes.resize(2 * m_Lights.size() - 1);
+		build_recursive(buildLights, 0, buildLights.size(), 0, get_fork_depth());
+	}
+
+	void LightBVH::refit(const std::vector<LightTriangle>& lights) {
+		assert(lights.size() == m_Lights.size());
+
+		m_Lights = lights;
+
+		if (m_Lights.empty()) {
+			return;
+		}
+
+		update_light_distribution();
+		refit_recursive(0, m_Lights.size(), get_fork_depth());
+	}
+
+	void LightBVH::update_light_distribution() {
+		double totalPower = 0.0;
+
+		for (const LightTriangle& light : m_Lights) {
+			totalPower += light_power(light);
+		}
+
+		double cumulativePower = 0.0;
+
+		for (LightTriangle& light : m_Lights) {
+			const double power = light_power(light);
+			cumulativePower += power;
+
+			light.pickProbability = totalPower > 0.0 ? static_cast<float>(power / totalPower) : 0.0f;
+			light.cdf = totalPower > 0.0 ? static_cast<float>(cumulativePower / totalPower) : 0.0f;
+		}
+
+		// NOTE: Guards against rounding, so that every random number in
+		// [0, 1) selects a light
+		m_Lights.back().cdf = 1.0f;
+	}
+
+	void LightBVH::build_recursive(std::vector<BuildLight>& buildLights, size_t begin, size_t end, size_t nodeIndex, uint32_t forkDepth) {
+		const size_t count = end - begin;
+
+		if (count == 1) {
+			m_Nodes[nodeIndex] = buildLights[begin].bounds;
+			return;
+		}
+
+		glm::vec3 centroidMin = buildLights[begin].centroid;
+		glm::vec3 centroidMax = buildLights[begin].centroid;
+
+		for (size_t i = begin + 1; i < end; ++i) {
+			centroidMin = glm::min(centroidMin, buildLights[i].centroid);
+			centroidMax = glm::max(centroidMax, buildLights[i].centroid);
+		}
+
+		const glm::vec3 centroidExtent = centroidMax - centroidMin;
+		const float maxExtent = std::max(centroidExtent.x, std::max(centroidExtent.y, centroidExtent.z));
+
+		// Find the cheapest binned split over all three axes
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1;
+		size_t bestBin = 0;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			if (centroidExtent[axis] <= 0.0f) {
+				continue;
+			}
+
+			std::array<Node, NUM_SPLIT_BINS> bins = {};
+			std::array<size_t, NUM_SPLIT_BINS> binCounts = {};
+
+			for (size_t i = begin; i < end; ++i) {
+				const float offset = (buildLights[i].centroid[axis] - centroidMin[axis]) / centroidExtent[axis];
+				const size_t bin = std::min(static_cast<size_t>(offset * NUM_SPLIT_BINS), NUM_SPLIT_BINS - 1);
+
+				bins[bin] = merge_nodes(bins[bin], buildLights[i].bounds);
+				binCounts[bin]++;
+			}
+
+			// Suffix sweep, so that each split only needs a single prefix merge
+			std::array<Node, NUM_SPLIT_BINS> above = {};
+			std::array<size_t, NUM_SPLIT_BINS> aboveCounts = {};
+			above[NUM_SPLIT_BINS - 1] = bins[NUM_SPLIT_BINS - 1];
+			aboveCounts[NUM_SPLIT_BINS - 1] = binCounts[NUM_SPLIT_BINS - 1];
+
+			for (size_t bin = NUM_SPLIT_BINS - 1; bin > 0; --bin) {
+				above[bin - 1] = merge_nodes(bins[bin - 1], above[bin]);
+				aboveCounts[bin - 1] = binCounts[bin - 1] + aboveCounts[bin];
+			}
+
+			// NOTE: Penalizes thin splits along short axes
+			const float kr = maxExtent / centroidExtent[axis];
+			Node below = {};
+			size_t belowCount = 0;
+
+			for (size_t bin = 0; bin < NUM_SPLIT_BINS - 1; ++bin) {
+				below = merge_nodes(below, bins[bin]);
+				belowCount += binCounts[bin];
+
+				if (belowCount == 0 || aboveCounts[bin + 1] == 0) {
+					continue;
+				}
+
+				const float cost = kr * (split_cost(below) + split_cost(above[bin + 1]));
+
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		size_t mid = begin + count / 2;
+
+		if (bestAxis != -1) {
+			const auto split = std::partition(
+				buildLights.begin() + begin,
+				buildLights.begin() + end,
+				[&](const BuildLight& light) {
+					const float offset = (light.centroid[bestAxis] - centroidMin[bestAxis]) / centroidExtent[bestAxis];
+					return std::min(static_cast<size_t>(offset * NUM_SPLIT_BINS), NUM_SPLIT_BINS - 1) <= bestBin;
+				}
+			);
+
+			mid = static_cast<size_t>(split - buildLights.begin());
+		}
+
+		// NOTE: All centroids coincide when no split was found, in which case
+		// the lights are simply halved
+		if (mid == begin || mid == end) {
+			mid = begin + count / 2;
+		}
+
+		const size_t firstChild = nodeIndex + 1;
+		const size_t secondChild = nodeIndex + 2 * (mid - begin);
+
+		if (count >= PARALLEL_THRESHOLD && forkDepth > 0) {
+			auto firstTask = std::async(std::launch::async, [&]() {
+				build_recursive(buildLights, begin, mid, firstChild, forkDepth - 1);
+			});
+
+			build_recursive(buildLights, mid, end, secondChild, forkDepth - 1);
+			firstTask.get();
+		}
+		else {
+			build_recursive(buildLights, begin, mid, firstChild, 0);
+			build_recursive(buildLights, mid, end, secondChild, 0);
+		}
+
+		m_Nodes[nodeIndex] = merge_nodes(m_Nodes[firstChild], m_Nodes[secondChild]);
+		m_Nodes[nodeIndex].secondChildOrLightIndex = static_cast<uint32_t>(secondChild);
+		m_Nodes[nodeIndex].isLeaf = 0;
+	}
+
+	void LightBVH::refit_recursive(size_t nodeIndex, size_t numLeaves, uint32_t forkDepth) {
+		Node& node = m_Nodes[nodeIndex];
+
+		if (node.isLeaf != 0) {
+			const uint32_t lightIndex = node.secondChildOrLightIndex;
+			node = make_leaf(m_Lights[lightIndex], lightIndex);
+			return;
+		}
+
+		const size_t firstChild = nodeIndex + 1;
+		const size_t secondChild = node.secondChildOrLightIndex;
+		const size_t firstLeaves = (secondChild - nodeIndex) / 2;
+
+		if (numLeaves >= PARALLEL_THRESHOLD && forkDepth > 0) {
+			auto firstTask = std::async(std::launch::async, [&]() {
+				refit_recursive(firstChild, firstLeaves, forkDepth - 1);
+			});
+
+			refit_recursive(secondChild, numLeaves - firstLeaves, forkDepth - 1);
+			firstTask.get();
+		}
+		else {
+			refit_recursive(firstChild, firstLeaves, 0);
+			refit_recursive(secondChild, numLeaves - firstLeaves, 0);
+		}
+
+		node = merge_nodes(m_Nodes[firstChild], m_Nodes[secondChild]);
+		node.secondChildOrLightIndex = static_cast<uint32_t>(secondChild);
+		node.isLeaf = 0;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace SR {
+	// NOTE: Matches the `LightTriangle` struct in shaders (scalar layout).
+	// Emitters are two-sided, just like diffuse light materials when hit.
+	// `cdf` and `pickProbability` are filled in by LightBVH and describe
+	// light selection proportional to power, which does not depend on the
+	// receiving point (used by the bidirectional integrator).
+	struct LightTriangle {
+		glm::vec3 p0 = {};
+		float area = 0.0f;
+		glm::vec3 p1 = {};
+		float cdf = 0.0f;
+		glm::vec3 p2 = {};
+		float pickProbability = 0.0f;
+		glm::vec3 emission = {};
+		float pad3 = 0.0f;
+	};
+
+	// Bounding volume hierarchy over emissive triangles, where every node also
+	// bounds the emitted power and the orientation of its lights with a cone.
+	// Used for importance-based stochastic light selection on the GPU.
+	// NOTE: See "Importance Sampling of Many Lights with Adaptive Tree
+	// Splitting" by Estevez and Kulla (2018), and PBRT-v4 section 12.6.3
+	class LightBVH {
+	public:
+		// NOTE: Matches the `LightBVHNode` struct in shaders (scalar layout).
+		// Nodes are stored depth-first, so the first child of an interior node
+		// always directly follows its parent.
+		struct Node {
+			glm::vec3 boundsMin = {};
+			float power = 0.0f;
+			glm::vec3 boundsMax = {};
+			float cosThetaO = 1.0f; // NOTE: Spread of the normals around `axis`
+			glm::vec3 axis = { 0.0f, 0.0f, 1.0f };
+			float cosThetaE = 0.0f; // NOTE: Spread of the emission around the normals
+			uint32_t secondChildOrLightIndex = 0;
+			uint32_t isLeaf = 0;
+			uint32_t pad1 = 0;
+			uint32_t pad2 = 0;
+		};
+
+		LightBVH() = default;
+		~LightBVH() {}
+
+		void build(const std::vector<LightTriangle>& lights);
+
+		// Updates the bounds of all nodes after lights have moved, keeping the
+		// topology. NOTE: `lights` must contain the same lights in the same
+		// order as when the hierarchy was built.
+		void refit(const std::vector<LightTriangle>& lights);
+
+		inline const std::vector<Node>& get_nodes() const { return m_Nodes; }
+		inline const std::vector<LightTriangle>& get_lights() const { return m_Lights; }
+		inline bool empty() const { return m_Lights.empty(); }
+
+	private:
+		struct BuildLight {
+			Node bounds = {};
+			glm::vec3 centroid = {};
+			uint32_t lightIndex = 0;
+		};
+
+		// NOTE: Subtrees fork onto another thread until `forkDepth` levels
+		// below the root
+		void build_recursive(std::vector<BuildLight>& buildLights, size_t begin, size_t end, size_t nodeIndex, uint32_t forkDepth);
+		void refit_recursive(size_t nodeIndex, size_t numLeaves, uint32_t forkDepth);
+		void update_light_distribution();
+
+		std::vector<Node> m_Nodes = {};
+		std::vector<LightTriangle> m_Lights = {};
+	};
+}
@@ -12,6 +12,9 @@ namespace SR {
 		uint32_t numIndices = 0;
 		uint32_t baseVertex = 0;
 		uint32_t baseIndex = 0;
+		uint32_t geometryPage = 0; // NOTE: Where the CPU copy lives in the geometry cache
+		glm::vec3 boundsMin = {}; // NOTE: In model space
+		glm::vec3 boundsMax = {};
 	};
 
 	struct Mesh {
@@ -29,6 +32,8 @@ namespace SR {
 
 	struct Model {
 		std::vector<Mesh> meshes = {};
+		// NOTE: Only filled while loading, afterwards the CPU copy of the
+		// geometry lives in the geometry cache, see MeshPrimitive
 		std::vector<ModelVertex> vertices = {};
 		std::vector<uint32_t> indices = {};
 		std::vector<Texture> materialTextures = {};
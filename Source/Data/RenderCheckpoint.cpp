@@ -0,0 +1,331 @@
+#include "RenderCheckpoint.h"
+
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace SR {
+	static constexpr uint32_t CHECKPOINT_MAGIC = 0x4B435253; // NOTE: "SRCK"
+	static constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+	// Float data compresses poorly as is, so the bytes are first split into
+	// planes, i.e. byte k of every element of `stride` bytes, and each plane
+	// is delta encoded. Signs, exponents and constant channels (like the
+	// sample counts) then turn into long runs of zeros, which are run-length
+	// encoded in the PackBits style: a control byte c < 128 is followed by
+	// c + 1 literal bytes, and c >= 128 by a single byte repeated c - 126 times.
+	static std::vector<uint8_t> compress_floats(const std::vector<float>& values, uint32_t stride) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+		const size_t numBytes = values.size() * sizeof(float);
+		const size_t numElements = numBytes / stride;
+
+		std::vector<uint8_t> planes(numBytes);
+
+		for (size_t k = 0; k < stride; ++k) {
+			uint8_t previous = 0;
+
+			for (size_t i = 0; i < numElements; ++i) {
+				const uint8_t value = bytes[i * stride + k];
+				planes[k * numElements + i] = static_cast<uint8_t>(value - previous);
+				previous = value;
+			}
+		}
+
+		std::vector<uint8_t> compressed = {};
+		compressed.reserve(numBytes / 2);
+
+		size_t i = 0;
+		while (i < numBytes) {
+			size_t runLength = 1;
+
+			while (i + runLength < numBytes && runLength < 129 && planes[i + runLength] == planes[i]) {
+				runLength++;
+			}
+
+			if (runLength >= 2) {
+				compressed.push_back(static_cast<uint8_t>(runLength + 126));
+				compressed.push_back(planes[i]);
+				i += runLength;
+				continue;
+			}
+
+			// Literals last until the next run starts
+			size_t numLiterals = 1;
+
+			while (i + numLiterals < numBytes && numLiterals < 128 &&
+				!(i + numLiterals + 1 < numBytes && planes[i + numLiterals] == planes[i + numLiterals + 1])) {
+				numLiterals++;
+			}
+
+			compressed.push_back(static_cast<uint8_t>(numLiterals - 1));
+			compressed.insert(compressed.end(), planes.begin() + i, planes.begin() + i + numLiterals);
+			i += numLiterals;
+		}
+
+		return compressed;
+	}
+
+	static bool decompress_floats(const std::vector<uint8_t>& compressed, uint32_t stride, std::vector<float>& values) {
+		const size_t numBytes = values.size() * sizeof(float);
+		const size_t numElements = numBytes / stride;
+
+		std::vector<uint8_t> planes = {};
+		planes.reserve(numBytes);
+
+		size_t i = 0;
+		while (i < compressed.size()) {
+			const uint8_t control = compressed[i++];
+
+			if (control < 128) {
+				const size_t numLiterals = static_cast<size_t>(control) + 1;
+
+				if (i + numLiterals > compressed.size() || planes.size() + numLiterals > numBytes) {
+					return false;
+				}
+
+				planes.insert(planes.end(), compressed.begin() + i, compressed.begin() + i + numLiterals);
+				i += numLiterals;
+			}
+			else {
+				const size_t runLength = static_cast<size_t>(control) - 126;
+
+				if (i >= compressed.size() || planes.size() + runLength > numBytes) {
+					return false;
+				}
+
+				planes.insert(planes.end(), runLength, compressed[i++]);
+			}
+		}
+
+		if (planes.size() != numBytes) {
+			return false;
+		}
+
+		uint8_t* bytes = reinterpret_cast<uint8_t*>(values.data());
+
+		for (size_t k = 0; k < stride; ++k) {
+			uint8_t previous = 0;
+
+			for (size_t e = 0; e < numElements; ++e) {
+				previous = static_cast<uint8_t>(previous + planes[k * numElements + e]);
+				bytes[e * stride + k] = previous;
+			}
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	static void write_value(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool read_value(std::ifstream& file, T& value) {
+		file.read(reinterpret_cast<char*>(&value), sizeof(T));
+		return static_cast<bool>(file);
+	}
+
+	static void write_block(std::ofstream& file, const std::vector<float>& values, uint32_t stride) {
+		const std::vector<uint8_t> compressed = compress_floats(values, stride);
+
+		write_value(file, static_cast<uint64_t>(values.size()));
+		write_value(file, static_cast<uint64_t>(compressed.size()));
+		file.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+	}
+
+	static bool read_block(std::ifstream& file, std::vector<float>& values, uint32_t stride, uint64_t maxValues) {
+		uint64_t numValues = 0;
+		uint64_t compressedSize = 0;
+
+		// NOTE: Worst case PackBits output is one control byte per 128 literals
+		if (!read_value(file, numValues) || !read_value(file, compressedSize) ||
+			numValues > maxValues || compressedSize > numValues * sizeof(float) * 129 / 128 + 1) {
+			return false;
+		}
+
+		std::vector<uint8_t> compressed(compressedSize);
+		file.read(reinterpret_cast<char*>(compressed.data()), static_cast<std::streamsize>(compressedSize));
+
+		if (!file) {
+			return false;
+		}
+
+		values.resize(numValues);
+		return decompress_floats(compressed, stride, values);
+	}
+
+	std::vector<float> RenderCheckpoint::resolve_image() const {
+		return resolve_image(width, height, images, lightFilm);
+	}
+
+	std::vector<float> RenderCheckpoint::resolve_image(uint32_t width, uint32_t height, const std::vector<float>& accumulation, const std::vector<float>& lightFilm) {
+		const size_t numPixels = static_cast<size_t>(width) * height;
+		std::vector<float> image(3 * numPixels, 0.0f);
+
+		if (accumulation.size() < 4 * numPixels) {
+			return image;
+		}
+
+		// NOTE: Matches the display color in the ray generation shader
+		for (size_t i = 0; i < numPixels; ++i) {
+			const float* pixel = &accumulation[4 * i];
+
+			if (pixel[3] <= 0.0f) {
+				continue;
+			}
+
+			for (size_t c = 0; c < 3; ++c) {
+				const float splat = lightFilm.empty() ? 0.0f : lightFilm[3 * i + c];
+				image[3 * i + c] = (pixel[c] + splat) / pixel[3];
+			}
+		}
+
+		return image;
+	}
+
+	bool RenderCheckpoint::write(const std::filesystem::path& path) const {
+		// NOTE: The previous checkpoint is only replaced once the new one is
+		// complete, so that an interrupted write never loses both
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+			if (!file) {
+				return false;
+			}
+
+			write_value(file, CHECKPOINT_MAGIC);
+			write_value(file, CHECKPOINT_VERSION);
+			write_value(file, width);
+			write_value(file, height);
+			write_value(file, totalSamplesPerPixel);
+			write_value(file, integrator);
+			write_value(file, rayBounces);
+			write_value(file, useNormalMaps);
+			write_value(file, useSkybox);
+			write_value(file, useLightBVH);
+			write_value(file, useReSTIR);
+			write_value(file, useReSTIRBiasCorrection);
+			write_value(file, usePathGuiding);
+			write_value(file, cameraPosition);
+			write_value(file, cameraOrientation);
+			write_value(file, cameraVerticalFOV);
+
+			write_block(file, images, 4 * sizeof(float));
+			write_block(file, lightFilm, 3 * sizeof(float));
+
+			if (!file) {
+				return false;
+			}
+		}
+
+		std::error_code error = {};
+		std::filesystem::rename(tempPath, path, error);
+
+		return !error;
+	}
+
+	bool RenderCheckpoint::read(const std::filesystem::path& path, RenderCheckpoint& checkpoint) {
+		std::ifstream file(path, std::ios::binary);
+
+		if (!file) {
+			return false;
+		}
+
+		uint32_t magic = 0;
+		uint32_t version = 0;
+
+		if (!read_value(file, magic) || !read_value(file, version) ||
+			magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+			return false;
+		}
+
+		RenderCheckpoint result = {};
+
+		if (!read_value(file, result.width) ||
+			!read_value(file, result.height) ||
+			!read_value(file, result.totalSamplesPerPixel) ||
+			!read_value(file, result.integrator) ||
+			!read_value(file, result.rayBounces) ||
+			!read_value(file, result.useNormalMaps) ||
+			!read_value(file, result.useSkybox) ||
+			!read_value(file, result.useLightBVH) ||
+			!read_value(file, result.useReSTIR) ||
+			!read_value(file, result.useReSTIRBiasCorrection) ||
+			!read_value(file, result.usePathGuiding) ||
+			!read_value(file, result.cameraPosition) ||
+			!read_value(file, result.cameraOrientation) ||
+			!read_value(file, result.cameraVerticalFOV)) {
+			return false;
+		}
+
+		const uint64_t numPixels = static_cast<uint64_t>(result.width) * result.height;
+		constexpr uint64_t MAX_IMAGES = 16;
+
+		if (numPixels == 0 || result.rayBounces == 0 ||
+			!read_block(file, result.images, 4 * sizeof(float), 4 * numPixels * MAX_IMAGES) ||
+			!read_block(file, result.lightFilm, 3 * sizeof(float), 3 * numPixels)) {
+			return false;
+		}
+
+		if (result.images.empty() || result.images.size() % (4 * numPixels) != 0 ||
+			(!result.lightFilm.empty() && result.lightFilm.size() != 3 * numPixels)) {
+			return false;
+		}
+
+		checkpoint = std::move(result);
+		return true;
+	}
+
+	CheckpointWriter::~CheckpointWriter() {
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+
+		m_Condition.notify_one();
+
+		// NOTE: A pending checkpoint is still written before the thread exits
+		if (m_Thread.joinable()) {
+			m_Thread.join();
+		}
+	}
+
+	void CheckpointWriter::write_async(const std::filesystem::path& path, RenderCheckpoint&& checkpoint) {
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Pending.emplace(path, std::move(checkpoint));
+
+			if (!m_Thread.joinable()) {
+				m_Thread = std::thread(&CheckpointWriter::run, this);
+			}
+		}
+
+		m_Condition.notify_one();
+	}
+
+	void CheckpointWriter::run() {
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (true) {
+			m_Condition.wait(lock, [this]() { return m_Pending.has_value() || m_Quit; });
+
+			if (!m_Pending.has_value()) {
+				return;
+			}
+
+			const auto [path, checkpoint] = std::move(*m_Pending);
+			m_Pending.reset();
+			lock.unlock();
+
+			if (!checkpoint.write(path)) {
+				std::cerr << "Failed to write render checkpoint to " << path.string() << '\n';
+			}
+
+			lock.lock();
+		}
+	}
+}
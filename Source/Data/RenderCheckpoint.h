@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace SR {
+	// Everything needed to continue a progressive render where it left off.
+	// The accumulated samples are stored as sums, so continuing from a
+	// checkpoint converges to the same result as an uninterrupted render.
+	struct RenderCheckpoint {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t totalSamplesPerPixel = 0; // NOTE: Seeds the per-pixel random numbers of the next frame
+		uint32_t integrator = 0;
+
+		// The settings the samples were taken with. NOTE: Samples taken with
+		// other settings may converge to a different image, so they are
+		// restored along with the samples.
+		uint32_t rayBounces = 0;
+		bool useNormalMaps = true;
+		bool useSkybox = true;
+		bool useLightBVH = true;
+		bool useReSTIR = true;
+		bool useReSTIRBiasCorrection = true;
+		bool usePathGuiding = true;
+
+		glm::vec3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+		glm::quat cameraOrientation = { 1.0f, 0.0f, 0.0f, 0.0f };
+		float cameraVerticalFOV = 0.0f;
+
+		// RGBA32F history attachments, one after another. The first one is
+		// the accumulation (color sum and per-pixel sample count).
+		std::vector<float> images = {};
+		std::vector<float> lightFilm = {}; // NOTE: Only used by the bidirectional integrator
+
+		// Linear RGB of the accumulated samples, rows from the top. NOTE: Only
+		// the accumulation, i.e. the first of the images, is required.
+		std::vector<float> resolve_image() const;
+		static std::vector<float> resolve_image(uint32_t width, uint32_t height, const std::vector<float>& accumulation, const std::vector<float>& lightFilm);
+
+		bool write(const std::filesystem::path& path) const;
+		static bool read(const std::filesystem::path& path, RenderCheckpoint& checkpoint);
+	};
+
+	// Compresses and writes checkpoints on a background thread, so that the
+	// render loop never waits for the disk.
+	// NOTE: Only the most recent checkpoint is kept when the writer falls
+	// behind, older ones are never useful.
+	class CheckpointWriter {
+	public:
+		CheckpointWriter() = default;
+		~CheckpointWriter();
+
+		CheckpointWriter(const CheckpointWriter&) = delete;
+		CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+		void write_async(const std::filesystem::path& path, RenderCheckpoint&& checkpoint);
+
+	private:
+		void run();
+
+		std::thread m_Thread = {};
+		std::mutex m_Mutex = {};
+		std::condition_variable m_Condition = {};
+		std::optional<std::pair<std::filesystem::path, RenderCheckpoint>> m_Pending = {};
+		bool m_Quit = false;
+	};
+}
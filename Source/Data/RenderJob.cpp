@@ -0,0 +1,212 @@
+#include "RenderJob.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace SR {
+	// Orientation of a camera at `position` looking at `target`. NOTE:
+	// Cameras look along +z when not rotated. Yaw is applied around the
+	// world y-axis and pitch around the camera's own x-axis, just like the
+	// camera controls do.
+	static glm::quat look_at_orientation(const glm::vec3& position, const glm::vec3& target) {
+		const glm::vec3 offset = target - position;
+
+		if (glm::dot(offset, offset) == 0.0f) {
+			return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		const glm::vec3 dir = glm::normalize(offset);
+		const float yaw = std::atan2(dir.x, dir.z);
+		const float pitch = std::asin(glm::clamp(-dir.y, -1.0f, 1.0f));
+
+		return glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+
+	// Portable float map, little endian RGB with rows from the bottom up
+	static bool write_pfm(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& rgb) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file) {
+			return false;
+		}
+
+		file << "PF\n" << width << ' ' << height << "\n-1.0\n"; // NOTE: A negative scale means little endian
+
+		for (uint32_t y = height; y-- > 0;) {
+			file.write(
+				reinterpret_cast<const char*>(rgb.data() + static_cast<size_t>(y) * width * 3),
+				static_cast<std::streamsize>(static_cast<size_t>(width) * 3 * sizeof(float))
+			);
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	// Binary portable pixmap, 8-bit RGB with rows from the top
+	static bool write_ppm(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& rgb) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+		if (!file) {
+			return false;
+		}
+
+		file << "P6\n" << width << ' ' << height << "\n255\n";
+
+		std::vector<uint8_t> bytes(3 * static_cast<size_t>(width) * height);
+
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			bytes[i] = static_cast<uint8_t>(std::clamp(rgb[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+		return static_cast<bool>(file);
+	}
+
+	RenderJob::RenderJob(std::vector<RenderJobView>&& views, uint32_t samplesPerPixel, const std::filesystem::path& outputDirectory,
+		const PostProcessSettings& postProcessSettings) :
+		m_Views(std::move(views)), m_SamplesPerPixel(samplesPerPixel), m_OutputDirectory(outputDirectory),
+		m_PostProcessor(postProcessSettings) {
+
+		std::error_code error = {};
+		std::filesystem::create_directories(m_OutputDirectory, error);
+
+		if (error) {
+			std::cerr << "Failed to create render job output directory " << m_OutputDirectory.string() << '\n';
+		}
+
+		PipelineStage* resolveStage = m_Pipeline.add_stage("Resolve");
+		resolveStage->add_input("Accumulation");
+		resolveStage->add_input("LightFilm");
+		resolveStage->add_output("Radiance");
+		resolveStage->set_execute_callback([](PipelineFrame& frame) {
+			frame.images["Radiance"] = RenderCheckpoint::resolve_image(
+				frame.width,
+				frame.height,
+				frame.images["Accumulation"],
+				frame.images["LightFilm"]
+			);
+		});
+
+		PipelineStage* postProcessStage = m_Pipeline.add_stage("PostProcess");
+		postProcessStage->add_input("Radiance");
+		postProcessStage->add_output("Display");
+		postProcessStage->set_execute_callback([this](PipelineFrame& frame) {
+			m_PostProcessor.process(frame.width, frame.height, frame.images["Radiance"], frame.images["Display"]);
+		});
+
+		PipelineStage* encodeStage = m_Pipeline.add_stage("Encode");
+		encodeStage->add_input("Radiance");
+		encodeStage->add_input("Display");
+		encodeStage->set_execute_callback([this](PipelineFrame& frame) {
+			const std::filesystem::path hdrPath = m_OutputDirectory / std::format("view_{:04}.pfm", frame.index);
+			const std::filesystem::path displayPath = m_OutputDirectory / std::format("view_{:04}.ppm", frame.index);
+
+			if (!write_pfm(hdrPath, frame.width, frame.height, frame.images["Radiance"])) {
+				std::cerr << "Failed to write render job image to " << hdrPath.string() << '\n';
+			}
+
+			if (!write_ppm(displayPath, frame.width, frame.height, frame.images["Display"])) {
+				std::cerr << "Failed to write render job image to " << displayPath.string() << '\n';
+			}
+		});
+
+		m_Pipeline.build();
+	}
+
+	RenderJob::~RenderJob() {
+		// NOTE: The last images are still written before the job goes away
+		m_Pipeline.flush();
+	}
+
+	bool RenderJob::read_views(const std::filesystem::path& path, std::vector<RenderJobView>& views) {
+		std::ifstream file(path);
+
+		if (!file) {
+			return false;
+		}
+
+		std::vector<RenderJobView> result = {};
+		std::string line = {};
+
+		while (std::getline(file, line)) {
+			const size_t first = line.find_first_not_of(" \t\r");
+
+			if (first == std::string::npos || line[first] == '#') {
+				continue;
+			}
+
+			std::istringstream stream(line);
+			glm::vec3 position = {};
+			glm::vec3 target = {};
+			float verticalFOV = 0.0f;
+
+			if (!(stream >> position.x >> position.y >> position.z >> target.x >> target.y >> target.z >> verticalFOV)) {
+				return false;
+			}
+
+			result.push_back({
+				.position = position,
+				.orientation = look_at_orientation(position, target),
+				.verticalFOV = verticalFOV
+			});
+		}
+
+		if (result.empty()) {
+			return false;
+		}
+
+		views = std::move(result);
+		return true;
+	}
+
+	std::vector<RenderJobView> RenderJob::make_turntable(const glm::vec3& target, float radius, float height, float verticalFOV, uint32_t numViews) {
+		std::vector<RenderJobView> views = {};
+		views.reserve(numViews);
+
+		// NOTE: The first view is behind the target, looking along +z
+		for (uint32_t i = 0; i < numViews; ++i) {
+			const float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(numViews);
+			const glm::vec3 position = target + glm::vec3(radius * std::sin(angle), height, -radius * std::cos(angle));
+
+			views.push_back({
+				.position = position,
+				.orientation = look_at_orientation(position, target),
+				.verticalFOV = verticalFOV
+			});
+		}
+
+		return views;
+	}
+
+	void RenderJob::complete_view(RenderCheckpoint&& capture) {
+		assert(!is_finished());
+
+		// NOTE: Only the accumulation is needed, the other history images
+		// are dropped before the frame is queued
+		const size_t numPixels = static_cast<size_t>(capture.width) * capture.height;
+		capture.images.resize(std::min(capture.images.size(), 4 * numPixels));
+		capture.images.shrink_to_fit();
+
+		PipelineFrame frame = {
+			.index = m_CurrentView,
+			.width = capture.width,
+			.height = capture.height
+		};
+
+		frame.images["Accumulation"] = std::move(capture.images);
+		frame.images["LightFilm"] = std::move(capture.lightFilm);
+
+		m_Pipeline.submit(std::move(frame));
+		m_CurrentView++;
+	}
+}
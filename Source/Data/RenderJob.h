@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Data/RenderCheckpoint.h"
+#include "Graphics/FramePipeline.h"
+#include "Graphics/PostProcess.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace SR {
+	struct RenderJobView {
+		glm::vec3 position = { 0.0f, 0.0f, 0.0f };
+		glm::quat orientation = { 1.0f, 0.0f, 0.0f, 0.0f };
+		float verticalFOV = 60.0f; // NOTE: In degrees
+	};
+
+	// Renders a list of views back to back with the scene, acceleration
+	// structures and pipelines staying resident, so that each view only
+	// costs its own samples. Every view is accumulated to the same sample
+	// count and written as a linear HDR image (PFM) to the output directory,
+	// along with a post-processed sRGB image (PPM).
+	// NOTE: Completed views go through a FramePipeline, so resolving and
+	// writing the images overlaps with rendering the next views.
+	class RenderJob {
+	public:
+		RenderJob(std::vector<RenderJobView>&& views, uint32_t samplesPerPixel, const std::filesystem::path& outputDirectory,
+			const PostProcessSettings& postProcessSettings = {});
+		~RenderJob();
+
+		RenderJob(const RenderJob&) = delete;
+		RenderJob& operator=(const RenderJob&) = delete;
+
+		// Reads one view per line, as a camera position, the point it looks
+		// at and the vertical FOV in degrees: "px py pz tx ty tz fov".
+		// Empty lines and lines starting with '#' are skipped.
+		static bool read_views(const std::filesystem::path& path, std::vector<RenderJobView>& views);
+
+		// Views on a circle around `target`, all looking at it
+		static std::vector<RenderJobView> make_turntable(const glm::vec3& target, float radius, float height, float verticalFOV, uint32_t numViews);
+
+		// Hands the current view to the pipeline, then moves on to the next
+		// view. NOTE: Blocks while the pipeline is full.
+		void complete_view(RenderCheckpoint&& capture);
+
+		inline bool is_finished() const { return m_CurrentView >= m_Views.size(); }
+		inline const RenderJobView& get_current_view() const { return m_Views[m_CurrentView]; }
+		inline size_t get_current_view_index() const { return m_CurrentView; }
+		inline size_t get_num_views() const { return m_Views.size(); }
+		inline uint32_t get_samples_per_pixel() const { return m_SamplesPerPixel; }
+
+	private:
+		std::vector<RenderJobView> m_Views = {};
+		uint32_t m_SamplesPerPixel = 0;
+		std::filesystem::path m_OutputDirectory = {};
+		size_t m_CurrentView = 0;
+		PostProcessor m_PostProcessor; // NOTE: Only used by the pipeline's post-process stage
+		FramePipeline m_Pipeline = {}; // NOTE: Declared last, so that it drains before anything it uses goes away
+	};
+}
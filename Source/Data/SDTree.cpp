@@ -0,0 +1,136 @@
+#include "SDTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace SR {
+	static constexpr uint32_t INVALID_NODE = ~0u;
+
+	void SDTree::initialize(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+		// NOTE: Cubic bounds keep the spatial cells from becoming too thin
+		const glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+		const glm::vec3 extent = boundsMax - boundsMin;
+		const float halfSize = 0.5f * std::max(extent.x, std::max(extent.y, extent.z)) * 1.001f + 1e-4f;
+
+		m_Header.boundsMin = center - glm::vec3(halfSize);
+		m_Header.boundsMax = center + glm::vec3(halfSize);
+
+		m_SpatialNodes.assign(1, SpatialNode{});
+		m_DirectionalNodes.assign(1, DirectionalNode{});
+		m_Header.numSpatialNodes = 1;
+		m_Header.numDirectionalNodes = 1;
+		m_Iteration = 0;
+	}
+
+	void SDTree::refine(const uint32_t* sampleCounts, const float* energies) {
+		RefineContext context = {};
+		context.sampleCounts = sampleCounts;
+		context.energies.assign(energies, energies + 4 * m_DirectionalNodes.size());
+		context.splitThreshold = SPATIAL_SPLIT_THRESHOLD * std::sqrt(std::pow(2.0f, static_cast<float>(m_Iteration)));
+
+		// Training data only lands in leaf quadrants, so sum it up to the
+		// interior ones. NOTE: Children are always stored after their parent.
+		for (size_t i = m_DirectionalNodes.size(); i-- > 0;) {
+			for (uint32_t q = 0; q < 4; ++q) {
+				const uint32_t child = m_DirectionalNodes[i].children[q];
+
+				if (child != 0) {
+					context.energies[4 * i + q] =
+						context.energies[4 * child + 0] + context.energies[4 * child + 1] +
+						context.energies[4 * child + 2] + context.energies[4 * child + 3];
+				}
+			}
+		}
+
+		context.spatialNodes.reserve(m_SpatialNodes.size() * 2);
+		context.directionalNodes.reserve(m_DirectionalNodes.size() * 2);
+		context.spatialNodes.emplace_back();
+		refine_spatial(context, 0, 0);
+
+		m_SpatialNodes = std::move(context.spatialNodes);
+		m_DirectionalNodes = std::move(context.directionalNodes);
+		m_Header.numSpatialNodes = static_cast<uint32_t>(m_SpatialNodes.size());
+		m_Header.numDirectionalNodes = static_cast<uint32_t>(m_DirectionalNodes.size());
+		m_Iteration++;
+	}
+
+	void SDTree::refine_spatial(RefineContext& context, uint32_t oldIndex, uint32_t newIndex) const {
+		const SpatialNode& oldNode = m_SpatialNodes[oldIndex];
+
+		if (oldNode.isLeaf != 0) {
+			split_spatial_leaf(context, oldIndex, newIndex, static_cast<float>(context.sampleCounts[oldIndex]), oldNode.axis);
+			return;
+		}
+
+		const uint32_t firstChild = static_cast<uint32_t>(context.spatialNodes.size());
+		context.spatialNodes.resize(context.spatialNodes.size() + 2);
+		context.spatialNodes[newIndex] = { firstChild, oldNode.axis, 0, 0 };
+
+		refine_spatial(context, oldNode.firstChild, firstChild);
+		refine_spatial(context, oldNode.firstChild + 1, firstChild + 1);
+	}
+
+	void SDTree::split_spatial_leaf(RefineContext& context, uint32_t oldIndex, uint32_t newIndex, float sampleCount, uint32_t axis) const {
+		// Leaves that received many samples are split, and both halves start
+		// out with a copy of the parent's quadtree
+		if (sampleCount > context.splitThreshold && context.spatialNodes.size() + 2 <= MAX_SPATIAL_NODES) {
+			const uint32_t firstChild = static_cast<uint32_t>(context.spatialNodes.size());
+			context.spatialNodes.resize(context.spatialNodes.size() + 2);
+			context.spatialNodes[newIndex] = { firstChild, axis, 0, 0 };
+
+			split_spatial_leaf(context, oldIndex, firstChild, 0.5f * sampleCount, (axis + 1) % 3);
+			split_spatial_leaf(context, oldIndex, firstChild + 1, 0.5f * sampleCount, (axis + 1) % 3);
+			return;
+		}
+
+		const uint32_t oldRoot = m_SpatialNodes[oldIndex].directionalRoot;
+		const float* rootEnergies = &context.energies[4 * oldRoot];
+		float totalEnergy = rootEnergies[0] + rootEnergies[1] + rootEnergies[2] + rootEnergies[3];
+		bool useOldSums = false;
+
+		// NOTE: Without any training data, keep the previous distribution
+		if (totalEnergy <= 0.0f) {
+			const float* sums = m_DirectionalNodes[oldRoot].sums;
+			totalEnergy = sums[0] + sums[1] + sums[2] + sums[3];
+			useOldSums = true;
+		}
+
+		const uint32_t root = refine_directional(context, oldRoot, totalEnergy, totalEnergy, 0, useOldSums);
+		context.spatialNodes[newIndex] = { 0, axis, root, 1 };
+	}
+
+	uint32_t SDTree::refine_directional(
+		RefineContext& context, uint32_t oldIndex, float nodeEnergy,
+		float totalEnergy, uint32_t depth, bool useOldSums) const {
+
+		const uint32_t newIndex = static_cast<uint32_t>(context.directionalNodes.size());
+		context.directionalNodes.emplace_back();
+
+		for (uint32_t q = 0; q < 4; ++q) {
+			float energy = 0.25f * nodeEnergy;
+			uint32_t oldChild = INVALID_NODE;
+
+			if (oldIndex != INVALID_NODE) {
+				const DirectionalNode& oldNode = m_DirectionalNodes[oldIndex];
+				energy = useOldSums ? oldNode.sums[q] : context.energies[4 * oldIndex + q];
+				oldChild = oldNode.children[q] != 0 ? oldNode.children[q] : INVALID_NODE;
+			}
+
+			context.directionalNodes[newIndex].sums[q] = energy;
+			context.directionalNodes[newIndex].children[q] = 0;
+
+			// Subdivide quadrants holding a large share of the energy, and
+			// collapse the ones that no longer do
+			if (depth < MAX_DIRECTIONAL_DEPTH &&
+				energy > SUBDIVISION_THRESHOLD * totalEnergy &&
+				context.directionalNodes.size() < MAX_DIRECTIONAL_NODES) {
+
+				const uint32_t child = refine_directional(context, oldChild, energy, totalEnergy, depth + 1, useOldSums);
+				context.directionalNodes[newIndex].children[q] = child;
+			}
+		}
+
+		return newIndex;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace SR {
+	// Spatial-directional tree for path guiding. A binary tree subdivides the
+	// scene bounds, and every spatial leaf holds a quadtree over the sphere of
+	// directions (cylindrical mapping) that approximates the incident radiance
+	// there. The GPU samples from the tree and splats training data into a
+	// buffer with the same layout, which is then used to refine the next one.
+	// NOTE: See "Practical Path Guiding for Efficient Light-Transport
+	// Simulation" by Müller et al. (2017)
+	class SDTree {
+	public:
+		// NOTE: Matches the `GuidingHeader` struct in shaders (scalar layout)
+		struct Header {
+			glm::vec3 boundsMin = {};
+			uint32_t numSpatialNodes = 0;
+			glm::vec3 boundsMax = {};
+			uint32_t numDirectionalNodes = 0;
+		};
+
+		// NOTE: Matches the `GuidingSpatialNode` struct in shaders. Children
+		// split the node in half along `axis` and are stored next to each other.
+		struct SpatialNode {
+			uint32_t firstChild = 0;
+			uint32_t axis = 0;
+			uint32_t directionalRoot = 0;
+			uint32_t isLeaf = 1;
+		};
+
+		// NOTE: Matches the `GuidingDirectionalNode` struct in shaders. A child
+		// index of 0 means that the quadrant is a leaf, since the root of a
+		// quadtree is never a child.
+		struct DirectionalNode {
+			float sums[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			uint32_t children[4] = { 0, 0, 0, 0 };
+		};
+
+		static constexpr uint32_t MAX_SPATIAL_NODES = 1u << 16;
+		static constexpr uint32_t MAX_DIRECTIONAL_NODES = 1u << 18;
+		static constexpr uint32_t MAX_DIRECTIONAL_DEPTH = 20;
+		static constexpr float SUBDIVISION_THRESHOLD = 0.01f; // NOTE: Fraction of the quadtree energy
+		static constexpr float SPATIAL_SPLIT_THRESHOLD = 12000.0f; // NOTE: Samples, scaled by sqrt(2^iteration)
+
+		SDTree() = default;
+		~SDTree() {}
+
+		// Starts over with a single spatial leaf and a uniform distribution
+		void initialize(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+		// Builds the tree for the next iteration from the training data that
+		// was gathered with the current one. `sampleCounts` has one entry per
+		// spatial node and `energies` four entries per directional node.
+		void refine(const uint32_t* sampleCounts, const float* energies);
+
+		inline const Header& get_header() const { return m_Header; }
+		inline const std::vector<SpatialNode>& get_spatial_nodes() const { return m_SpatialNodes; }
+		inline const std::vector<DirectionalNode>& get_directional_nodes() const { return m_DirectionalNodes; }
+		inline uint32_t get_iteration() const { return m_Iteration; }
+
+	private:
+		struct RefineContext {
+			const uint32_t* sampleCounts = nullptr;
+			std::vector<float> energies = {}; // NOTE: Summed up to interior quadrants
+			float splitThreshold = 0.0f;
+			std::vector<SpatialNode> spatialNodes = {};
+			std::vector<DirectionalNode> directionalNodes = {};
+		};
+
+		void refine_spatial(RefineContext& context, uint32_t oldIndex, uint32_t newIndex) const;
+		void split_spatial_leaf(RefineContext& context, uint32_t oldIndex, uint32_t newIndex, float sampleCount, uint32_t axis) const;
+		uint32_t refine_directional(
+			RefineContext& context, uint32_t oldIndex, float nodeEnergy,
+			float totalEnergy, uint32_t depth, bool useOldSums) const;
+
+		Header m_Header = {};
+		std::vector<SpatialNode> m_SpatialNodes = {};
+		std::vector<DirectionalNode> m_DirectionalNodes = {};
+		uint32_t m_Iteration = 0;
+	};
+}
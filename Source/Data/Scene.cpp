@@ -13,13 +13,85 @@ namespace SR {
 	}
 
 	entity_id Scene::add_entity(const std::string& name) {
-		assert(m_EntityIndicesMap.find(name) == m_EntityIndicesMap.end());
-
 		const entity_id entity = ECS::create_entity();
+		insert_entity(name, entity);
+
+		return entity;
+	}
+
+	entity_id Scene::add_entity(const std::string& name, ECS::CommandBuffer& commands) {
+		const entity_id placeholder = commands.create_entity();
+
+		// NOTE: The scene itself is only touched by playback
+		commands.add_to_scene(placeholder, *this, name);
+
+		return placeholder;
+	}
+
+	void Scene::destroy_entity(entity_id entity) {
+		auto search = m_EntityIndexLUT.find(entity);
+
+		if (search != m_EntityIndexLUT.end()) {
+			remove_entity(search->second);
+		}
+
+		ECS::destroy_entity(entity);
+	}
+
+	void Scene::destroy_entities(std::span<const entity_id> entities) {
+		for (entity_id entity : entities) {
+			auto search = m_EntityIndexLUT.find(entity);
+
+			if (search != m_EntityIndexLUT.end()) {
+				remove_entity(search->second);
+			}
+		}
+
+		ECS::destroy_entities(entities);
+	}
+
+	void Scene::prune_entities() {
+		// NOTE: Backwards, since removing moves the last entity into the gap
+		for (size_t i = m_Entities.size(); i > 0; --i) {
+			if (!ECS::is_alive(m_Entities[i - 1])) {
+				remove_entity(i - 1);
+			}
+		}
+	}
+
+	void Scene::insert_entity(const std::string& name, entity_id entity) {
+		auto search = m_EntityIndicesMap.find(name);
+
+		// NOTE: The name of an entity that was destroyed without going
+		// through the scene is free again
+		if (search != m_EntityIndicesMap.end() && !ECS::is_alive(m_Entities[search->second])) {
+			remove_entity(search->second);
+			search = m_EntityIndicesMap.end();
+		}
+
+		assert(search == m_EntityIndicesMap.end());
 
 		m_EntityIndicesMap.insert({ name, m_Entities.size() });
+		m_EntityIndexLUT.insert({ entity, m_Entities.size() });
 		m_Entities.push_back(entity);
+		m_EntityNames.push_back(name);
+	}
 
-		return entity;
+	void Scene::remove_entity(size_t index) {
+		assert(index < m_Entities.size());
+
+		m_EntityIndicesMap.erase(m_EntityNames[index]);
+		m_EntityIndexLUT.erase(m_Entities[index]);
+
+		// The last entity takes the place of the removed one
+		if (index + 1 != m_Entities.size()) {
+			m_Entities[index] = m_Entities.back();
+			m_EntityNames[index] = std::move(m_EntityNames.back());
+			m_EntityIndicesMap[m_EntityNames[index]] = index;
+			m_EntityIndexLUT[m_Entities[index]] = index;
+		}
+
+		m_Entities.pop_back();
+		m_EntityNames.pop_back();
 	}
 }
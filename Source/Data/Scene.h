@@ -1,10 +1,13 @@
 #pragma once
 
+#include "ECS/CommandBuffer.h"
 #include "ECS/ECS.h"
 #include "Graphics/GraphicsDevice.h"
 
 #include <cstdint>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -17,13 +20,37 @@ namespace SR {
 
 		entity_id add_entity(const std::string& name);
 
+		// Records the entity in `commands` and returns its placeholder, the
+		// entity joins the scene when the commands are played back
+		entity_id add_entity(const std::string& name, ECS::CommandBuffer& commands);
+
+		// Removes the entities from the scene, which releases their names,
+		// and destroys them
+		void destroy_entity(entity_id entity);
+		void destroy_entities(std::span<const entity_id> entities);
+
+		// Removes the entities that were destroyed without going through the
+		// scene, e.g. by command buffers. NOTE: Their names are also released
+		// when they are added again.
+		void prune_entities();
+
 		inline const std::string& get_name() const { return m_Name; }
+
+		// NOTE: Only holds destroyed entities if they were destroyed without
+		// going through the scene, see prune_entities()
 		inline const std::vector<entity_id>& get_entities() const { return m_Entities; }
 	private:
+		friend class ECS::CommandBuffer;
+
+		void insert_entity(const std::string& name, entity_id entity);
+		void remove_entity(size_t index);
+
 		std::string m_Name;
 		GraphicsDevice& m_GfxDevice;
 
 		std::unordered_map<std::string, size_t> m_EntityIndicesMap = {};
+		std::unordered_map<entity_id, size_t> m_EntityIndexLUT = {};
 		std::vector<entity_id> m_Entities = {};
+		std::vector<std::string> m_EntityNames = {}; // NOTE: Parallel to m_Entities
 	};
 }
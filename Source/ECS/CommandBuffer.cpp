@@ -0,0 +1,240 @@
+#include "CommandBuffer.h"
+
+#include "Data/Scene.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace SR::ECS {
+	// NOTE: Real entities only get this generation after four billion
+	// reuses of their index
+	GLOBAL constexpr uint32_t PLACEHOLDER_GENERATION = ~0u;
+
+	static inline bool is_placeholder(entity_id entity) {
+		return get_entity_generation(entity) == PLACEHOLDER_GENERATION;
+	}
+
+	void CommandBuffer::begin_batch(uint64_t key) {
+		m_Batches.push_back({ .key = key, .firstCommand = static_cast<uint32_t>(m_Commands.size()) });
+	}
+
+	entity_id CommandBuffer::create_entity() {
+		const entity_id placeholder = (static_cast<entity_id>(PLACEHOLDER_GENERATION) << 32) | m_CreatedEntities.size();
+		m_CreatedEntities.push_back(INVALID_ENTITY);
+
+		record(CommandType::CREATE_ENTITY, placeholder, 0, nullptr);
+		return placeholder;
+	}
+
+	void CommandBuffer::destroy_entity(entity_id entity) {
+		record(CommandType::DESTROY_ENTITY, entity, 0, nullptr);
+	}
+
+	void CommandBuffer::on_created(entity_id placeholder, std::function<void(entity_id entity)> callback) {
+		assert(is_placeholder(placeholder) && get_entity_index(placeholder) < m_CreatedEntities.size());
+
+		record(CommandType::ON_CREATED, placeholder, 0, nullptr);
+		m_Commands.back().dataOffset = m_Callbacks.size();
+		m_Callbacks.push_back(std::move(callback));
+	}
+
+	void CommandBuffer::add_to_scene(entity_id entity, Scene& scene, std::string_view name) {
+		record(CommandType::ADD_TO_SCENE, entity, 0, nullptr);
+
+		// NOTE: The scene, the length of the name and the name itself
+		Scene* target = &scene;
+		const uint32_t length = static_cast<uint32_t>(name.size());
+		append_data(&target, sizeof(target));
+		append_data(&length, sizeof(length));
+		append_data(name.data(), length);
+	}
+
+	void CommandBuffer::clear() {
+		m_Batches.clear();
+		m_Commands.clear();
+		m_Data.clear();
+		m_Callbacks.clear();
+		m_CreatedEntities.clear();
+	}
+
+	void CommandBuffer::playback(std::span<CommandBuffer* const> buffers) {
+		struct BatchSource {
+			uint64_t key = 0;
+			uint32_t buffer = 0;
+			uint32_t batch = 0;
+		};
+
+		// NOTE: Kept around, so that playback does not allocate either
+		LOCAL_PERSIST std::vector<BatchSource> batches = {};
+		batches.clear();
+
+		for (uint32_t i = 0; i < buffers.size(); ++i) {
+			for (uint32_t j = 0; j < buffers[i]->m_Batches.size(); ++j) {
+				if (buffers[i]->m_Batches[j].numCommands > 0) {
+					batches.push_back({ buffers[i]->m_Batches[j].key, i, j });
+				}
+			}
+		}
+
+		// NOTE: Stable, so that batches with the same key keep the order of
+		// their buffers, and of the batches within a buffer
+		std::stable_sort(batches.begin(), batches.end(), [](const BatchSource& a, const BatchSource& b) { return a.key < b.key; });
+
+		for (const BatchSource& source : batches) {
+			CommandBuffer& buffer = *buffers[source.buffer];
+			buffer.play_batch(buffer.m_Batches[source.batch]);
+		}
+
+		for (CommandBuffer* buffer : buffers) {
+			buffer->clear();
+		}
+	}
+
+	void CommandBuffer::playback() {
+		CommandBuffer* buffer = this;
+		playback(std::span<CommandBuffer* const>(&buffer, 1));
+	}
+
+	void CommandBuffer::record(CommandType type, entity_id entity, uint32_t componentId, const void* component) {
+		if (m_Batches.empty()) {
+			begin_batch(0);
+		}
+
+		Command& command = m_Commands.emplace_back();
+		command.type = type;
+		command.componentId = componentId;
+		command.entity = entity;
+		command.dataOffset = m_Data.size();
+
+		if (component != nullptr) {
+			append_data(component, Internal::COMPONENT_INFOS[componentId].size);
+		}
+
+		m_Batches.back().numCommands++;
+	}
+
+	void CommandBuffer::append_data(const void* data, size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_Data.insert(m_Data.end(), bytes, bytes + size);
+	}
+
+	void CommandBuffer::play_batch(const Batch& batch) {
+		const uint32_t end = batch.firstCommand + batch.numCommands;
+
+		for (uint32_t i = batch.firstCommand; i < end; ++i) {
+			const Command& command = m_Commands[i];
+
+			switch (command.type) {
+			case CommandType::CREATE_ENTITY:
+			{
+				// NOTE: Entities created in a row are created in one go, their
+				// placeholders are consecutive. Notifications recorded in
+				// between, e.g. by Scene::add_entity(), are played once all of
+				// them exist, they do not change the entities.
+				uint32_t runEnd = i + 1;
+				uint32_t count = 1;
+
+				for (; runEnd < end; ++runEnd) {
+					const CommandType type = m_Commands[runEnd].type;
+
+					if (type == CommandType::CREATE_ENTITY) {
+						count++;
+					}
+					else if (type != CommandType::ON_CREATED && type != CommandType::ADD_TO_SCENE) {
+						break;
+					}
+				}
+
+				LOCAL_PERSIST std::vector<entity_id> entities = {};
+				entities.clear();
+				ECS::create_entities(count, entities);
+				std::copy(entities.begin(), entities.end(), m_CreatedEntities.begin() + get_entity_index(command.entity));
+
+				for (uint32_t j = i + 1; j < runEnd; ++j) {
+					if (m_Commands[j].type != CommandType::CREATE_ENTITY) {
+						play_notification(m_Commands[j]);
+					}
+				}
+
+				i = runEnd - 1;
+			}
+			break;
+			case CommandType::ADD_COMPONENT:
+			{
+				const entity_id entity = resolve(command.entity);
+				const uint8_t* data = m_Data.data() + command.dataOffset;
+
+				if (!is_alive(entity)) {
+					break;
+				}
+
+				if (void* component = Internal::get_component(entity, command.componentId, true)) {
+					std::memcpy(component, data, Internal::COMPONENT_INFOS[command.componentId].size);
+				}
+				else {
+					Internal::add_component(entity, command.componentId, data);
+				}
+			}
+			break;
+			case CommandType::REMOVE_COMPONENT:
+			{
+				const entity_id entity = resolve(command.entity);
+
+				if (is_alive(entity)) {
+					Internal::remove_component(entity, command.componentId);
+				}
+			}
+			break;
+			case CommandType::DESTROY_ENTITY:
+			{
+				const entity_id entity = resolve(command.entity);
+
+				if (is_alive(entity)) {
+					ECS::destroy_entity(entity);
+				}
+			}
+			break;
+			case CommandType::ON_CREATED:
+			case CommandType::ADD_TO_SCENE:
+			{
+				play_notification(command);
+			}
+			break;
+			}
+		}
+	}
+
+	void CommandBuffer::play_notification(const Command& command) {
+		const entity_id entity = resolve(command.entity);
+
+		if (command.type == CommandType::ON_CREATED) {
+			m_Callbacks[command.dataOffset](entity);
+			return;
+		}
+
+		assert(command.type == CommandType::ADD_TO_SCENE);
+
+		if (!is_alive(entity)) {
+			return;
+		}
+
+		const uint8_t* data = m_Data.data() + command.dataOffset;
+		Scene* scene = nullptr;
+		uint32_t length = 0;
+		std::memcpy(&scene, data, sizeof(scene));
+		std::memcpy(&length, data + sizeof(scene), sizeof(length));
+
+		const char* name = reinterpret_cast<const char*>(data + sizeof(scene) + sizeof(length));
+		scene->insert_entity(std::string(name, length), entity);
+	}
+
+	entity_id CommandBuffer::resolve(entity_id entity) const {
+		if (!is_placeholder(entity)) {
+			return entity;
+		}
+
+		assert(get_entity_index(entity) < m_CreatedEntities.size());
+		return m_CreatedEntities[get_entity_index(entity)];
+	}
+}
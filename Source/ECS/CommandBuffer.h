@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ECS/ECS.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace SR {
+	class Scene;
+}
+
+namespace SR::ECS {
+	// Records structural changes to apply later, so that threads can create
+	// entities, add and remove components and destroy entities while others
+	// work on the components. Cleared buffers keep their memory, so that
+	// recording does not allocate once they have grown to the usual size.
+	// NOTE: A buffer is only ever used by one thread at a time, every thread
+	// records into its own.
+	class CommandBuffer {
+	public:
+		CommandBuffer() {}
+		~CommandBuffer() {}
+
+		// Commands recorded from now on are played back after the ones with
+		// a smaller key, from any buffer, so that the result does not depend
+		// on which thread recorded what. NOTE: Commands recorded before the
+		// first batch have key 0.
+		void begin_batch(uint64_t key);
+
+		// Returns a placeholder that stands for the entity in the later
+		// commands of this buffer. NOTE: Placeholders are not entities, so
+		// they must not be stored in components.
+		entity_id create_entity();
+
+		// NOTE: Replaces the component if the entity already has it by then
+		template <typename T>
+		inline void add_component(entity_id entity, const T& component) {
+			record(CommandType::ADD_COMPONENT, entity, get_component_id<T>(), &component);
+		}
+
+		template <typename T>
+		inline void remove_component(entity_id entity) {
+			record(CommandType::REMOVE_COMPONENT, entity, get_component_id<T>(), nullptr);
+		}
+
+		void destroy_entity(entity_id entity);
+
+		// Calls `callback` with the entity the placeholder stands for once
+		// it has been created, for bookkeeping outside the ECS. NOTE: The
+		// callback may allocate, add_to_scene() never does.
+		void on_created(entity_id placeholder, std::function<void(entity_id entity)> callback);
+
+		// Adds the entity to the scene under `name`, see Scene::add_entity()
+		void add_to_scene(entity_id entity, Scene& scene, std::string_view name);
+
+		inline bool is_empty() const { return m_Commands.empty(); }
+
+		void clear();
+
+		// Applies the commands of all buffers, batch by batch in the order
+		// of their keys, and batches with the same key in the order of the
+		// buffers. Commands on entities that are no longer alive are skipped.
+		// NOTE: Clears the buffers. Must not run on several threads at once.
+		static void playback(std::span<CommandBuffer* const> buffers);
+
+		void playback();
+
+	private:
+		enum class CommandType : uint32_t {
+			CREATE_ENTITY,
+			ADD_COMPONENT,
+			REMOVE_COMPONENT,
+			DESTROY_ENTITY,
+			ON_CREATED,
+			ADD_TO_SCENE
+		};
+
+		struct Command {
+			CommandType type = CommandType::CREATE_ENTITY;
+			uint32_t componentId = 0;
+			entity_id entity = INVALID_ENTITY;
+			size_t dataOffset = 0; // NOTE: Into m_Data for components and scenes, into m_Callbacks for callbacks
+		};
+
+		struct Batch {
+			uint64_t key = 0;
+			uint32_t firstCommand = 0;
+			uint32_t numCommands = 0;
+		};
+
+		void record(CommandType type, entity_id entity, uint32_t componentId, const void* component);
+		void append_data(const void* data, size_t size);
+		void play_batch(const Batch& batch);
+		void play_notification(const Command& command);
+		entity_id resolve(entity_id entity) const;
+
+		std::vector<Batch> m_Batches = {};
+		std::vector<Command> m_Commands = {};
+		std::vector<uint8_t> m_Data = {};
+		std::vector<std::function<void(entity_id entity)>> m_Callbacks = {};
+		std::vector<entity_id> m_CreatedEntities = {}; // NOTE: Indexed by placeholder, filled in by playback
+	};
+}
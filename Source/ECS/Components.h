@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Core/Platform.h"
 #include "Data/Model.h"
 #include <glm/glm.hpp>
 #include "glm/gtc/quaternion.hpp"
@@ -7,7 +8,11 @@
 #include <cstdint>
 
 namespace SR {
-	using entity_id = uint32_t;
+	using entity_id = uint64_t; // NOTE: The index of the entity in the low 32 bits, its generation in the high 32 bits
+
+	namespace ECS {
+		GLOBAL constexpr entity_id INVALID_ENTITY = ~0ull; // NOTE: Never handed out, stands for "no entity"
+	}
 
 	struct Transform {
 		glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
@@ -15,6 +20,19 @@ namespace SR {
 		glm::vec3 scale = { 1.0f, 1.0f, 1.0f };
 	};
 
+	// Makes the Transform of the entity relative to the world transform of
+	// its parent
+	// NOTE: Defaults to no parent, i.e. a root
+	struct Parent {
+		entity_id entity = ECS::INVALID_ENTITY;
+	};
+
+	// NOTE: Derived from Transform and Parent by update_world_transforms(),
+	// never written elsewhere
+	struct WorldTransform {
+		glm::mat4 matrix = glm::mat4(1.0f);
+	};
+
 	struct Renderable {
 		const Model* model = nullptr;
 	};
@@ -1,110 +1,432 @@
 #include "ECS.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <queue>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace SR::ECS {
-	template<typename T>
-	struct ComponentArray {
-		void add(entity_id entity, T component) {
-			assert(entityToIndexLUT.find(entity) == entityToIndexLUT.end());
+	using namespace Internal;
 
-			const size_t newIndex = size;
+	GLOBAL uint32_t g_LiveEntityCount = 0;
+	GLOBAL uint32_t g_FreeEntityIndex = INVALID_INDEX; // NOTE: The head of the free list threaded through the records
+	GLOBAL std::unordered_map<ComponentMask, uint32_t> g_ArchetypeLUT = {};
+	GLOBAL std::vector<ChunkData> g_FreeChunks = {}; // NOTE: Kept for reuse, so that churn does not allocate
+	GLOBAL uint32_t g_StructureVersion = 0;
+
+	static inline entity_id make_entity(uint32_t index, uint32_t generation) {
+		return (static_cast<entity_id>(generation) << 32) | index;
+	}
 
-			entityToIndexLUT.insert({ entity, newIndex });
-			indexToEntityLUT.insert({ newIndex, entity });
-			components[newIndex] = component;
+	static size_t align_up(size_t value, size_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
 
-			++size;
+	static uint32_t find_archetype(ComponentMask mask) {
+		auto search = g_ArchetypeLUT.find(mask);
+
+		if (search != g_ArchetypeLUT.end()) {
+			return search->second;
 		}
 
-		T* get(entity_id entity) {
-			if (entityToIndexLUT.find(entity) == entityToIndexLUT.end()) {
-				return nullptr;
+		Archetype archetype = {};
+		archetype.mask = mask;
+
+		size_t rowSize = sizeof(entity_id);
+
+		for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+			if (mask & (1u << id)) {
+				assert(COMPONENT_INFOS[id].alignment <= COLUMN_ALIGNMENT);
+				rowSize += COMPONENT_INFOS[id].size + sizeof(uint32_t);
+			}
+		}
+
+		// NOTE: Aligning the columns wastes at most one cache line each, so
+		// only a few rows have to be given up for it
+		for (archetype.capacity = static_cast<uint32_t>(CHUNK_SIZE / rowSize); archetype.capacity > 0; --archetype.capacity) {
+			size_t offset = align_up(sizeof(entity_id) * archetype.capacity, COLUMN_ALIGNMENT);
+
+			for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+				if (mask & (1u << id)) {
+					archetype.columnOffsets[id] = offset;
+					offset = align_up(offset + COMPONENT_INFOS[id].size * archetype.capacity, COLUMN_ALIGNMENT);
+					archetype.versionOffsets[id] = offset;
+					offset = align_up(offset + sizeof(uint32_t) * archetype.capacity, COLUMN_ALIGNMENT);
+				}
 			}
 
-			return &components[entityToIndexLUT[entity]];
+			if (offset <= CHUNK_SIZE) {
+				break;
+			}
 		}
 
-		T components[MAX_ENTITIES] = {};
-		std::unordered_map<entity_id, size_t> entityToIndexLUT = {};
-		std::unordered_map<size_t, entity_id> indexToEntityLUT = {};
-		size_t size = 0;
-	};
+		assert(archetype.capacity > 0);
 
-	GLOBAL std::queue<entity_id> g_AvailableEntityIDs = {};
-	GLOBAL uint32_t g_LiveEntityCount = 0;
-	GLOBAL ComponentArray<Transform> g_TransformComponents = {};
-	GLOBAL ComponentArray<Renderable> g_RenderableComponents = {};
-	GLOBAL ComponentArray<Material> g_MaterialComponents = {};
+		const uint32_t index = static_cast<uint32_t>(g_Archetypes.size());
+		g_Archetypes.push_back(std::move(archetype));
+		g_ArchetypeLUT.insert({ mask, index });
 
-	void initialize() {
-		for (entity_id i = 0; i < MAX_ENTITIES; ++i) {
-			g_AvailableEntityIDs.push(i);
+		return index;
+	}
+
+	// Copies the components in `mask` along with their versions. NOTE: A
+	// write to the whole source chunk applies to the copied row from now on.
+	static void copy_row(const Archetype& source, const Chunk& sourceChunk, uint32_t sourceRow, const Archetype& destination, Chunk& destinationChunk, uint32_t destinationRow, ComponentMask mask) {
+		for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+			if (!(mask & (1u << id))) {
+				continue;
+			}
+
+			std::memcpy(
+				get_component_data(destination, destinationChunk, id, destinationRow),
+				get_component_data(source, sourceChunk, id, sourceRow),
+				COMPONENT_INFOS[id].size
+			);
+
+			const uint32_t version = std::max(get_version_column(source, sourceChunk, id)[sourceRow], sourceChunk.writeVersions[id]);
+			get_version_column(destination, destinationChunk, id)[destinationRow] = version;
+			destinationChunk.changeVersions[id] = std::max(destinationChunk.changeVersions[id], version);
 		}
 	}
 
-	void destroy() {
+	// Appends rows for the entities to the archetype, a chunk at a time, and
+	// points their records at them. Every row gets a copy of
+	// `components[id]` for every component of the archetype, or is left
+	// uninitialized without `components`. NOTE: For the components in
+	// `perEntity`, `components[id]` is an array with an element per entity
+	// instead.
+	static void allocate_rows(uint32_t archetypeIndex, const entity_id* entities, uint32_t count, const void* const* components, ComponentMask perEntity = 0) {
+		Archetype& archetype = g_Archetypes[archetypeIndex];
+		const uint32_t version = g_Version.load(std::memory_order_relaxed);
+
+		for (uint32_t i = 0; i < count;) {
+			if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+				Chunk& chunk = archetype.chunks.emplace_back();
+
+				if (!g_FreeChunks.empty()) {
+					chunk.data = std::move(g_FreeChunks.back());
+					g_FreeChunks.pop_back();
+				}
+				else {
+					chunk.data = ChunkData(static_cast<uint8_t*>(::operator new(CHUNK_SIZE, std::align_val_t(COLUMN_ALIGNMENT))));
+				}
+			}
+
+			Chunk& chunk = archetype.chunks.back();
+			const uint32_t chunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+			const uint32_t numRows = std::min(count - i, archetype.capacity - chunk.count);
+
+			std::memcpy(get_entity_column(chunk) + chunk.count, entities + i, sizeof(entity_id) * numRows);
 
+			for (uint32_t row = 0; row < numRows; ++row) {
+				EntityRecord& record = get_entity_record(get_entity_index(entities[i + row]));
+				record.archetype = archetypeIndex;
+				record.chunk = chunkIndex;
+				record.row = chunk.count + row;
+			}
+
+			for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+				if (components == nullptr || !(archetype.mask & (1u << id))) {
+					continue;
+				}
+
+				const size_t size = COMPONENT_INFOS[id].size;
+				uint8_t* column = get_component_data(archetype, chunk, id, chunk.count);
+				uint32_t* versions = get_version_column(archetype, chunk, id) + chunk.count;
+
+				if (perEntity & (1u << id)) {
+					std::memcpy(column, static_cast<const uint8_t*>(components[id]) + size * i, size * numRows);
+				}
+				else {
+					// NOTE: Doubles the rows filled with every copy, so that
+					// most of the column is written by a few large copies
+					std::memcpy(column, components[id], size);
+
+					for (uint32_t filled = 1; filled < numRows; filled *= 2) {
+						std::memcpy(column + size * filled, column, size * std::min(filled, numRows - filled));
+					}
+				}
+
+				std::fill(versions, versions + numRows, version);
+				chunk.changeVersions[id] = version;
+			}
+
+			chunk.count += numRows;
+			i += numRows;
+		}
 	}
 
-	template <typename T>
-	void add_component(entity_id entity, const T& component) {
-		static_assert(sizeof(T) == 0, "add_component is not implemented for this component type.");
+	// Moves the last entity of the archetype into the row, so that the
+	// chunks stay densely packed
+	static void free_row(const EntityRecord& record) {
+		Archetype& archetype = g_Archetypes[record.archetype];
+		Chunk& chunk = archetype.chunks[record.chunk];
+		Chunk& lastChunk = archetype.chunks.back();
+		const uint32_t lastRow = lastChunk.count - 1;
+
+		if (&chunk != &lastChunk || record.row != lastRow) {
+			const entity_id lastEntity = get_entity_column(lastChunk)[lastRow];
+			get_entity_column(chunk)[record.row] = lastEntity;
+			copy_row(archetype, lastChunk, lastRow, archetype, chunk, record.row, archetype.mask);
+
+			EntityRecord& lastRecord = get_entity_record(get_entity_index(lastEntity));
+			lastRecord.chunk = record.chunk;
+			lastRecord.row = record.row;
+		}
+
+		if (--lastChunk.count == 0) {
+			g_FreeChunks.push_back(std::move(lastChunk.data));
+			archetype.chunks.pop_back();
+		}
 	}
 
-	template <>
-	void add_component<Transform>(entity_id entity, const Transform& component) {
-		g_TransformComponents.add(entity, component);
+	// Moves the entity to the archetype of `mask`, along with the
+	// components that both archetypes have
+	static void move_entity(entity_id entity, ComponentMask mask) {
+		const uint32_t archetypeIndex = find_archetype(mask);
+		const EntityRecord source = get_entity_record(get_entity_index(entity));
+		allocate_rows(archetypeIndex, &entity, 1, nullptr);
+		const EntityRecord destination = get_entity_record(get_entity_index(entity));
+
+		Archetype& sourceArchetype = g_Archetypes[source.archetype];
+		Archetype& destinationArchetype = g_Archetypes[archetypeIndex];
+
+		copy_row(
+			sourceArchetype,
+			sourceArchetype.chunks[source.chunk],
+			source.row,
+			destinationArchetype,
+			destinationArchetype.chunks[destination.chunk],
+			destination.row,
+			sourceArchetype.mask & mask
+		);
+
+		free_row(source);
+		++g_StructureVersion;
 	}
 
-	template <>
-	void add_component<Renderable>(entity_id entity, const Renderable& component) {
-		g_RenderableComponents.add(entity, component);
+	void Internal::add_component(entity_id entity, uint32_t id, const void* component) {
+		assert(is_alive(entity));
+		assert(get_component(entity, id, false) == nullptr);
+
+		move_entity(entity, g_Archetypes[get_entity_record(get_entity_index(entity)).archetype].mask | (1u << id));
+		std::memcpy(get_component(entity, id, true), component, COMPONENT_INFOS[id].size);
 	}
 
-	template <>
-	void add_component<Material>(entity_id entity, const Material& component) {
-		g_MaterialComponents.add(entity, component);
+	bool Internal::remove_component(entity_id entity, uint32_t id) {
+		if (get_component(entity, id, false) == nullptr) {
+			return false;
+		}
+
+		move_entity(entity, g_Archetypes[get_entity_record(get_entity_index(entity)).archetype].mask & ~(1u << id));
+		return true;
 	}
 
-	template <typename T>
-	T* get_component(entity_id entity) {
-		static_assert(sizeof(T) == 0, "get_component is not implemented for this component type.");
+	void initialize() {
+		// NOTE: Everything grows on demand, so there is nothing to set up
 	}
 
-	template <>
-	Transform* get_component<Transform>(entity_id entity) {
-		return g_TransformComponents.get(entity);
+	void destroy() {
+		g_LiveEntityCount = 0;
+		g_EntityRecordPages.clear();
+		g_NumEntityIndices = 0;
+		g_FreeEntityIndex = INVALID_INDEX;
+		g_Archetypes.clear();
+		g_ArchetypeLUT.clear();
+		g_FreeChunks.clear();
 	}
 
-	template <>
-	Renderable* get_component<Renderable>(entity_id entity) {
-		return g_RenderableComponents.get(entity);
+	// Hands out indices from the free list first, then new ones
+	static void allocate_entities(entity_id* entities, uint32_t count) {
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t index = g_FreeEntityIndex;
+
+			if (index != INVALID_INDEX) {
+				g_FreeEntityIndex = get_entity_record(index).row;
+			}
+			else {
+				assert(g_NumEntityIndices < INVALID_INDEX);
+				index = g_NumEntityIndices++;
+
+				if (index % ENTITY_PAGE_SIZE == 0) {
+					g_EntityRecordPages.push_back(std::make_unique<EntityRecord[]>(ENTITY_PAGE_SIZE));
+				}
+			}
+
+			entities[i] = make_entity(index, get_entity_record(index).generation);
+		}
+
+		g_LiveEntityCount += count;
 	}
 
-	template <>
-	Material* get_component<Material>(entity_id entity) {
-		return g_MaterialComponents.get(entity);
+	static void create_entities(entity_id* entities, uint32_t count) {
+		allocate_entities(entities, count);
+
+		// Add default entity components
+		const Transform transform = {};
+		const WorldTransform worldTransform = {};
+		const void* components[NUM_COMPONENT_TYPES] = {};
+		components[get_component_id<Transform>()] = &transform;
+		components[get_component_id<WorldTransform>()] = &worldTransform;
+
+		allocate_rows(find_archetype(get_component_mask<Transform, WorldTransform>()), entities, count, components);
+		++g_StructureVersion;
 	}
 
-	template <>
-	bool has_component<Material>(entity_id entity) {
-		return g_MaterialComponents.get(entity) != nullptr;
+	// NOTE: The index goes to the front of the free list
+	static void release_entity(entity_id entity) {
+		assert(is_alive(entity));
+		const uint32_t index = get_entity_index(entity);
+		EntityRecord& record = get_entity_record(index);
+
+		free_row(record);
+		record.archetype = INVALID_INDEX;
+		record.generation++;
+		record.row = g_FreeEntityIndex;
+		g_FreeEntityIndex = index;
 	}
 
 	entity_id create_entity() {
-		assert(g_LiveEntityCount < MAX_ENTITIES);
+		entity_id entity = INVALID_ENTITY;
+		create_entities(&entity, 1);
+
+		return entity;
+	}
 
-		const entity_id id = g_AvailableEntityIDs.front();
-		g_AvailableEntityIDs.pop();
-		++g_LiveEntityCount;
+	void create_entities(uint32_t count, std::vector<entity_id>& entities) {
+		const size_t first = entities.size();
+		entities.resize(first + count);
+		create_entities(entities.data() + first, count);
+	}
 
-		// Add default entity components
-		add_component<Transform>(id, Transform{});
+	void instantiate(const Prefab& prefab, uint32_t count, std::span<const Transform> transforms, std::vector<entity_id>& entities) {
+		assert(transforms.empty() || transforms.size() == count);
+		assert(transforms.empty() || (prefab.m_Mask & get_component_mask<Transform>()));
+
+		const void* components[NUM_COMPONENT_TYPES] = {};
+		get_component_pointers(prefab.m_Components, components, std::make_index_sequence<NUM_COMPONENT_TYPES>{});
+		ComponentMask perEntity = 0;
+
+		if (!transforms.empty()) {
+			components[get_component_id<Transform>()] = transforms.data();
+			perEntity = get_component_mask<Transform>();
+		}
+
+		const size_t first = entities.size();
+		entities.resize(first + count);
+		allocate_entities(entities.data() + first, count);
+
+		allocate_rows(find_archetype(prefab.m_Mask), entities.data() + first, count, components, perEntity);
+		++g_StructureVersion;
+	}
+
+	void destroy_entity(entity_id entity) {
+		assert(g_LiveEntityCount > 0);
+
+		release_entity(entity);
+		--g_LiveEntityCount;
+		++g_StructureVersion;
+	}
+
+	void destroy_entities(std::span<const entity_id> entities) {
+		assert(g_LiveEntityCount >= entities.size());
+
+		// NOTE: Back to front, since entities created together sit in rows
+		// next to each other, so that rows are removed from the end of the
+		// chunks instead of being filled from there
+		for (size_t i = entities.size(); i > 0; --i) {
+			release_entity(entities[i - 1]);
+		}
 
-		return id;
+		g_LiveEntityCount -= static_cast<uint32_t>(entities.size());
+		++g_StructureVersion;
 	}
 
+	uint32_t advance_version() {
+		return g_Version.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint32_t get_structure_version() {
+		return g_StructureVersion;
+	}
+
+	void get_changed_entities(ComponentMask components, uint32_t version, std::vector<entity_id>& entities) {
+		for (const Archetype& archetype : g_Archetypes) {
+			const ComponentMask mask = archetype.mask & components;
+
+			if (mask == 0) {
+				continue;
+			}
+
+			for (const Chunk& chunk : archetype.chunks) {
+				const entity_id* chunkEntities = get_entity_column(chunk);
+				bool allChanged = false;
+				ComponentMask changedMask = 0;
+
+				// NOTE: Chunks without any change since are skipped as a whole
+				for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+					if (mask & (1u << id)) {
+						allChanged |= chunk.writeVersions[id] > version;
+						changedMask |= chunk.changeVersions[id] > version ? 1u << id : 0u;
+					}
+				}
+
+				if (allChanged) {
+					entities.insert(entities.end(), chunkEntities, chunkEntities + chunk.count);
+					continue;
+				}
+
+				if (changedMask == 0) {
+					continue;
+				}
+
+				for (uint32_t row = 0; row < chunk.count; ++row) {
+					for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+						if ((changedMask & (1u << id)) && get_version_column(archetype, chunk, id)[row] > version) {
+							entities.push_back(chunkEntities[row]);
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void for_each_chunk(ComponentMask required, ComponentMask written, const std::function<void(const ChunkView&)>& function) {
+		assert((written & ~required) == 0);
+		const uint32_t version = g_Version.load(std::memory_order_relaxed);
+
+		for (Archetype& archetype : g_Archetypes) {
+			if ((archetype.mask & required) != required) {
+				continue;
+			}
+
+			for (Chunk& chunk : archetype.chunks) {
+				ChunkView view = {};
+				view.entities = get_entity_column(chunk);
+				view.count = chunk.count;
+
+				for (uint32_t id = 0; id < NUM_COMPONENT_TYPES; ++id) {
+					if (written & (1u << id)) {
+						chunk.changeVersions[id] = version;
+						chunk.writeVersions[id] = version;
+					}
+
+					if (archetype.mask & (1u << id)) {
+						view.columns[id] = chunk.data.get() + archetype.columnOffsets[id];
+						view.versions[id] = get_version_column(archetype, chunk, id);
+						view.chunkVersions[id] = chunk.changeVersions[id];
+						view.writeVersions[id] = chunk.writeVersions[id];
+					}
+				}
+
+				function(view);
+			}
+		}
+	}
 }
@@ -3,20 +3,395 @@
 #include "ECS/Components.h"
 #include "Core/platform.h"
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace SR::ECS {
+	template <typename... Ts>
+	struct ComponentList {
+		static constexpr uint32_t SIZE = sizeof...(Ts);
+	};
+
+	// Every component type, the id of a component is its index in the list.
+	// New components only have to be added here. NOTE: Components are moved
+	// between chunks with memcpy, so they have to be trivially copyable.
+	using ComponentRegistry = ComponentList<Transform, Renderable, Material, Parent, WorldTransform>;
+
+	GLOBAL constexpr uint32_t NUM_COMPONENT_TYPES = ComponentRegistry::SIZE;
+
+	// NOTE: Bit i is set for the component with id i
+	using ComponentMask = uint32_t;
+
+	static_assert(NUM_COMPONENT_TYPES <= sizeof(ComponentMask) * 8);
+
+	template <typename T, typename... Ts>
+	constexpr uint32_t find_component_id(ComponentList<Ts...>) {
+		uint32_t id = 0;
+		const bool found = ((std::is_same_v<T, Ts> || (++id, false)) || ...);
+
+		return found ? id : NUM_COMPONENT_TYPES;
+	}
+
+	template <typename T>
+	constexpr uint32_t get_component_id() {
+		constexpr uint32_t id = find_component_id<T>(ComponentRegistry{});
+		static_assert(id < NUM_COMPONENT_TYPES, "The component type is not in the ComponentRegistry.");
+
+		return id;
+	}
+
+	// NOTE: Ignores const, which only marks read-only access
+	template <typename... Ts>
+	constexpr ComponentMask get_component_mask() {
+		return (0u | ... | (1u << get_component_id<std::remove_const_t<Ts>>()));
+	}
+
+	// Entities with the same set of components are stored together in
+	// fixed-size chunks, with one tightly packed column per component.
+	// Every component of every entity also has the version it last changed
+	// in, see advance_version().
+	struct ChunkView {
+		const entity_id* entities = nullptr;
+		void* columns[NUM_COMPONENT_TYPES] = {};
+		const uint32_t* versions[NUM_COMPONENT_TYPES] = {}; // NOTE: Per entity
+		uint32_t chunkVersions[NUM_COMPONENT_TYPES] = {}; // NOTE: The newest change of any entity in the chunk
+		uint32_t writeVersions[NUM_COMPONENT_TYPES] = {}; // NOTE: The last access that may have changed all of them
+		uint32_t count = 0;
+
+		// NOTE: nullptr if the entities in the chunk do not have the component
+		template <typename T>
+		inline T* get() const { return static_cast<T*>(columns[get_component_id<std::remove_const_t<T>>()]); }
+
+		template <typename T>
+		inline bool changed_since(uint32_t version) const {
+			return chunkVersions[get_component_id<std::remove_const_t<T>>()] > version;
+		}
+
+		// NOTE: The entities in the chunk must have the component
+		template <typename T>
+		inline bool changed_since(uint32_t row, uint32_t version) const {
+			constexpr uint32_t id = get_component_id<std::remove_const_t<T>>();
+			return writeVersions[id] > version || versions[id][row] > version;
+		}
+	};
+
+	inline constexpr uint32_t get_entity_index(entity_id entity) { return static_cast<uint32_t>(entity); }
+
+	// NOTE: Changes every time the index is recycled, so that handles of
+	// destroyed entities never match the entities that reuse their index
+	inline constexpr uint32_t get_entity_generation(entity_id entity) { return static_cast<uint32_t>(entity >> 32); }
+
+	// The storage behind the component lookups, which live in this header
+	// so that they inline into their callers
+	namespace Internal {
+		GLOBAL constexpr size_t CHUNK_SIZE = 16 * 1024; // NOTE: In bytes
+		GLOBAL constexpr size_t COLUMN_ALIGNMENT = 64; // NOTE: Columns start on their own cache line
+		GLOBAL constexpr uint32_t INVALID_INDEX = ~0u;
+		GLOBAL constexpr uint32_t ENTITY_PAGE_SIZE = 4096; // NOTE: In entity records
+
+		struct ComponentInfo {
+			size_t size = 0;
+			size_t alignment = 0;
+		};
+
+		template <typename... Ts>
+		constexpr std::array<ComponentInfo, sizeof...(Ts)> get_component_infos(ComponentList<Ts...>) {
+			static_assert((std::is_trivially_copyable_v<Ts> && ...), "Components have to be trivially copyable.");
+			return { ComponentInfo{ sizeof(Ts), alignof(Ts) }... };
+		}
+
+		// NOTE: Indexed by get_component_id()
+		GLOBAL constexpr std::array<ComponentInfo, NUM_COMPONENT_TYPES> COMPONENT_INFOS = get_component_infos(ComponentRegistry{});
+
+		// One of every component, in the order of their ids
+		template <typename... Ts>
+		std::tuple<Ts...> make_component_tuple(ComponentList<Ts...>);
+
+		using ComponentTuple = decltype(make_component_tuple(ComponentRegistry{}));
+
+		template <size_t... Is>
+		inline void get_component_pointers(const ComponentTuple& components, const void* pointers[NUM_COMPONENT_TYPES], std::index_sequence<Is...>) {
+			((pointers[Is] = &std::get<Is>(components)), ...);
+		}
+
+		struct ChunkDeleter {
+			void operator()(uint8_t* data) const {
+				::operator delete(data, std::align_val_t(COLUMN_ALIGNMENT));
+			}
+		};
+
+		using ChunkData = std::unique_ptr<uint8_t, ChunkDeleter>;
+
+		struct Chunk {
+			ChunkData data = {}; // NOTE: The entity column, followed by a component and a version column per component
+			uint32_t count = 0;
+			uint32_t changeVersions[NUM_COMPONENT_TYPES] = {};
+			uint32_t writeVersions[NUM_COMPONENT_TYPES] = {};
+		};
+
+		// All entities with exactly the components in `mask`. NOTE: Every chunk
+		// but the last one is full, so that iterating never skips holes.
+		struct Archetype {
+			ComponentMask mask = 0;
+			uint32_t capacity = 0; // NOTE: Entities per chunk
+			size_t columnOffsets[NUM_COMPONENT_TYPES] = {};
+			size_t versionOffsets[NUM_COMPONENT_TYPES] = {};
+			std::vector<Chunk> chunks = {};
+		};
+
+		// NOTE: While the index is not in use, `row` links to the next free index
+		struct EntityRecord {
+			uint32_t archetype = INVALID_INDEX; // NOTE: INVALID_INDEX if the entity is not alive
+			uint32_t chunk = 0;
+			uint32_t row = 0;
+			uint32_t generation = 0;
+		};
+
+		// NOTE: Inline, so that every translation unit shares them
+		inline std::vector<std::unique_ptr<EntityRecord[]>> g_EntityRecordPages = {}; // NOTE: Allocated as indices are first handed out, never moved
+		inline uint32_t g_NumEntityIndices = 0; // NOTE: Every index below has been handed out at least once
+		inline std::vector<Archetype> g_Archetypes = {};
+		inline std::atomic<uint32_t> g_Version = 1; // NOTE: Version 0 is older than every change
+
+		inline EntityRecord& get_entity_record(uint32_t index) {
+			return g_EntityRecordPages[index / ENTITY_PAGE_SIZE][index % ENTITY_PAGE_SIZE];
+		}
+
+		inline entity_id* get_entity_column(const Chunk& chunk) {
+			return reinterpret_cast<entity_id*>(chunk.data.get());
+		}
+
+		inline uint8_t* get_component_data(const Archetype& archetype, const Chunk& chunk, uint32_t id, uint32_t row) {
+			return chunk.data.get() + archetype.columnOffsets[id] + COMPONENT_INFOS[id].size * row;
+		}
+
+		inline uint32_t* get_version_column(const Archetype& archetype, const Chunk& chunk, uint32_t id) {
+			return reinterpret_cast<uint32_t*>(chunk.data.get() + archetype.versionOffsets[id]);
+		}
+
+		inline void mark_changed(const Archetype& archetype, Chunk& chunk, uint32_t id, uint32_t row) {
+			const uint32_t version = g_Version.load(std::memory_order_relaxed);
+			get_version_column(archetype, chunk, id)[row] = version;
+			chunk.changeVersions[id] = version;
+		}
+
+		inline void* get_component(entity_id entity, uint32_t id, bool markChanged) {
+			const uint32_t index = get_entity_index(entity);
+
+			if (index >= g_NumEntityIndices) {
+				return nullptr;
+			}
+
+			const EntityRecord& record = get_entity_record(index);
+
+			if (record.generation != get_entity_generation(entity) || record.archetype == INVALID_INDEX) {
+				return nullptr;
+			}
+
+			Archetype& archetype = g_Archetypes[record.archetype];
+
+			if (!(archetype.mask & (1u << id))) {
+				return nullptr;
+			}
+
+			Chunk& chunk = archetype.chunks[record.chunk];
+
+			if (markChanged) {
+				mark_changed(archetype, chunk, id, record.row);
+			}
+
+			return get_component_data(archetype, chunk, id, record.row);
+		}
+
+		void add_component(entity_id entity, uint32_t id, const void* component);
+		bool remove_component(entity_id entity, uint32_t id);
+	}
+
 	void initialize();
 	void destroy();
 
+	// NOTE: False for handles of destroyed entities, even once their index
+	// is in use again
+	inline bool is_alive(entity_id entity) {
+		const uint32_t index = get_entity_index(entity);
+
+		if (index >= Internal::g_NumEntityIndices) {
+			return false;
+		}
+
+		const Internal::EntityRecord& record = Internal::get_entity_record(index);
+		return record.generation == get_entity_generation(entity) && record.archetype != Internal::INVALID_INDEX;
+	}
+
 	template <typename T>
-	void add_component(entity_id entity, const T& component);
+	inline void add_component(entity_id entity, const T& component) {
+		Internal::add_component(entity, get_component_id<T>(), &component);
+	}
 
+	// NOTE: Marks the component as changed, use read_component() to only
+	// read it. Adding or removing components, or destroying entities, may
+	// move the components of other entities and invalidate the pointer.
 	template <typename T>
-	T* get_component(entity_id entity);
+	inline T* get_component(entity_id entity) {
+		return static_cast<T*>(Internal::get_component(entity, get_component_id<T>(), true));
+	}
 
 	template <typename T>
-	bool has_component(entity_id entity);
+	inline const T* read_component(entity_id entity) {
+		return static_cast<const T*>(Internal::get_component(entity, get_component_id<T>(), false));
+	}
 
+	template <typename T>
+	inline bool has_component(entity_id entity) {
+		return Internal::get_component(entity, get_component_id<T>(), false) != nullptr;
+	}
+
+	// Returns false if the entity did not have the component
+	template <typename T>
+	inline bool remove_component(entity_id entity) {
+		return Internal::remove_component(entity, get_component_id<T>());
+	}
+
+	// For changes made through pointers that were not just returned by
+	// get_component()
+	template <typename T>
+	inline void mark_changed(entity_id entity) {
+		Internal::get_component(entity, get_component_id<T>(), true);
+	}
+
+	// NOTE: Entities start out with a Transform and a WorldTransform
 	entity_id create_entity();
 
-	GLOBAL constexpr entity_id MAX_ENTITIES = 16384;
+	// Appends `count` new entities to `entities`, with their components
+	// written chunk by chunk
+	void create_entities(uint32_t count, std::vector<entity_id>& entities);
+
+	// A template for entities that share a set of components, with the
+	// values new entities start out with
+	class Prefab {
+	public:
+		// NOTE: Starts out with a Transform and a WorldTransform, just like
+		// create_entity()
+		Prefab() {}
+		~Prefab() {}
+
+		// NOTE: Adds the component if the prefab does not have it yet
+		template <typename T>
+		inline Prefab& set_component(const T& component) {
+			std::get<T>(m_Components) = component;
+			m_Mask |= get_component_mask<T>();
+
+			return *this;
+		}
+
+		template <typename T>
+		inline Prefab& remove_component() {
+			std::get<T>(m_Components) = T{};
+			m_Mask &= ~get_component_mask<T>();
+
+			return *this;
+		}
+
+		// NOTE: nullptr if the prefab does not have the component
+		template <typename T>
+		inline const T* get_component() const {
+			return (m_Mask & get_component_mask<T>()) ? &std::get<T>(m_Components) : nullptr;
+		}
+
+		inline ComponentMask get_mask() const { return m_Mask; }
+
+	private:
+		friend void instantiate(const Prefab& prefab, uint32_t count, std::span<const Transform> transforms, std::vector<entity_id>& entities);
+
+		ComponentMask m_Mask = get_component_mask<Transform, WorldTransform>();
+		Internal::ComponentTuple m_Components = {};
+	};
+
+	// Appends `count` new entities to `entities`, with the components of the
+	// prefab copied in chunk by chunk. Entity i gets `transforms[i]` instead
+	// of the Transform of the prefab, unless `transforms` is empty.
+	// NOTE: The prefab must have a Transform for `transforms` to be used.
+	void instantiate(const Prefab& prefab, uint32_t count, std::span<const Transform> transforms, std::vector<entity_id>& entities);
+
+	// Removes all components of the entity and recycles its index
+	void destroy_entity(entity_id entity);
+
+	// NOTE: Every entity has to be alive and appear only once
+	void destroy_entities(std::span<const entity_id> entities);
+
+	// Returns the current version and starts a new one. Components that
+	// change from now on have a newer version than the one returned, so
+	// consumers keep it around to find out what changed since.
+	// NOTE: Adding a component counts as changing it, removing one does not.
+	uint32_t advance_version();
+
+	// Changes whenever an entity is created, destroyed, or gains or loses a
+	// component, so that consumers know when to rebuild what they derive
+	// from the set of entities
+	uint32_t get_structure_version();
+
+	// Appends the entities whose components in `components` changed after
+	// `version`
+	void get_changed_entities(ComponentMask components, uint32_t version, std::vector<entity_id>& entities);
+
+	template <typename... Ts>
+	inline void get_changed_entities(uint32_t version, std::vector<entity_id>& entities) {
+		get_changed_entities(get_component_mask<Ts...>(), version, entities);
+	}
+
+	// Calls `function` for every chunk of entities that have at least the
+	// components in `required`. The components in `written` are marked as
+	// changed for the whole chunk. NOTE: Entities must not be created,
+	// changed structurally or destroyed from within `function`.
+	void for_each_chunk(ComponentMask required, ComponentMask written, const std::function<void(const ChunkView&)>& function);
+
+	// All entities that have at least the components `Ts`, streamed chunk
+	// by chunk. NOTE: Components that are not const are marked as changed.
+	template <typename... Ts>
+	class View {
+	public:
+		// Calls `function(entity, Ts&...)` for every entity
+		template <typename F>
+		void for_each(F&& function) const {
+			ECS::for_each_chunk(MASK, WRITTEN, [&function](const ChunkView& chunk) {
+				[&chunk, &function](Ts*... columns) {
+					for (uint32_t i = 0; i < chunk.count; ++i) {
+						function(chunk.entities[i], columns[i]...);
+					}
+				}(chunk.get<Ts>()...);
+			});
+		}
+
+		// Calls `function(const ChunkView&)` for every chunk, for loops that
+		// work on whole columns
+		template <typename F>
+		void for_each_chunk(F&& function) const {
+			ECS::for_each_chunk(MASK, WRITTEN, function);
+		}
+
+		uint32_t count() const {
+			uint32_t numEntities = 0;
+			ECS::for_each_chunk(MASK, 0, [&numEntities](const ChunkView& chunk) { numEntities += chunk.count; });
+
+			return numEntities;
+		}
+
+	private:
+		static constexpr ComponentMask MASK = get_component_mask<Ts...>();
+		static constexpr ComponentMask WRITTEN = (0u | ... | (std::is_const_v<Ts> ? 0u : get_component_mask<Ts>()));
+	};
+
+	template <typename... Ts>
+	inline View<Ts...> view() {
+		return {};
+	}
 }
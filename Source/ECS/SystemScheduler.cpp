@@ -0,0 +1,285 @@
+#include "SystemScheduler.h"
+
+#include <cassert>
+
+namespace SR::ECS {
+	GLOBAL thread_local CommandBuffer* t_CommandBuffer = nullptr; // NOTE: Set while a thread runs a task
+
+	// NOTE: Systems that only read the same components never conflict
+	static bool conflicts(const System& a, const System& b) {
+		return
+			(a.get_writes() & (b.get_reads() | b.get_writes())) != 0 ||
+			(a.get_reads() & b.get_writes()) != 0;
+	}
+
+	SystemScheduler::SystemScheduler(uint32_t numWorkers) {
+		for (uint32_t i = 0; i < numWorkers + 1; ++i) {
+			m_Queues.push_back(std::make_unique<WorkQueue>());
+			m_CommandBuffers.push_back(&m_Queues.back()->commands);
+		}
+
+		for (uint32_t i = 0; i < numWorkers; ++i) {
+			m_Workers.emplace_back(&SystemScheduler::run_worker, this, i + 1);
+		}
+	}
+
+	SystemScheduler::~SystemScheduler() {
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+
+		m_WorkCondition.notify_all();
+
+		for (std::thread& worker : m_Workers) {
+			worker.join();
+		}
+	}
+
+	System* SystemScheduler::add_system(const std::string& name) {
+		auto search = m_SystemIndexLUT.find(name);
+
+		if (search != m_SystemIndexLUT.end()) {
+			return m_Systems[search->second].get();
+		}
+
+		m_SystemIndexLUT.insert({ name, m_Systems.size() });
+
+		auto system = std::make_unique<System>(name);
+		System* pSystem = system.get();
+
+		m_Systems.push_back(std::move(system));
+
+		return pSystem;
+	}
+
+	void SystemScheduler::run(float dt) {
+		assert(m_RemainingNodes == 0 && "Systems can not be run from within systems");
+
+		// -------------------------- Build Dependency Graph -----------------------
+		m_NumNodes = 0;
+
+		for (const auto& system : m_Systems) {
+			m_NumNodes += system->m_Enabled ? 1 : 0;
+		}
+
+		if (m_NumNodes == 0) {
+			return;
+		}
+
+		if (m_NumNodes > m_NodeCapacity) {
+			m_Nodes = std::make_unique<Node[]>(m_NumNodes);
+			m_NodeCapacity = m_NumNodes;
+		}
+
+		size_t numNodes = 0;
+
+		for (const auto& system : m_Systems) {
+			if (!system->m_Enabled) {
+				continue;
+			}
+
+			Node& node = m_Nodes[numNodes++];
+			node.system = system.get();
+			node.dependents.clear();
+			node.chunks.clear();
+			node.pendingDependencies = 0;
+			node.pendingTasks = 0;
+
+			// NOTE: Gathered up front, since no system changes the chunks
+			if (system->m_ChunkCallback) {
+				ECS::for_each_chunk(system->m_Reads | system->m_Writes, system->m_Writes, [&node](const ChunkView& chunk) {
+					node.chunks.push_back(chunk);
+				});
+			}
+		}
+
+		// A system waits for the conflicting systems that were added before it
+		std::vector<uint32_t> roots = {};
+
+		for (uint32_t j = 0; j < m_NumNodes; ++j) {
+			for (uint32_t i = 0; i < j; ++i) {
+				if (conflicts(*m_Nodes[i].system, *m_Nodes[j].system)) {
+					m_Nodes[i].dependents.push_back(j);
+					m_Nodes[j].pendingDependencies++;
+				}
+			}
+
+			if (m_Nodes[j].pendingDependencies == 0) {
+				roots.push_back(j);
+			}
+		}
+
+		// ---------------------------------- Execute ------------------------------
+		m_DeltaTime = dt;
+		m_Exception = nullptr;
+		m_RemainingNodes = static_cast<uint32_t>(m_NumNodes);
+
+		for (uint32_t root : roots) {
+			schedule(0, root);
+		}
+
+		while (m_RemainingNodes > 0) {
+			Task task = {};
+
+			if (try_get_task(0, task)) {
+				run_task(0, task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkCondition.wait(lock, [this]() { return m_QueuedTasks > 0 || m_RemainingNodes == 0; });
+		}
+
+		// NOTE: No system is running anymore, so the world can change
+		CommandBuffer::playback(m_CommandBuffers);
+
+		if (m_Exception != nullptr) {
+			std::rethrow_exception(m_Exception);
+		}
+	}
+
+	CommandBuffer& SystemScheduler::get_command_buffer() {
+		assert(t_CommandBuffer != nullptr && "Command buffers can only be used from within systems");
+		return *t_CommandBuffer;
+	}
+
+	void SystemScheduler::run_worker(uint32_t threadIndex) {
+		while (true) {
+			Task task = {};
+
+			if (try_get_task(threadIndex, task)) {
+				run_task(threadIndex, task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkCondition.wait(lock, [this]() { return m_QueuedTasks > 0 || m_Quit; });
+
+			if (m_Quit) {
+				return;
+			}
+		}
+	}
+
+	bool SystemScheduler::try_get_task(uint32_t threadIndex, Task& task) {
+		// NOTE: Own tasks are taken newest first and stolen ones oldest
+		// first, so that thieves take the work furthest from the owner's
+		{
+			WorkQueue& queue = *m_Queues[threadIndex];
+			const std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (!queue.tasks.empty()) {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+				m_QueuedTasks--;
+				return true;
+			}
+		}
+
+		for (size_t i = 1; i < m_Queues.size(); ++i) {
+			WorkQueue& queue = *m_Queues[(threadIndex + i) % m_Queues.size()];
+			const std::lock_guard<std::mutex> lock(queue.mutex);
+
+			if (!queue.tasks.empty()) {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+				m_QueuedTasks--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void SystemScheduler::run_task(uint32_t threadIndex, const Task& task) {
+		Node& node = m_Nodes[task.node];
+		const System& system = *node.system;
+
+		CommandBuffer& commands = m_Queues[threadIndex]->commands;
+		commands.begin_batch((static_cast<uint64_t>(task.node) << 32) | task.firstChunk);
+		t_CommandBuffer = &commands;
+
+		// NOTE: A failing system still completes, so that run() returns
+		try {
+			if (task.numChunks == 0) {
+				if (system.m_ExecuteCallback) {
+					system.m_ExecuteCallback(m_DeltaTime);
+				}
+			}
+			else {
+				for (uint32_t i = task.firstChunk; i < task.firstChunk + task.numChunks; ++i) {
+					system.m_ChunkCallback(node.chunks[i], m_DeltaTime);
+				}
+			}
+		}
+		catch (...) {
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+
+			if (m_Exception == nullptr) {
+				m_Exception = std::current_exception();
+			}
+		}
+
+		t_CommandBuffer = nullptr;
+
+		if (--node.pendingTasks == 0) {
+			finish_node(threadIndex, task.node);
+		}
+	}
+
+	void SystemScheduler::schedule(uint32_t threadIndex, uint32_t nodeIndex) {
+		Node& node = m_Nodes[nodeIndex];
+		std::vector<Task> tasks = {};
+
+		if (!node.system->m_ChunkCallback) {
+			tasks.push_back({ .node = nodeIndex });
+		}
+		else {
+			const uint32_t numChunks = static_cast<uint32_t>(node.chunks.size());
+			const uint32_t chunksPerTask = std::max(m_ChunksPerTask, 1u);
+
+			for (uint32_t first = 0; first < numChunks; first += chunksPerTask) {
+				tasks.push_back({ .node = nodeIndex, .firstChunk = first, .numChunks = std::min(chunksPerTask, numChunks - first) });
+			}
+		}
+
+		if (tasks.empty()) {
+			finish_node(threadIndex, nodeIndex);
+			return;
+		}
+
+		node.pendingTasks = static_cast<uint32_t>(tasks.size());
+
+		{
+			WorkQueue& queue = *m_Queues[threadIndex];
+			const std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.insert(queue.tasks.end(), tasks.begin(), tasks.end());
+		}
+
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_QueuedTasks += static_cast<int64_t>(tasks.size());
+		}
+
+		m_WorkCondition.notify_all();
+	}
+
+	void SystemScheduler::finish_node(uint32_t threadIndex, uint32_t nodeIndex) {
+		for (uint32_t dependent : m_Nodes[nodeIndex].dependents) {
+			if (--m_Nodes[dependent].pendingDependencies == 0) {
+				schedule(threadIndex, dependent);
+			}
+		}
+
+		// NOTE: Only after the dependents are scheduled, so that run() can
+		// not return while some of them are still missing
+		if (--m_RemainingNodes == 0) {
+			{
+				const std::lock_guard<std::mutex> lock(m_Mutex);
+			}
+
+			m_WorkCondition.notify_all();
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ECS/CommandBuffer.h"
+#include "ECS/ECS.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace SR::ECS {
+	// A unit of per-frame work on components. Systems declare the
+	// components they read and write, just like render passes declare
+	// their attachments, so that the scheduler knows which of them can run
+	// at the same time.
+	class System {
+	public:
+		System(const std::string& name) : m_Name(name) {}
+		~System() {}
+
+		template <typename T>
+		inline void add_read() { m_Reads |= 1u << get_component_id<T>(); }
+
+		template <typename T>
+		inline void add_write() { m_Writes |= 1u << get_component_id<T>(); }
+
+		inline const std::string& get_name() const { return m_Name; }
+		inline ComponentMask get_reads() const { return m_Reads; }
+		inline ComponentMask get_writes() const { return m_Writes; }
+
+		// Called once per frame
+		inline void set_execute_callback(std::function<void(float dt)> callback) { m_ExecuteCallback = std::move(callback); }
+
+		// Called once per frame for every chunk of entities that have all the
+		// components the system reads and writes, with chunks in parallel.
+		// The components it writes are marked as changed in those chunks.
+		// NOTE: Replaces the execute callback.
+		inline void set_chunk_callback(std::function<void(const ChunkView& chunk, float dt)> callback) { m_ChunkCallback = std::move(callback); }
+
+		bool m_Enabled = true;
+
+	private:
+		friend class SystemScheduler;
+
+		std::string m_Name;
+		ComponentMask m_Reads = 0;
+		ComponentMask m_Writes = 0;
+		std::function<void(float dt)> m_ExecuteCallback;
+		std::function<void(const ChunkView& chunk, float dt)> m_ChunkCallback;
+	};
+
+	// Runs the systems of a frame on a pool of threads. Every frame, the
+	// enabled systems are ordered into a dependency graph: a system waits for
+	// the systems added before it that write what it reads or writes, or
+	// read what it writes, and every other system runs in parallel. The
+	// chunks of chunk systems are split into tasks, which idle threads steal
+	// from each other.
+	// NOTE: Systems must not create, change structurally or destroy
+	// entities themselves, but record that in get_command_buffer(). Nor may
+	// they touch components they have not declared.
+	class SystemScheduler {
+	public:
+		// NOTE: The thread calling run() works along with the workers
+		SystemScheduler(uint32_t numWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		~SystemScheduler();
+
+		SystemScheduler(const SystemScheduler&) = delete;
+		SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+		System* add_system(const std::string& name);
+
+		// Runs every enabled system once and returns when all of them are
+		// done, after playing back the commands they recorded. The commands
+		// are played back in the order of the systems, and of the chunks
+		// within a system, whichever threads recorded them.
+		// NOTE: Rethrows the first exception thrown by a system.
+		void run(float dt);
+
+		// The command buffer of the calling thread. NOTE: Only from within
+		// a system.
+		static CommandBuffer& get_command_buffer();
+
+		uint32_t m_ChunksPerTask = 4;
+
+	private:
+		struct Task {
+			uint32_t node = 0;
+			uint32_t firstChunk = 0;
+			uint32_t numChunks = 0; // NOTE: 0 for systems without a chunk callback
+		};
+
+		// The per-frame state of an enabled system
+		struct Node {
+			System* system = nullptr;
+			std::vector<uint32_t> dependents = {};
+			std::vector<ChunkView> chunks = {};
+			std::atomic<uint32_t> pendingDependencies = 0;
+			std::atomic<uint32_t> pendingTasks = 0;
+		};
+
+		struct WorkQueue {
+			std::mutex mutex = {};
+			std::deque<Task> tasks = {}; // NOTE: The owner works from the back, thieves from the front
+			CommandBuffer commands = {}; // NOTE: Only used by the owner
+		};
+
+		void run_worker(uint32_t threadIndex);
+		bool try_get_task(uint32_t threadIndex, Task& task);
+		void run_task(uint32_t threadIndex, const Task& task);
+		void schedule(uint32_t threadIndex, uint32_t node);
+		void finish_node(uint32_t threadIndex, uint32_t node);
+
+		std::vector<std::unique_ptr<System>> m_Systems = {};
+		std::unordered_map<std::string, size_t> m_SystemIndexLUT = {};
+
+		// NOTE: Rebuilt every frame
+		std::unique_ptr<Node[]> m_Nodes = {};
+		size_t m_NumNodes = 0;
+		size_t m_NodeCapacity = 0;
+		float m_DeltaTime = 0.0f;
+
+		// NOTE: Index 0 belongs to the thread calling run()
+		std::vector<std::unique_ptr<WorkQueue>> m_Queues = {};
+		std::vector<CommandBuffer*> m_CommandBuffers = {}; // NOTE: Those of the queues
+		std::vector<std::thread> m_Workers = {};
+
+		std::mutex m_Mutex = {};
+		std::condition_variable m_WorkCondition = {};
+		std::atomic<int64_t> m_QueuedTasks = 0; // NOTE: Briefly negative while tasks are being pushed
+		std::atomic<uint32_t> m_RemainingNodes = 0;
+		std::exception_ptr m_Exception = nullptr;
+		bool m_Quit = false;
+	};
+}
@@ -0,0 +1,304 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#include <xmmintrin.h>
+
+namespace SR::ECS {
+	GLOBAL constexpr uint32_t NO_NODE = ~0u;
+
+	// NOTE: [begin, end)
+	struct NodeRange {
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	// NOTE: The nodes are stored breadth-first, so that every level of the
+	// hierarchy is contiguous, and so are the children of every node. The
+	// children of a range of nodes are a range of the next level as well, so
+	// a dirty subtree is a single range per level.
+	struct Hierarchy {
+		std::vector<entity_id> entities = {};
+		std::vector<uint32_t> parents = {}; // NOTE: NO_NODE for roots
+		std::vector<uint32_t> firstChildren = {}; // NOTE: One more than there are nodes, the children of node i end at firstChildren[i + 1]
+		std::vector<uint32_t> depths = {};
+		std::vector<glm::mat4> locals = {};
+		std::vector<glm::mat4> worlds = {};
+		std::vector<uint32_t> nodeIndices = {}; // NOTE: Indexed by entity index, NO_NODE for entities without a Transform
+		uint32_t numLevels = 0;
+
+		uint32_t version = 0;
+		uint32_t structureVersion = 0;
+		bool built = false;
+
+		// NOTE: Kept around, so that updates do not allocate
+		std::vector<std::vector<NodeRange>> dirtyLevels = {};
+		std::vector<entity_id> changedEntities = {};
+	};
+
+	GLOBAL Hierarchy g_Hierarchy = {};
+
+	// Column-major like glm, world = parent * local, where the columns of the
+	// parent are loaded once for all of its children
+	static inline void multiply(const __m128 parent[4], const glm::mat4& local, glm::mat4& world) {
+		const float* l = &local[0][0];
+		float* w = &world[0][0];
+
+		for (uint32_t column = 0; column < 4; ++column) {
+			__m128 result = _mm_mul_ps(parent[0], _mm_set1_ps(l[4 * column + 0]));
+			result = _mm_add_ps(result, _mm_mul_ps(parent[1], _mm_set1_ps(l[4 * column + 1])));
+			result = _mm_add_ps(result, _mm_mul_ps(parent[2], _mm_set1_ps(l[4 * column + 2])));
+			result = _mm_add_ps(result, _mm_mul_ps(parent[3], _mm_set1_ps(l[4 * column + 3])));
+			_mm_storeu_ps(w + 4 * column, result);
+		}
+	}
+
+	// Updates the world matrices of the nodes, whose parents have to be up
+	// to date. NOTE: With `onlyChanges`, world transforms that come out the
+	// same are not marked as changed, so that their consumers do not redo
+	// work for nothing.
+	static void update_nodes(NodeRange range, bool onlyChanges) {
+		Hierarchy& hierarchy = g_Hierarchy;
+		uint32_t loadedParent = NO_NODE;
+		__m128 parent[4] = {};
+
+		for (uint32_t node = range.begin; node < range.end; ++node) {
+			const uint32_t parentNode = hierarchy.parents[node];
+
+			if (parentNode == NO_NODE) {
+				hierarchy.worlds[node] = hierarchy.locals[node];
+			}
+			else {
+				if (parentNode != loadedParent) {
+					const float* p = &hierarchy.worlds[parentNode][0][0];
+
+					for (uint32_t column = 0; column < 4; ++column) {
+						parent[column] = _mm_loadu_ps(p + 4 * column);
+					}
+
+					loadedParent = parentNode;
+				}
+
+				multiply(parent, hierarchy.locals[node], hierarchy.worlds[node]);
+			}
+
+			const entity_id entity = hierarchy.entities[node];
+
+			if (onlyChanges) {
+				const WorldTransform* worldTransform = read_component<WorldTransform>(entity);
+
+				if (worldTransform == nullptr || worldTransform->matrix == hierarchy.worlds[node]) {
+					continue;
+				}
+			}
+
+			if (WorldTransform* worldTransform = get_component<WorldTransform>(entity)) {
+				worldTransform->matrix = hierarchy.worlds[node];
+			}
+		}
+	}
+
+	static void rebuild() {
+		Hierarchy& hierarchy = g_Hierarchy;
+
+		// ----------------------------- Gather Entities ---------------------------
+		std::vector<entity_id> entities = {};
+		std::vector<entity_id> parentEntities = {};
+		std::vector<glm::mat4> locals = {};
+		uint32_t maxIndex = 0;
+
+		view<const Transform>().for_each_chunk([&](const ChunkView& chunk) {
+			const Transform* transforms = chunk.get<const Transform>();
+			const Parent* parents = chunk.get<const Parent>();
+
+			for (uint32_t i = 0; i < chunk.count; ++i) {
+				entities.push_back(chunk.entities[i]);
+				parentEntities.push_back(parents != nullptr ? parents[i].entity : INVALID_ENTITY);
+				locals.push_back(compute_local_matrix(transforms[i]));
+				maxIndex = std::max(maxIndex, get_entity_index(chunk.entities[i]));
+			}
+		});
+
+		const uint32_t numNodes = static_cast<uint32_t>(entities.size());
+
+		// NOTE: Holds the gather index until the nodes are sorted
+		std::vector<uint32_t>& nodeIndices = hierarchy.nodeIndices;
+		nodeIndices.assign(numNodes > 0 ? static_cast<size_t>(maxIndex) + 1 : 0, NO_NODE);
+
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			nodeIndices[get_entity_index(entities[i])] = i;
+		}
+
+		// ----------------------------- Group Children ----------------------------
+		std::vector<uint32_t> parentOf(numNodes, NO_NODE);
+		std::vector<uint32_t> childOffsets(numNodes + 1, 0);
+
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			// NOTE: Handles of destroyed parents may share the index of another node
+			const uint32_t parentIndex = get_entity_index(parentEntities[i]);
+
+			if (parentIndex < nodeIndices.size() && nodeIndices[parentIndex] != NO_NODE && entities[nodeIndices[parentIndex]] == parentEntities[i]) {
+				parentOf[i] = nodeIndices[parentIndex];
+			}
+
+			if (parentOf[i] != NO_NODE) {
+				childOffsets[parentOf[i] + 1]++;
+			}
+		}
+
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			childOffsets[i + 1] += childOffsets[i];
+		}
+
+		std::vector<uint32_t> children(childOffsets[numNodes]);
+		std::vector<uint32_t> fill(childOffsets.begin(), childOffsets.end() - 1);
+
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			if (parentOf[i] != NO_NODE) {
+				children[fill[parentOf[i]]++] = i;
+			}
+		}
+
+		// ------------------------------ Sort Nodes -------------------------------
+		// Breadth-first from the roots, so that the children of every node
+		// end up next to each other and the levels in order
+		std::vector<uint32_t> order = {};
+		order.reserve(numNodes);
+
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			if (parentOf[i] == NO_NODE) {
+				order.push_back(i);
+			}
+		}
+
+		hierarchy.entities.resize(numNodes);
+		hierarchy.parents.resize(numNodes);
+		hierarchy.firstChildren.resize(numNodes + 1);
+		hierarchy.depths.resize(numNodes);
+		hierarchy.locals.resize(numNodes);
+		hierarchy.worlds.resize(numNodes);
+		hierarchy.numLevels = numNodes > 0 ? 1 : 0;
+
+		std::vector<uint32_t> sortedIndices(numNodes, NO_NODE);
+
+		for (uint32_t node = 0; node < order.size(); ++node) {
+			const uint32_t i = order[node];
+			sortedIndices[i] = node;
+
+			const uint32_t parentNode = parentOf[i] != NO_NODE ? sortedIndices[parentOf[i]] : NO_NODE;
+			hierarchy.entities[node] = entities[i];
+			hierarchy.parents[node] = parentNode;
+			hierarchy.depths[node] = parentNode != NO_NODE ? hierarchy.depths[parentNode] + 1 : 0;
+			hierarchy.locals[node] = locals[i];
+			hierarchy.firstChildren[node] = static_cast<uint32_t>(order.size());
+			hierarchy.numLevels = std::max(hierarchy.numLevels, hierarchy.depths[node] + 1);
+
+			order.insert(order.end(), children.begin() + childOffsets[i], children.begin() + childOffsets[i + 1]);
+		}
+
+		// NOTE: Nodes in a cycle have a parent but are never reached from a root
+		if (order.size() != numNodes) {
+			throw std::runtime_error("ECS ERROR: The parents of some entities form a cycle!");
+		}
+
+		hierarchy.firstChildren[numNodes] = numNodes;
+
+		for (uint32_t node = 0; node < numNodes; ++node) {
+			nodeIndices[get_entity_index(hierarchy.entities[node])] = node;
+		}
+
+		if (hierarchy.dirtyLevels.size() < hierarchy.numLevels) {
+			hierarchy.dirtyLevels.resize(hierarchy.numLevels);
+		}
+
+		// NOTE: The levels are in order, so all nodes are updated in one go
+		update_nodes({ 0, numNodes }, true);
+	}
+
+	void update_world_transforms() {
+		Hierarchy& hierarchy = g_Hierarchy;
+		const uint32_t lastVersion = hierarchy.version;
+		hierarchy.version = advance_version();
+
+		hierarchy.changedEntities.clear();
+		get_changed_entities<Parent>(lastVersion, hierarchy.changedEntities);
+
+		if (!hierarchy.built || hierarchy.structureVersion != get_structure_version() || !hierarchy.changedEntities.empty()) {
+			hierarchy.built = false;
+			rebuild();
+			hierarchy.structureVersion = get_structure_version();
+			hierarchy.built = true;
+			return;
+		}
+
+		hierarchy.changedEntities.clear();
+		get_changed_entities<Transform>(lastVersion, hierarchy.changedEntities);
+
+		if (hierarchy.changedEntities.empty()) {
+			return;
+		}
+
+		// ------------------------------ Mark Dirty -------------------------------
+		for (entity_id entity : hierarchy.changedEntities) {
+			assert(get_entity_index(entity) < hierarchy.nodeIndices.size());
+			const uint32_t node = hierarchy.nodeIndices[get_entity_index(entity)];
+			assert(node != NO_NODE && hierarchy.entities[node] == entity);
+
+			hierarchy.locals[node] = compute_local_matrix(*read_component<Transform>(entity));
+			hierarchy.dirtyLevels[hierarchy.depths[node]].push_back({ node, node + 1 });
+		}
+
+		// ---------------------------- Update Subtrees ----------------------------
+		// Level by level, so that parents are always done before their children
+		for (uint32_t level = 0; level < hierarchy.numLevels; ++level) {
+			std::vector<NodeRange>& dirty = hierarchy.dirtyLevels[level];
+
+			if (dirty.empty()) {
+				continue;
+			}
+
+			// NOTE: Nodes may have changed along with their ancestors, and
+			// neighboring subtrees are updated in one go
+			std::sort(dirty.begin(), dirty.end(), [](NodeRange a, NodeRange b) { return a.begin < b.begin; });
+			size_t numRanges = 0;
+
+			for (const NodeRange& range : dirty) {
+				if (numRanges > 0 && range.begin <= dirty[numRanges - 1].end) {
+					dirty[numRanges - 1].end = std::max(dirty[numRanges - 1].end, range.end);
+				}
+				else {
+					dirty[numRanges++] = range;
+				}
+			}
+
+			dirty.resize(numRanges);
+
+			for (const NodeRange& range : dirty) {
+				update_nodes(range, false);
+
+				const NodeRange children = { hierarchy.firstChildren[range.begin], hierarchy.firstChildren[range.end] };
+
+				if (children.begin < children.end) {
+					hierarchy.dirtyLevels[level + 1].push_back(children);
+				}
+			}
+
+			dirty.clear();
+		}
+	}
+
+	glm::mat4 compute_local_matrix(const Transform& transform) {
+		// NOTE: Same as translate(position) * mat4_cast(orientation) * scale(scale)
+		const glm::mat3 rotation = glm::mat3_cast(transform.orientation);
+
+		return glm::mat4(
+			glm::vec4(rotation[0] * transform.scale.x, 0.0f),
+			glm::vec4(rotation[1] * transform.scale.y, 0.0f),
+			glm::vec4(rotation[2] * transform.scale.z, 0.0f),
+			glm::vec4(transform.position, 1.0f)
+		);
+	}
+}
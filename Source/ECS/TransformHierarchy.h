@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ECS/ECS.h"
+
+namespace SR::ECS {
+	// Brings the WorldTransform of every entity with a Transform up to date.
+	// Only the entities whose Transform changed since the last call, and
+	// their descendants, are updated, unless entities were created, changed
+	// structurally or destroyed, or a Parent changed, in which case the
+	// hierarchy is rebuilt first.
+	// NOTE: An entity whose parent has no Transform, or is no longer alive,
+	// is a root. Throws if the parents form a cycle.
+	void update_world_transforms();
+
+	// Translation * rotation * scale
+	glm::mat4 compute_local_matrix(const Transform& transform);
+}
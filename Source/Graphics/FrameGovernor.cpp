@@ -0,0 +1,112 @@
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace SR {
+	// Weight of the newest frame in the exponential moving average
+	static constexpr double SMOOTHING_FACTOR = 0.1;
+
+	// Largest change of the resolution scale at once, since it's the most
+	// visible setting
+	static constexpr float MAX_RESOLUTION_SCALE_STEP = 0.25f;
+
+	bool FrameGovernor::update(double frameTime, Settings& settings) {
+		if (frameTime <= 0.0) {
+			return false;
+		}
+
+		m_AverageFrameTime = m_AverageFrameTime == 0.0 ?
+			frameTime :
+			m_AverageFrameTime + SMOOTHING_FACTOR * (frameTime - m_AverageFrameTime);
+
+		if (m_Cooldown > 0) {
+			m_Cooldown--;
+			return false;
+		}
+
+		if (m_AverageFrameTime > m_TargetFrameTime * (1.0 + m_Tolerance)) {
+			m_FramesOverBudget++;
+			m_FramesUnderBudget = 0;
+		}
+		else if (m_AverageFrameTime < m_TargetFrameTime * (1.0 - m_Tolerance)) {
+			m_FramesUnderBudget++;
+			m_FramesOverBudget = 0;
+		}
+		else {
+			m_FramesOverBudget = 0;
+			m_FramesUnderBudget = 0;
+		}
+
+		if (m_FramesOverBudget < m_SettleFrames && m_FramesUnderBudget < m_SettleFrames) {
+			return false;
+		}
+
+		const Settings oldSettings = settings;
+
+		// NOTE: The cost of a frame is assumed to be roughly proportional to
+		// the workload, so the ratio tells how much the workload should change
+		const double ratio = m_TargetFrameTime / m_AverageFrameTime;
+
+		if (m_FramesOverBudget >= m_SettleFrames) {
+			decrease_workload(ratio, settings);
+		}
+		else {
+			increase_workload(ratio, settings);
+		}
+
+		const bool changed =
+			settings.samplesPerPixel != oldSettings.samplesPerPixel ||
+			settings.rayBounces != oldSettings.rayBounces ||
+			settings.resolutionScale != oldSettings.resolutionScale;
+
+		m_FramesOverBudget = 0;
+		m_FramesUnderBudget = 0;
+
+		if (changed) {
+			// Measurements of the old settings no longer apply
+			m_AverageFrameTime = 0.0;
+			m_Cooldown = m_SettleFrames;
+		}
+
+		return changed;
+	}
+
+	void FrameGovernor::reset() {
+		m_AverageFrameTime = 0.0;
+		m_FramesOverBudget = 0;
+		m_FramesUnderBudget = 0;
+		m_Cooldown = m_SettleFrames;
+	}
+
+	void FrameGovernor::decrease_workload(double ratio, Settings& settings) const {
+		if (settings.samplesPerPixel > m_MinSamplesPerPixel) {
+			const uint32_t samples = static_cast<uint32_t>(std::floor(settings.samplesPerPixel * ratio));
+			settings.samplesPerPixel = std::clamp(samples, m_MinSamplesPerPixel, settings.samplesPerPixel - 1);
+		}
+		else if (m_AdjustRayBounces && settings.rayBounces > m_MinRayBounces) {
+			settings.rayBounces--;
+		}
+		else if (m_AdjustResolutionScale && settings.resolutionScale > m_MinResolutionScale) {
+			// NOTE: The cost scales with the pixel count, i.e. the square of the scale
+			const float step = std::max(static_cast<float>(std::sqrt(ratio)), 1.0f - MAX_RESOLUTION_SCALE_STEP);
+			settings.resolutionScale = std::max(settings.resolutionScale * step, m_MinResolutionScale);
+		}
+	}
+
+	void FrameGovernor::increase_workload(double ratio, Settings& settings) const {
+		if (m_AdjustResolutionScale && settings.resolutionScale < 1.0f) {
+			const float step = std::min(static_cast<float>(std::sqrt(ratio)), 1.0f + MAX_RESOLUTION_SCALE_STEP);
+			settings.resolutionScale = std::min(settings.resolutionScale * step, 1.0f);
+		}
+		else if (m_AdjustRayBounces && settings.rayBounces < m_MaxRayBounces) {
+			settings.rayBounces++;
+		}
+		else if (settings.samplesPerPixel < m_MaxSamplesPerPixel) {
+			// NOTE: Aim for the middle of the band, so that the new setting
+			// doesn't immediately end up over budget
+			const uint32_t samples = static_cast<uint32_t>(std::floor(settings.samplesPerPixel * ratio * (1.0 - 0.5 * m_Tolerance)));
+			settings.samplesPerPixel = std::clamp(samples, settings.samplesPerPixel + 1, m_MaxSamplesPerPixel);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+namespace SR {
+	// Adjusts the per-frame path tracing workload so that the GPU frame time
+	// stays close to a target. Samples per pixel are adjusted first. Ray
+	// bounces and the resolution scale can optionally be lowered as well,
+	// but only once samples are at their minimum, and they are the first
+	// to be restored.
+	// NOTE: Frame times are smoothed, and settings only change once the
+	// average has been outside a tolerance band around the target for a
+	// number of frames in a row, followed by a cooldown that lets the
+	// measurements catch up. This hysteresis keeps the governor from
+	// oscillating between two settings.
+	class FrameGovernor {
+	public:
+		struct Settings {
+			uint32_t samplesPerPixel = 1;
+			uint32_t rayBounces = 8;
+			float resolutionScale = 1.0f;
+		};
+
+		FrameGovernor() = default;
+		~FrameGovernor() {}
+
+		// Feeds the GPU time of the last completed frame. Returns true if
+		// `settings` were changed.
+		bool update(double frameTime, Settings& settings);
+
+		// Forgets the measurements, e.g. after the workload changed for a
+		// different reason
+		void reset();
+
+		inline double get_average_frame_time() const { return m_AverageFrameTime; }
+
+		double m_TargetFrameTime = 14.0; // NOTE: In milliseconds, leaves some headroom for 60 Hz vsync
+		double m_Tolerance = 0.15; // NOTE: Relative half-width of the band where nothing changes
+		uint32_t m_SettleFrames = 8; // NOTE: Frames outside the band before acting, and the cooldown after
+
+		uint32_t m_MinSamplesPerPixel = 1;
+		uint32_t m_MaxSamplesPerPixel = 64;
+
+		bool m_AdjustRayBounces = false;
+		uint32_t m_MinRayBounces = 2;
+		uint32_t m_MaxRayBounces = 8;
+
+		bool m_AdjustResolutionScale = false;
+		float m_MinResolutionScale = 0.5f;
+
+	private:
+		void decrease_workload(double ratio, Settings& settings) const;
+		void increase_workload(double ratio, Settings& settings) const;
+
+		double m_AverageFrameTime = 0.0;
+		uint32_t m_FramesOverBudget = 0;
+		uint32_t m_FramesUnderBudget = 0;
+		uint32_t m_Cooldown = 0;
+	};
+}
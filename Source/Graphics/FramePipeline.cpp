@@ -0,0 +1,237 @@
+#include "FramePipeline.h"
+
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+namespace SR {
+	// Pipeline stage
+	void PipelineStage::add_input(const std::string& name) {
+		m_Inputs.push_back(name);
+	}
+
+	void PipelineStage::add_output(const std::string& name) {
+		m_Outputs.push_back(name);
+	}
+
+	void PipelineStage::execute(PipelineFrame& frame) {
+		if (m_ExecuteCallback) {
+			m_ExecuteCallback(frame);
+		}
+	}
+
+	// Frame queue
+	void FramePipeline::FrameQueue::push(PipelineFrame&& frame) {
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_NotFull.wait(lock, [this]() { return m_Frames.size() < m_Capacity || m_Closed; });
+			m_Frames.push_back(std::move(frame));
+		}
+
+		m_NotEmpty.notify_one();
+	}
+
+	bool FramePipeline::FrameQueue::pop(PipelineFrame& frame) {
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_NotEmpty.wait(lock, [this]() { return !m_Frames.empty() || m_Closed; });
+
+			if (m_Frames.empty()) {
+				return false;
+			}
+
+			frame = std::move(m_Frames.front());
+			m_Frames.pop_front();
+		}
+
+		m_NotFull.notify_one();
+		return true;
+	}
+
+	void FramePipeline::FrameQueue::close() {
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Closed = true;
+		}
+
+		m_NotFull.notify_all();
+		m_NotEmpty.notify_all();
+	}
+
+	// Frame pipeline
+	FramePipeline::~FramePipeline() {
+		// NOTE: Frames already submitted still make it through every stage,
+		// each worker closes the queue behind it once its own one is drained
+		if (!m_Queues.empty()) {
+			m_Queues.front()->close();
+		}
+
+		for (std::thread& worker : m_Workers) {
+			worker.join();
+		}
+	}
+
+	PipelineStage* FramePipeline::add_stage(const std::string& name) {
+		assert(m_Workers.empty() && "Stages must be added before the pipeline is built");
+
+		auto search = m_StageIndexLUT.find(name);
+
+		if (search != m_StageIndexLUT.end()) {
+			return m_Stages[search->second].get();
+		}
+
+		m_StageIndexLUT.insert({ name, m_Stages.size() });
+
+		auto stage = std::make_unique<PipelineStage>(name);
+		PipelineStage* pStage = stage.get();
+
+		m_Stages.push_back(std::move(stage));
+
+		return pStage;
+	}
+
+	void FramePipeline::build() {
+		assert(!m_Stages.empty());
+		assert(m_Workers.empty());
+
+		// Which stage writes each image
+		std::unordered_map<std::string, size_t> writers = {};
+
+		for (size_t s = 0; s < m_Stages.size(); ++s) {
+			for (const std::string& output : m_Stages[s]->get_outputs()) {
+				if (!writers.insert({ output, s }).second) {
+					throw std::runtime_error("PIPELINE ERROR: Image \"" + output + "\" is written by more than one stage!");
+				}
+			}
+		}
+
+		// NOTE: Stages run in the order they were added, unless one of them
+		// reads an image that a later one writes
+		std::vector<bool> scheduled(m_Stages.size(), false);
+
+		while (m_Order.size() < m_Stages.size()) {
+			bool progress = false;
+
+			for (size_t s = 0; s < m_Stages.size(); ++s) {
+				if (scheduled[s]) {
+					continue;
+				}
+
+				bool ready = true;
+
+				for (const std::string& input : m_Stages[s]->get_inputs()) {
+					auto writer = writers.find(input);
+
+					if (writer != writers.end() && writer->second != s && !scheduled[writer->second]) {
+						ready = false;
+						break;
+					}
+				}
+
+				if (ready) {
+					scheduled[s] = true;
+					m_Order.push_back(m_Stages[s].get());
+					progress = true;
+					break;
+				}
+			}
+
+			if (!progress) {
+				throw std::runtime_error("PIPELINE ERROR: The stages depend on each other in a cycle!");
+			}
+		}
+
+		// Images are released after the last stage that reads them, so that
+		// frames get lighter as they move along
+		std::unordered_map<std::string, size_t> lastReaders = {};
+
+		for (size_t i = 0; i < m_Order.size(); ++i) {
+			for (const std::string& input : m_Order[i]->get_inputs()) {
+				lastReaders[input] = i;
+			}
+		}
+
+		m_ReleasedImages.resize(m_Order.size());
+
+		for (const auto& [image, order] : lastReaders) {
+			m_ReleasedImages[order].push_back(image);
+		}
+
+		for (size_t i = 0; i < m_Order.size(); ++i) {
+			m_Queues.push_back(std::make_unique<FrameQueue>(m_QueueCapacity));
+		}
+
+		for (size_t i = 0; i < m_Order.size(); ++i) {
+			m_Workers.emplace_back(&FramePipeline::run_stage, this, i);
+		}
+	}
+
+	void FramePipeline::submit(PipelineFrame&& frame) {
+		assert(!m_Workers.empty() && "The pipeline has to be built first");
+
+		{
+			const std::lock_guard<std::mutex> lock(m_FlushMutex);
+			m_FramesInFlight++;
+		}
+
+		m_Queues.front()->push(std::move(frame));
+	}
+
+	void FramePipeline::flush() {
+		std::unique_lock<std::mutex> lock(m_FlushMutex);
+		m_FlushCondition.wait(lock, [this]() { return m_FramesInFlight == 0; });
+	}
+
+	void FramePipeline::run_stage(size_t order) {
+		PipelineStage& stage = *m_Order[order];
+		FrameQueue& input = *m_Queues[order];
+		FrameQueue* output = order + 1 < m_Queues.size() ? m_Queues[order + 1].get() : nullptr;
+
+		PipelineFrame frame = {};
+
+		while (input.pop(frame)) {
+			bool succeeded = true;
+
+			// NOTE: A failing frame is dropped, the ones behind it still go on
+			try {
+				stage.execute(frame);
+			}
+			catch (const std::exception& exception) {
+				std::cerr << "Pipeline stage \"" << stage.get_name() << "\" failed on frame " << frame.index << ": " << exception.what() << '\n';
+				succeeded = false;
+			}
+			catch (...) {
+				// NOTE: Would otherwise leave the worker thread and terminate
+				std::cerr << "Pipeline stage \"" << stage.get_name() << "\" failed on frame " << frame.index << ": Unknown exception\n";
+				succeeded = false;
+			}
+
+			if (!succeeded || output == nullptr) {
+				frame = {};
+				finish_frame();
+				continue;
+			}
+
+			for (const std::string& image : m_ReleasedImages[order]) {
+				frame.images.erase(image);
+			}
+
+			output->push(std::move(frame));
+			frame = {};
+		}
+
+		if (output != nullptr) {
+			output->close();
+		}
+	}
+
+	void FramePipeline::finish_frame() {
+		{
+			const std::lock_guard<std::mutex> lock(m_FlushMutex);
+			m_FramesInFlight--;
+		}
+
+		m_FlushCondition.notify_all();
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace SR {
+	// A frame on its way through the pipeline. Stages read and write named
+	// images, just like render passes do with attachments.
+	struct PipelineFrame {
+		uint64_t index = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::unordered_map<std::string, std::vector<float>> images = {};
+	};
+
+	class PipelineStage {
+	public:
+		PipelineStage(const std::string& name) : m_Name(name) {}
+		~PipelineStage() {}
+
+		void add_input(const std::string& name);
+		void add_output(const std::string& name);
+		void execute(PipelineFrame& frame);
+
+		inline const std::string& get_name() const { return m_Name; }
+		inline const std::vector<std::string>& get_inputs() const { return m_Inputs; }
+		inline const std::vector<std::string>& get_outputs() const { return m_Outputs; }
+		inline void set_execute_callback(std::function<void(PipelineFrame& frame)> callback) { m_ExecuteCallback = std::move(callback); }
+
+	private:
+		std::string m_Name;
+		std::function<void(PipelineFrame& frame)> m_ExecuteCallback;
+
+		std::vector<std::string> m_Inputs = {};
+		std::vector<std::string> m_Outputs = {};
+	};
+
+	// Runs the CPU side of sequence rendering (resolving, post-processing,
+	// encoding, ...) as a pipeline, with one thread per stage. While the
+	// GPU traces frame N+1, frame N is being processed and frame N-1
+	// written, so a sequence renders about as fast as its slowest stage.
+	// NOTE: Every stage is fed by a bounded queue. Once a queue is full, the
+	// stage in front of it waits, and ultimately so does submit(), which
+	// keeps a slow disk from piling up frames in memory.
+	class FramePipeline {
+	public:
+		FramePipeline(size_t queueCapacity = 2) : m_QueueCapacity(queueCapacity) {}
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+
+		PipelineStage* add_stage(const std::string& name);
+
+		// Orders the stages by their inputs and outputs and starts the
+		// worker threads. NOTE: Inputs that no stage writes have to be
+		// provided by the submitted frames.
+		void build();
+
+		// Blocks while the first stage has no room for another frame
+		void submit(PipelineFrame&& frame);
+
+		// Blocks until every submitted frame has left the last stage
+		void flush();
+
+	private:
+		class FrameQueue {
+		public:
+			FrameQueue(size_t capacity) : m_Capacity(capacity) {}
+
+			void push(PipelineFrame&& frame);
+			bool pop(PipelineFrame& frame); // NOTE: False once closed and drained
+			void close();
+
+		private:
+			std::mutex m_Mutex = {};
+			std::condition_variable m_NotFull = {};
+			std::condition_variable m_NotEmpty = {};
+			std::deque<PipelineFrame> m_Frames = {};
+			size_t m_Capacity;
+			bool m_Closed = false;
+		};
+
+		void run_stage(size_t order);
+		void finish_frame();
+
+		size_t m_QueueCapacity;
+		std::vector<std::unique_ptr<PipelineStage>> m_Stages = {};
+		std::unordered_map<std::string, size_t> m_StageIndexLUT = {};
+
+		// NOTE: Built by build(), indexed by the position in the execution order
+		std::vector<PipelineStage*> m_Order = {};
+		std::vector<std::vector<std::string>> m_ReleasedImages = {}; // NOTE: Images no later stage reads
+		std::vector<std::unique_ptr<FrameQueue>> m_Queues = {};
+		std::vector<std::thread> m_Workers = {};
+
+		std::mutex m_FlushMutex = {};
+		std::condition_variable m_FlushCondition = {};
+		uint64_t m_FramesInFlight = 0;
+	};
+}
@@ -18,11 +18,17 @@ namespace SR {
 
 		inline virtual uint32_t get_frame_index() const final { return m_CurrentFrame; }
 		inline virtual uint64_t get_frame_count() const final { return m_FrameCount; }
+		inline virtual uint64_t get_completed_frame_count() const final { return m_CompletedFrameCount; }
 
 		// --------------------------- Resource Creation ---------------------------
 		virtual void create_swapchain(const SwapChainInfo& info, SwapChain& swapChain) = 0;
 		virtual void create_pipeline(const PipelineInfo& info, Pipeline& pipeline) = 0;
 		virtual void create_buffer(const BufferInfo& info, Buffer& buffer, const void* data) = 0;
+
+		// NOTE: Creates a Usage::DEFAULT buffer with the contents of a
+		// Usage::UPLOAD buffer that the caller has filled, which saves a copy
+		// when the data is not in one piece in memory
+		virtual void create_buffer_from_staging(const BufferInfo& info, Buffer& buffer, const Buffer& stagingBuffer) = 0;
 		virtual void create_shader(ShaderStage stage, const std::string& path, Shader& shader) = 0;
 		virtual void create_texture(const TextureInfo& info, Texture& texture, const SubresourceData* data) = 0;
 		virtual void create_sampler(const SamplerInfo& info, Sampler& sampler) = 0;
@@ -53,6 +59,11 @@ namespace SR {
 		virtual void begin_render_pass(const PassInfo& passInfo, const CommandList& cmdList) = 0;
 		virtual void end_render_pass(const SwapChain& swapChain, const CommandList& cmdList) = 0;
 		virtual void end_render_pass(const CommandList& cmdList) = 0;
+
+		// NOTE: Waits for the GPU to complete the frame before returning, so
+		// while the next one is recorded, the CPU is free to rewrite or read
+		// back any mapped buffer that earlier frames used. Passes that do so
+		// can check get_completed_frame_count() against get_frame_count().
 		virtual void submit_command_lists(const SwapChain& swapChain) = 0;
 
 		// ----------------------------- Draw Commands -----------------------------
@@ -60,6 +71,23 @@ namespace SR {
 		virtual void draw_indexed(uint32_t indexCount, uint32_t startIndex, uint32_t baseVertex, const CommandList& cmdList) = 0;
 		virtual void draw_instanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance, const CommandList& cmdList) = 0;
 
+		// ----------------------------- Copy Commands -----------------------------
+		// NOTE: Copies mip 0 between a texture in the UNORDERED_ACCESS state and
+		// a tightly packed region of a buffer, starting at the given offset
+		virtual void copy_texture_to_buffer(const Texture& src, const Buffer& dst, uint64_t dstOffset, const CommandList& cmdList) = 0;
+		virtual void copy_buffer_to_texture(const Buffer& src, uint64_t srcOffset, const Texture& dst, const CommandList& cmdList) = 0;
+
+		// NOTE: Waits for earlier shader reads of `dst`, and makes the copy
+		// visible to later ones
+		virtual void copy_buffer(const Buffer& src, uint64_t srcOffset, const Buffer& dst, uint64_t dstOffset, uint64_t size, const CommandList& cmdList) = 0;
+
+		// ------------------------------ GPU Timing -------------------------------
+		virtual void write_timestamp(uint32_t queryIndex, const CommandList& cmdList) = 0;
+
+		// GPU time between two timestamps of the last completed frame. Returns
+		// false if either of them was not written in that frame.
+		virtual bool get_timestamp_elapsed(uint32_t beginQuery, uint32_t endQuery, double& milliseconds) = 0;
+
 		// ----------------------------- Miscellaneous -----------------------------
 		virtual uint32_t get_descriptor_index(const Resource& resource, SubresourceType type) = 0;
 		virtual uint64_t get_bda(const Buffer& buffer) = 0;
@@ -73,11 +101,13 @@ namespace SR {
 		static constexpr uint32_t MAX_SAMPLER_DESCRIPTORS = 16;
 		static constexpr uint32_t MAX_STORAGE_BUFFERS = 256;
 		static constexpr uint32_t MAX_RAY_TRACING_TLASES = 1;
+		static constexpr uint32_t MAX_TIMESTAMP_QUERIES = 16;
 
 	protected:
 		Window& m_Window;
 		uint32_t m_CurrentImageIndex = 0;
 		uint32_t m_CurrentFrame = 0;
 		uint64_t m_FrameCount = 0;
+		uint64_t m_CompletedFrameCount = 0; // NOTE: Frames the GPU is known to have completed
 	};
 }
@@ -39,6 +39,7 @@ namespace SR {
 		BUFFER_RAW = 1 << 2,
 		BUFFER_STRUCTURED = 1 << 3,
 		RAY_TRACING = 1 << 4,
+		PREFER_DEVICE_LOCAL = 1 << 5, // NOTE: Usage::UPLOAD only, for buffers the GPU accesses far more than the CPU, and the CPU only writes
 	};
 
 	enum class Filter : uint8_t {
@@ -335,6 +336,9 @@ namespace SR {
 		std::vector<RTShaderGroup> shaderGroups = {};
 		uint32_t maxRayRecursionDepth = 1;
 		uint32_t payloadSize = 0;
+
+		// NOTE: Value i is assigned to constant_id i, in all shader stages
+		std::vector<uint32_t> specializationConstants = {};
 	};
 
 	struct RTPipeline {
@@ -0,0 +1,732 @@
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <immintrin.h>
+
+namespace SR {
+	static constexpr uint32_t HISTOGRAM_BINS = 128; // NOTE: Bin 0 collects everything too dark to matter
+	static constexpr float HISTOGRAM_MIN_LOG2 = -16.0f;
+	static constexpr float HISTOGRAM_MAX_LOG2 = 16.0f;
+	static constexpr float MIDDLE_GRAY = 0.18f;
+	static constexpr uint32_t ENCODE_LUT_SIZE = 4096;
+	static constexpr uint32_t MIN_BLOOM_LEVEL_SIZE = 8;
+
+	static float srgb_encode(float value) {
+		return value <= 0.0031308f ? 12.92f * value : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	static inline __m128 tonemap_aces(__m128 x) {
+		const __m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+		const __m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+
+		return _mm_div_ps(numerator, denominator);
+	}
+
+	static inline __m128 hable_curve(__m128 x) {
+		constexpr float A = 0.15f; // NOTE: Shoulder strength
+		constexpr float B = 0.50f; // NOTE: Linear strength
+		constexpr float C = 0.10f; // NOTE: Linear angle
+		constexpr float D = 0.20f; // NOTE: Toe strength
+		constexpr float E = 0.02f; // NOTE: Toe numerator
+		constexpr float F = 0.30f; // NOTE: Toe denominator
+
+		const __m128 ax = _mm_mul_ps(x, _mm_set1_ps(A));
+		const __m128 numerator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(ax, _mm_set1_ps(C * B))), _mm_set1_ps(D * E));
+		const __m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(ax, _mm_set1_ps(B))), _mm_set1_ps(D * F));
+
+		return _mm_sub_ps(_mm_div_ps(numerator, denominator), _mm_set1_ps(E / F));
+	}
+
+	static inline __m128 tonemap_filmic(__m128 x) {
+		constexpr float WHITE_POINT = 11.2f;
+		static const float whiteScale = 1.0f / _mm_cvtss_f32(hable_curve(_mm_set_ss(WHITE_POINT)));
+
+		return _mm_mul_ps(hable_curve(_mm_add_ps(x, x)), _mm_set1_ps(whiteScale));
+	}
+
+	static inline __m128 tonemap(__m128 x, Tonemapper tonemapper) {
+		switch (tonemapper) {
+		case Tonemapper::ACES:
+			x = tonemap_aces(x);
+			break;
+		case Tonemapper::FILMIC:
+			x = tonemap_filmic(x);
+			break;
+		default:
+			break;
+		}
+
+		// NOTE: The operand order makes NaNs turn into 0
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	// Histogram bins of four luminance values. The logarithm is approximated
+	// by reading the float bits as exponent plus a linear mantissa, which is
+	// off by less than 0.09 stops, well below the bin width.
+	static inline __m128i luminance_bins(__m128 luminance) {
+		const __m128 bits = _mm_cvtepi32_ps(_mm_castps_si128(_mm_max_ps(luminance, _mm_set1_ps(FLT_MIN))));
+		const __m128 log2 = _mm_sub_ps(_mm_mul_ps(bits, _mm_set1_ps(1.0f / 8388608.0f)), _mm_set1_ps(127.0f));
+
+		constexpr float BINS_PER_STOP = HISTOGRAM_BINS / (HISTOGRAM_MAX_LOG2 - HISTOGRAM_MIN_LOG2);
+		__m128 bin = _mm_mul_ps(_mm_sub_ps(log2, _mm_set1_ps(HISTOGRAM_MIN_LOG2)), _mm_set1_ps(BINS_PER_STOP));
+		bin = _mm_min_ps(_mm_max_ps(bin, _mm_setzero_ps()), _mm_set1_ps(static_cast<float>(HISTOGRAM_BINS - 1)));
+
+		return _mm_cvttps_epi32(bin);
+	}
+
+	// Bilinear upsampling of `src` to the size of the output, blended with
+	// `base` as `base * baseWeight + upsampled * srcWeight`. NOTE: `base`
+	// may alias `out`.
+	static void upsample_row(const float* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t y, uint32_t height,
+		const uint32_t* x0, const uint32_t* x1, const float* fx, uint32_t width,
+		const float* base, float* out, float baseWeight, float srcWeight) {
+
+		const float sy = std::clamp((static_cast<float>(y) + 0.5f) * srcHeight / height - 0.5f, 0.0f, static_cast<float>(srcHeight - 1));
+		const uint32_t y0 = static_cast<uint32_t>(sy);
+		const uint32_t y1 = std::min(y0 + 1, srcHeight - 1);
+		const float fy = sy - static_cast<float>(y0);
+
+		const float* row0 = src + 3 * static_cast<size_t>(y0) * srcWidth;
+		const float* row1 = src + 3 * static_cast<size_t>(y1) * srcWidth;
+
+		for (uint32_t x = 0; x < width; ++x) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				const float top = row0[3 * x0[x] + c] + (row0[3 * x1[x] + c] - row0[3 * x0[x] + c]) * fx[x];
+				const float bottom = row1[3 * x0[x] + c] + (row1[3 * x1[x] + c] - row1[3 * x0[x] + c]) * fx[x];
+				const size_t i = 3 * static_cast<size_t>(x) + c;
+
+				out[i] = base[i] * baseWeight + (top + (bottom - top) * fy) * srcWeight;
+			}
+		}
+	}
+
+	// Source columns and weights for bilinear upsampling from `srcWidth`
+	static void upsample_coordinates(uint32_t srcWidth, uint32_t width, std::vector<uint32_t>& x0, std::vector<uint32_t>& x1, std::vector<float>& fx) {
+		x0.resize(width);
+		x1.resize(width);
+		fx.resize(width);
+
+		for (uint32_t x = 0; x < width; ++x) {
+			const float sx = std::clamp((static_cast<float>(x) + 0.5f) * srcWidth / width - 0.5f, 0.0f, static_cast<float>(srcWidth - 1));
+			x0[x] = static_cast<uint32_t>(sx);
+			x1[x] = std::min(x0[x] + 1, srcWidth - 1);
+			fx[x] = sx - static_cast<float>(x0[x]);
+		}
+	}
+
+	// Worker threads shared by every post processor, so that render jobs
+	// running side by side do not each start a thread per core. NOTE: Jobs
+	// of different post processors take turns, and the calling thread
+	// works on its share of each.
+	class PostProcessor::WorkerPool {
+	public:
+		WorkerPool(uint32_t numWorkers) {
+			for (uint32_t i = 0; i < numWorkers; ++i) {
+				m_Workers.emplace_back(&WorkerPool::run_worker, this);
+			}
+		}
+
+		~WorkerPool() {
+			{
+				const std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Quit = true;
+			}
+
+			m_WorkCondition.notify_all();
+
+			for (std::thread& worker : m_Workers) {
+				worker.join();
+			}
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		void parallel_for(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+	private:
+		void run_worker();
+		void run_blocks();
+
+		std::vector<std::thread> m_Workers = {};
+		std::mutex m_JobMutex = {}; // NOTE: Held by the caller for the whole job
+		std::mutex m_Mutex = {};
+		std::condition_variable m_WorkCondition = {};
+		std::condition_variable m_DoneCondition = {};
+		const std::function<void(uint32_t, uint32_t)>* m_Job = nullptr;
+		uint32_t m_JobCount = 0;
+		uint32_t m_JobBlocks = 0;
+		std::atomic<uint32_t> m_NextBlock = 0;
+		uint64_t m_JobGeneration = 0;
+		size_t m_BusyWorkers = 0;
+		bool m_Quit = false;
+	};
+
+	PostProcessor::PostProcessor(const PostProcessSettings& settings) : m_Settings(settings) {
+		m_EncodeLUT.resize(ENCODE_LUT_SIZE);
+
+		// NOTE: Indexing by the square root spends most entries on the darks,
+		// where the sRGB curve is steepest
+		for (uint32_t i = 0; i < ENCODE_LUT_SIZE; ++i) {
+			const float root = static_cast<float>(i) / static_cast<float>(ENCODE_LUT_SIZE - 1);
+			m_EncodeLUT[i] = srgb_encode(root * root);
+		}
+
+		if (!m_Settings.lutPath.empty() && !load_lut(m_Settings.lutPath)) {
+			std::cerr << "Failed to read output LUT from " << m_Settings.lutPath.string() << '\n';
+		}
+
+		m_WorkerPool = get_worker_pool();
+	}
+
+	PostProcessor::~PostProcessor() {
+
+	}
+
+	void PostProcessor::process(uint32_t width, uint32_t height, const std::vector<float>& radiance, std::vector<float>& display) {
+		const size_t rowValues = 3 * static_cast<size_t>(width);
+		const size_t numValues = rowValues * height;
+		assert(radiance.size() >= numValues);
+
+		display.resize(numValues);
+
+		if (numValues == 0) {
+			return;
+		}
+
+		const float exposure = m_Settings.useAutoExposure ?
+			compute_exposure(width, height, radiance.data()) :
+			std::exp2(m_Settings.exposureCompensation);
+
+		// NOTE: Bloom goes on top of the radiance, so that it is exposed and
+		// tonemapped along with everything else. It is blended in row by row
+		// right before tonemapping, which saves a round trip through memory.
+		const uint32_t numBloomLevels = m_Settings.useBloom ? build_bloom(width, height, radiance.data()) : 0;
+		const float bloomIntensity = std::clamp(m_Settings.bloomIntensity, 0.0f, 1.0f);
+		std::vector<uint32_t> bloomX0 = {}, bloomX1 = {};
+		std::vector<float> bloomFX = {};
+
+		if (numBloomLevels > 0) {
+			upsample_coordinates(m_BloomLevels[0].width, width, bloomX0, bloomX1, bloomFX);
+		}
+
+		const Tonemapper tonemapper = m_Settings.tonemapper;
+
+		parallel_for(height, [&](uint32_t begin, uint32_t end) {
+			const __m128 scale = _mm_set1_ps(exposure);
+			const __m128 lutScale = _mm_set1_ps(static_cast<float>(ENCODE_LUT_SIZE - 1));
+			alignas(16) int32_t indices[4] = {};
+			std::vector<float> bloomRow(numBloomLevels > 0 ? rowValues : 0);
+
+			for (uint32_t y = begin; y < end; ++y) {
+				const float* in = radiance.data() + y * rowValues;
+				float* out = display.data() + y * rowValues;
+
+				// NOTE: The levels are summed, so their count is divided out again
+				if (numBloomLevels > 0) {
+					const BloomLevel& bloom = m_BloomLevels[0];
+
+					upsample_row(bloom.pixels.data(), bloom.width, bloom.height, y, height, bloomX0.data(), bloomX1.data(), bloomFX.data(), width,
+						in, bloomRow.data(), 1.0f - bloomIntensity, bloomIntensity / static_cast<float>(numBloomLevels));
+					in = bloomRow.data();
+				}
+
+				// NOTE: Every step is per channel, so the interleaved values
+				// are processed four at a time regardless of the pixel layout
+				size_t i = 0;
+
+				for (; i + 4 <= rowValues; i += 4) {
+					const __m128 color = tonemap(_mm_mul_ps(_mm_loadu_ps(in + i), scale), tonemapper);
+					_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(_mm_sqrt_ps(color), lutScale)));
+
+					out[i + 0] = m_EncodeLUT[indices[0]];
+					out[i + 1] = m_EncodeLUT[indices[1]];
+					out[i + 2] = m_EncodeLUT[indices[2]];
+					out[i + 3] = m_EncodeLUT[indices[3]];
+				}
+
+				for (; i < rowValues; ++i) {
+					const __m128 color = tonemap(_mm_mul_ss(_mm_set_ss(in[i]), scale), tonemapper);
+					out[i] = m_EncodeLUT[_mm_cvtss_si32(_mm_mul_ss(_mm_sqrt_ss(color), lutScale))];
+				}
+
+				if (m_LUTSize == 0) {
+					continue;
+				}
+
+				// Trilinear interpolation in the 3D LUT, with the three channels
+				// of an entry in one register
+				const uint32_t size = m_LUTSize;
+				const __m128 domainMin = _mm_setr_ps(m_LUTDomainMin[0], m_LUTDomainMin[1], m_LUTDomainMin[2], 0.0f);
+				const __m128 domainScale = _mm_setr_ps(m_LUTScale[0], m_LUTScale[1], m_LUTScale[2], 0.0f);
+				const __m128 maxBase = _mm_set1_ps(static_cast<float>(size - 2));
+				const __m128 maxCoordinate = _mm_set1_ps(static_cast<float>(size - 1));
+				const size_t strideG = 4 * static_cast<size_t>(size);
+				const size_t strideB = strideG * size;
+				alignas(16) int32_t coordinates[4] = {};
+				alignas(16) float result[4] = {};
+
+				for (uint32_t x = 0; x < width; ++x) {
+					float* pixel = out + 3 * static_cast<size_t>(x);
+
+					const __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_setr_ps(pixel[0], pixel[1], pixel[2], 0.0f), domainMin), domainScale), _mm_setzero_ps()), maxCoordinate);
+					const __m128 base = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(t)), maxBase);
+					const __m128 fraction = _mm_sub_ps(t, base);
+					_mm_store_si128(reinterpret_cast<__m128i*>(coordinates), _mm_cvttps_epi32(base));
+
+					const float* entry = &m_LUT[
+						4 * static_cast<size_t>(coordinates[0]) +
+						strideG * static_cast<size_t>(coordinates[1]) +
+						strideB * static_cast<size_t>(coordinates[2])
+					];
+
+					const __m128 fr = _mm_shuffle_ps(fraction, fraction, _MM_SHUFFLE(0, 0, 0, 0));
+					const __m128 fg = _mm_shuffle_ps(fraction, fraction, _MM_SHUFFLE(1, 1, 1, 1));
+					const __m128 fb = _mm_shuffle_ps(fraction, fraction, _MM_SHUFFLE(2, 2, 2, 2));
+
+					const auto lerp = [](__m128 a, __m128 b, __m128 f) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f)); };
+					const auto lerp_red = [&](const float* e) { return lerp(_mm_loadu_ps(e), _mm_loadu_ps(e + 4), fr); };
+
+					const __m128 near = lerp(lerp_red(entry), lerp_red(entry + strideG), fg);
+					const __m128 far = lerp(lerp_red(entry + strideB), lerp_red(entry + strideB + strideG), fg);
+					_mm_store_ps(result, _mm_min_ps(_mm_max_ps(lerp(near, far, fb), _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+
+					pixel[0] = result[0];
+					pixel[1] = result[1];
+					pixel[2] = result[2];
+				}
+			}
+		});
+	}
+
+	float PostProcessor::compute_exposure(uint32_t width, uint32_t height, const float* radiance) {
+		std::vector<uint64_t> histogram(HISTOGRAM_BINS, 0);
+		std::mutex histogramMutex = {};
+
+		// NOTE: Every other row is plenty for the statistics and halves the
+		// memory traffic
+		parallel_for((height + 1) / 2, [&](uint32_t begin, uint32_t end) {
+			const __m128 redWeight = _mm_set1_ps(0.2126f);
+			const __m128 greenWeight = _mm_set1_ps(0.7152f);
+			const __m128 blueWeight = _mm_set1_ps(0.0722f);
+
+			uint32_t localHistogram[HISTOGRAM_BINS] = {};
+			alignas(16) int32_t bins[4] = {};
+
+			for (uint32_t y = 2 * begin; y < 2 * end && y < height; y += 2) {
+				const float* row = radiance + 3 * static_cast<size_t>(y) * width;
+				uint32_t x = 0;
+
+				for (; x + 4 <= width; x += 4) {
+					const float* p = row + 3 * static_cast<size_t>(x);
+					const __m128 r = _mm_setr_ps(p[0], p[3], p[6], p[9]);
+					const __m128 g = _mm_setr_ps(p[1], p[4], p[7], p[10]);
+					const __m128 b = _mm_setr_ps(p[2], p[5], p[8], p[11]);
+					const __m128 luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, redWeight), _mm_mul_ps(g, greenWeight)), _mm_mul_ps(b, blueWeight));
+
+					_mm_store_si128(reinterpret_cast<__m128i*>(bins), luminance_bins(luminance));
+					localHistogram[bins[0]]++;
+					localHistogram[bins[1]]++;
+					localHistogram[bins[2]]++;
+					localHistogram[bins[3]]++;
+				}
+
+				for (; x < width; ++x) {
+					const float* p = row + 3 * static_cast<size_t>(x);
+					const float luminance = 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2];
+
+					localHistogram[_mm_cvtsi128_si32(luminance_bins(_mm_set1_ps(luminance)))]++;
+				}
+			}
+
+			const std::lock_guard<std::mutex> lock(histogramMutex);
+
+			for (uint32_t i = 0; i < HISTOGRAM_BINS; ++i) {
+				histogram[i] += localHistogram[i];
+			}
+		});
+
+		uint64_t total = 0;
+
+		for (uint32_t i = 1; i < HISTOGRAM_BINS; ++i) {
+			total += histogram[i];
+		}
+
+		if (total == 0) {
+			return std::exp2(m_Settings.exposureCompensation);
+		}
+
+		// Average of the bins between the percentiles, where bins that
+		// straddle a percentile count partially
+		const double low = static_cast<double>(total) * m_Settings.lowPercentile;
+		const double high = static_cast<double>(total) * m_Settings.highPercentile;
+		double cumulative = 0.0;
+		double weightedSum = 0.0;
+		double weight = 0.0;
+
+		for (uint32_t i = 1; i < HISTOGRAM_BINS; ++i) {
+			const double count = static_cast<double>(histogram[i]);
+			const double overlap = std::max(0.0, std::min(cumulative + count, high) - std::max(cumulative, low));
+			const double binLog2 = HISTOGRAM_MIN_LOG2 + (i + 0.5) * (HISTOGRAM_MAX_LOG2 - HISTOGRAM_MIN_LOG2) / HISTOGRAM_BINS;
+
+			weightedSum += overlap * binLog2;
+			weight += overlap;
+			cumulative += count;
+		}
+
+		if (weight <= 0.0) {
+			return std::exp2(m_Settings.exposureCompensation);
+		}
+
+		const float averageLog2 = static_cast<float>(weightedSum / weight);
+		const float stops = std::clamp(std::log2(MIDDLE_GRAY) - averageLog2, m_Settings.minExposure, m_Settings.maxExposure);
+
+		return std::exp2(stops + m_Settings.exposureCompensation);
+	}
+
+	// NOTE: The pool lives for as long as any post processor does
+	std::shared_ptr<PostProcessor::WorkerPool> PostProcessor::get_worker_pool() {
+		static std::mutex mutex = {};
+		static std::weak_ptr<WorkerPool> sharedPool = {};
+
+		const std::lock_guard<std::mutex> lock(mutex);
+		std::shared_ptr<WorkerPool> pool = sharedPool.lock();
+
+		if (pool == nullptr) {
+			// NOTE: The calling thread works on its share as well
+			pool = std::make_shared<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+			sharedPool = pool;
+		}
+
+		return pool;
+	}
+
+	void PostProcessor::parallel_for(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+		m_WorkerPool->parallel_for(count, function);
+	}
+
+	void PostProcessor::WorkerPool::parallel_for(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+		// NOTE: A few blocks per thread even out rows of differing cost
+		const uint32_t numBlocks = std::min(count, static_cast<uint32_t>(m_Workers.size() + 1) * 4);
+
+		if (m_Workers.empty() || numBlocks <= 1) {
+			function(0, count);
+			return;
+		}
+
+		const std::lock_guard<std::mutex> jobLock(m_JobMutex);
+
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Job = &function;
+			m_JobCount = count;
+			m_JobBlocks = numBlocks;
+			m_NextBlock = 0;
+			m_BusyWorkers = m_Workers.size();
+			m_JobGeneration++;
+		}
+
+		m_WorkCondition.notify_all();
+		run_blocks();
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_DoneCondition.wait(lock, [this]() { return m_BusyWorkers == 0; });
+		m_Job = nullptr;
+	}
+
+	void PostProcessor::WorkerPool::run_worker() {
+		uint64_t generation = 0;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (true) {
+			m_WorkCondition.wait(lock, [&]() { return m_Quit || m_JobGeneration != generation; });
+
+			if (m_Quit) {
+				return;
+			}
+
+			generation = m_JobGeneration;
+			lock.unlock();
+			run_blocks();
+			lock.lock();
+
+			if (--m_BusyWorkers == 0) {
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+	void PostProcessor::WorkerPool::run_blocks() {
+		const uint64_t count = m_JobCount;
+		const uint32_t numBlocks = m_JobBlocks;
+
+		for (uint32_t block = m_NextBlock++; block < numBlocks; block = m_NextBlock++) {
+			const uint32_t begin = static_cast<uint32_t>(count * block / numBlocks);
+			const uint32_t end = static_cast<uint32_t>(count * (block + 1) / numBlocks);
+
+			(*m_Job)(begin, end);
+		}
+	}
+
+	// Physically based bloom: the image is repeatedly halved and blurred,
+	// and the levels are summed back up from the coarsest one, which adds
+	// up to a wide, smooth falloff without any threshold. Returns the number
+	// of levels, the sum ends up in the first one.
+	uint32_t PostProcessor::build_bloom(uint32_t width, uint32_t height, const float* radiance) {
+		uint32_t numLevels = 0;
+		uint32_t levelWidth = width / 2;
+		uint32_t levelHeight = height / 2;
+
+		while (numLevels < m_Settings.bloomLevels && levelWidth >= MIN_BLOOM_LEVEL_SIZE && levelHeight >= MIN_BLOOM_LEVEL_SIZE) {
+			if (m_BloomLevels.size() <= numLevels) {
+				m_BloomLevels.emplace_back();
+			}
+
+			BloomLevel& level = m_BloomLevels[numLevels];
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.pixels.resize(3 * static_cast<size_t>(levelWidth) * levelHeight);
+
+			numLevels++;
+			levelWidth /= 2;
+			levelHeight /= 2;
+		}
+
+		if (numLevels == 0) {
+			return 0;
+		}
+
+		// Downsample chain, 2x2 box filter followed by a blur
+		for (uint32_t l = 0; l < numLevels; ++l) {
+			const float* src = l == 0 ? radiance : m_BloomLevels[l - 1].pixels.data();
+			const uint32_t srcWidth = l == 0 ? width : m_BloomLevels[l - 1].width;
+			const uint32_t srcHeight = l == 0 ? height : m_BloomLevels[l - 1].height;
+			BloomLevel& level = m_BloomLevels[l];
+
+			parallel_for(level.height, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t y = begin; y < end; ++y) {
+					const float* row0 = src + 3 * static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth;
+					const float* row1 = src + 3 * static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth;
+					float* out = level.pixels.data() + 3 * static_cast<size_t>(y) * level.width;
+
+					for (uint32_t x = 0; x < level.width; ++x) {
+						const size_t a = 3 * static_cast<size_t>(std::min(2 * x, srcWidth - 1));
+						const size_t b = 3 * static_cast<size_t>(std::min(2 * x + 1, srcWidth - 1));
+
+						for (uint32_t c = 0; c < 3; ++c) {
+							out[3 * x + c] = 0.25f * (row0[a + c] + row0[b + c] + row1[a + c] + row1[b + c]);
+						}
+					}
+				}
+			});
+
+			blur(level);
+		}
+
+		// Upsample chain, coarse to fine
+		for (uint32_t l = numLevels - 1; l > 0; --l) {
+			const BloomLevel& src = m_BloomLevels[l];
+			BloomLevel& dst = m_BloomLevels[l - 1];
+
+			std::vector<uint32_t> x0 = {}, x1 = {};
+			std::vector<float> fx = {};
+			upsample_coordinates(src.width, dst.width, x0, x1, fx);
+
+			parallel_for(dst.height, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t y = begin; y < end; ++y) {
+					float* row = dst.pixels.data() + 3 * static_cast<size_t>(y) * dst.width;
+					upsample_row(src.pixels.data(), src.width, src.height, y, dst.height, x0.data(), x1.data(), fx.data(), dst.width, row, row, 1.0f, 1.0f);
+				}
+			});
+		}
+
+		return numLevels;
+	}
+
+	// Separable 5-tap binomial blur, 1 4 6 4 1
+	void PostProcessor::blur(BloomLevel& level) {
+		const uint32_t width = level.width;
+		const size_t rowValues = 3 * static_cast<size_t>(width);
+		const float weights[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+
+		m_BlurScratch.resize(level.pixels.size());
+
+		// Horizontal, from the level into the scratch buffer
+		parallel_for(level.height, [&](uint32_t begin, uint32_t end) {
+			const __m128 w0 = _mm_set1_ps(weights[0]);
+			const __m128 w1 = _mm_set1_ps(weights[1]);
+			const __m128 w2 = _mm_set1_ps(weights[2]);
+
+			for (uint32_t y = begin; y < end; ++y) {
+				const float* in = level.pixels.data() + y * rowValues;
+				float* out = m_BlurScratch.data() + y * rowValues;
+
+				const auto blur_value = [&](size_t i) {
+					const int32_t x = static_cast<int32_t>(i / 3);
+					const size_t c = i % 3;
+					float sum = 0.0f;
+
+					for (int32_t k = -2; k <= 2; ++k) {
+						const int32_t sx = std::clamp(x + k, 0, static_cast<int32_t>(width) - 1);
+						sum += weights[k + 2] * in[3 * static_cast<size_t>(sx) + c];
+					}
+
+					out[i] = sum;
+				};
+
+				// NOTE: Neighbouring pixels are 3 values apart, so the taps of
+				// four consecutive values are just as consecutive
+				const size_t interiorBegin = std::min<size_t>(6, rowValues);
+				const size_t interiorEnd = rowValues >= 12 ? rowValues - 6 : interiorBegin;
+				size_t i = 0;
+
+				for (; i < interiorBegin; ++i) {
+					blur_value(i);
+				}
+
+				for (; i + 4 <= interiorEnd; i += 4) {
+					const __m128 outer = _mm_add_ps(_mm_loadu_ps(in + i - 6), _mm_loadu_ps(in + i + 6));
+					const __m128 inner = _mm_add_ps(_mm_loadu_ps(in + i - 3), _mm_loadu_ps(in + i + 3));
+					const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(outer, w0), _mm_mul_ps(inner, w1)), _mm_mul_ps(_mm_loadu_ps(in + i), w2));
+
+					_mm_storeu_ps(out + i, sum);
+				}
+
+				for (; i < rowValues; ++i) {
+					blur_value(i);
+				}
+			}
+		});
+
+		// Vertical, from the scratch buffer back into the level
+		parallel_for(level.height, [&](uint32_t begin, uint32_t end) {
+			const __m128 w0 = _mm_set1_ps(weights[0]);
+			const __m128 w1 = _mm_set1_ps(weights[1]);
+			const __m128 w2 = _mm_set1_ps(weights[2]);
+			const int32_t lastRow = static_cast<int32_t>(level.height) - 1;
+
+			for (uint32_t y = begin; y < end; ++y) {
+				const float* rows[5] = {};
+
+				for (int32_t k = -2; k <= 2; ++k) {
+					rows[k + 2] = m_BlurScratch.data() + static_cast<size_t>(std::clamp(static_cast<int32_t>(y) + k, 0, lastRow)) * rowValues;
+				}
+
+				float* out = level.pixels.data() + y * rowValues;
+				size_t i = 0;
+
+				for (; i + 4 <= rowValues; i += 4) {
+					const __m128 outer = _mm_add_ps(_mm_loadu_ps(rows[0] + i), _mm_loadu_ps(rows[4] + i));
+					const __m128 inner = _mm_add_ps(_mm_loadu_ps(rows[1] + i), _mm_loadu_ps(rows[3] + i));
+					const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(outer, w0), _mm_mul_ps(inner, w1)), _mm_mul_ps(_mm_loadu_ps(rows[2] + i), w2));
+
+					_mm_storeu_ps(out + i, sum);
+				}
+
+				for (; i < rowValues; ++i) {
+					out[i] =
+						weights[0] * (rows[0][i] + rows[4][i]) +
+						weights[1] * (rows[1][i] + rows[3][i]) +
+						weights[2] * rows[2][i];
+				}
+			}
+		});
+	}
+
+	// Reads a 3D LUT in the .cube format. NOTE: 1D LUTs are not supported.
+	bool PostProcessor::load_lut(const std::filesystem::path& path) {
+		std::ifstream file(path);
+
+		if (!file) {
+			return false;
+		}
+
+		uint32_t size = 0;
+		float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+		float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+		std::vector<float> entries = {};
+		std::string line = {};
+
+		while (std::getline(file, line)) {
+			const size_t first = line.find_first_not_of(" \t\r");
+
+			if (first == std::string::npos || line[first] == '#') {
+				continue;
+			}
+
+			std::istringstream stream(line);
+			std::string keyword = {};
+
+			if (std::isalpha(static_cast<unsigned char>(line[first]))) {
+				stream >> keyword;
+
+				if (keyword == "LUT_3D_SIZE") {
+					if (!(stream >> size) || size < 2 || size > 256) {
+						return false;
+					}
+
+					entries.reserve(4 * static_cast<size_t>(size) * size * size);
+				}
+				else if (keyword == "DOMAIN_MIN") {
+					if (!(stream >> domainMin[0] >> domainMin[1] >> domainMin[2])) {
+						return false;
+					}
+				}
+				else if (keyword == "DOMAIN_MAX") {
+					if (!(stream >> domainMax[0] >> domainMax[1] >> domainMax[2])) {
+						return false;
+					}
+				}
+				else if (keyword == "LUT_1D_SIZE") {
+					return false;
+				}
+
+				continue;
+			}
+
+			float r = 0.0f;
+			float g = 0.0f;
+			float b = 0.0f;
+
+			if (!(stream >> r >> g >> b)) {
+				return false;
+			}
+
+			entries.push_back(r);
+			entries.push_back(g);
+			entries.push_back(b);
+			entries.push_back(0.0f);
+		}
+
+		if (size == 0 || entries.size() != 4 * static_cast<size_t>(size) * size * size) {
+			return false;
+		}
+
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (domainMax[c] <= domainMin[c]) {
+				return false;
+			}
+
+			m_LUTDomainMin[c] = domainMin[c];
+			m_LUTScale[c] = static_cast<float>(size - 1) / (domainMax[c] - domainMin[c]);
+		}
+
+		m_LUT = std::move(entries);
+		m_LUTSize = size;
+
+		return true;
+	}
+}
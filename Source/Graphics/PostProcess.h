@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace SR {
+	enum class Tonemapper : uint8_t {
+		NONE,
+		ACES, // NOTE: Fitted curve by Krzysztof Narkowicz
+		FILMIC // NOTE: John Hable's curve from Uncharted 2
+	};
+
+	struct PostProcessSettings {
+		bool useAutoExposure = true;
+		float exposureCompensation = 0.0f; // NOTE: In stops, also applies without auto exposure
+		float minExposure = -8.0f; // NOTE: In stops, limits auto exposure
+		float maxExposure = 8.0f;
+		float lowPercentile = 0.5f; // NOTE: Luminance below and above the percentiles does not affect exposure
+		float highPercentile = 0.95f;
+
+		Tonemapper tonemapper = Tonemapper::ACES;
+
+		bool useBloom = false;
+		float bloomIntensity = 0.04f;
+		uint32_t bloomLevels = 6;
+
+		std::filesystem::path lutPath = {}; // NOTE: Optional .cube file, applied after the sRGB encoding
+	};
+
+	// Turns linear HDR radiance into display-ready sRGB on the CPU, for
+	// output that never goes through the swapchain, like render jobs.
+	// NOTE: Work is split by rows across a pool of threads, which all post
+	// processors share, and the per-channel math uses SSE, so that a 4K
+	// frame takes a few ms. Frames have to be processed one at a time.
+	class PostProcessor {
+	public:
+		PostProcessor(const PostProcessSettings& settings);
+		~PostProcessor();
+
+		PostProcessor(const PostProcessor&) = delete;
+		PostProcessor& operator=(const PostProcessor&) = delete;
+
+		// Both images are RGB, rows from the top. The output is sRGB encoded
+		// and in [0, 1].
+		void process(uint32_t width, uint32_t height, const std::vector<float>& radiance, std::vector<float>& display);
+
+		// Exposure scale from the luminance histogram of `radiance`
+		float compute_exposure(uint32_t width, uint32_t height, const float* radiance);
+
+		inline const PostProcessSettings& get_settings() const { return m_Settings; }
+
+	private:
+		struct BloomLevel {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			std::vector<float> pixels = {};
+		};
+
+		class WorkerPool;
+
+		static std::shared_ptr<WorkerPool> get_worker_pool();
+
+		void parallel_for(uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+		uint32_t build_bloom(uint32_t width, uint32_t height, const float* radiance);
+		void blur(BloomLevel& level);
+		bool load_lut(const std::filesystem::path& path);
+
+		PostProcessSettings m_Settings = {};
+
+		std::vector<float> m_EncodeLUT = {}; // NOTE: Indexed by the square root of linear values
+		std::vector<float> m_LUT = {}; // NOTE: RGB plus padding, red varies fastest like in .cube files
+		uint32_t m_LUTSize = 0;
+		float m_LUTDomainMin[3] = { 0.0f, 0.0f, 0.0f };
+		float m_LUTScale[3] = { 0.0f, 0.0f, 0.0f }; // NOTE: From the domain to entries
+
+		// NOTE: Scratch buffers, kept between frames
+		std::vector<BloomLevel> m_BloomLevels = {};
+		std::vector<float> m_BlurScratch = {};
+
+		std::shared_ptr<WorkerPool> m_WorkerPool = nullptr;
+	};
+}
@@ -1,125 +1,269 @@
 #include "RayTracingPass.h"
 
+#include "Managers/AssetManager.h"
+
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
 
 namespace SR {
+	static constexpr size_t GEOMETRY_PREFETCH_DISTANCE = 8; // NOTE: In primitives
+	static constexpr size_t MAX_PENDING_EDITS = 256; // NOTE: Past this, starting over everywhere is cheaper than tracking the edits
+
+	static bool is_same_material(const Material& a, const Material& b) {
+		return
+			a.color == b.color &&
+			a.type == b.type &&
+			a.albedoTexIndex == b.albedoTexIndex &&
+			a.normalTexIndex == b.normalTexIndex &&
+			a.metallic == b.metallic &&
+			a.roughness == b.roughness &&
+			a.ior == b.ior;
+	}
+
+	// NOTE: "lowbias32" by Chris Wellons, must match tile_filter_hash() in shaders
+	static uint32_t tile_filter_hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// NOTE: The two filter bits of an instance, must match tile_filter_hash()
+	// and its use in shaders
+	static void tile_filter_bits(uint32_t instanceID, uint32_t bits[2]) {
+		const uint32_t hash = tile_filter_hash(instanceID);
+		bits[0] = hash & 255;
+		bits[1] = (hash >> 8) & 255;
+	}
+
 	RayTracingPass::RayTracingPass(GraphicsDevice& gfxDevice) : m_GfxDevice(gfxDevice) {
-		// ---------------------- Create Ray-Tracing Pipeline ----------------------
+		// ------------------------ Load Ray-Tracing Shaders -----------------------
+		// NOTE: Pipelines are created per variant, see get_pipeline_variant()
 		m_GfxDevice.create_shader(ShaderStage::RAYGEN, "shaders/vulkan/rt_raygen.rgen.spv", m_RayGenShader);
 		m_GfxDevice.create_shader(ShaderStage::MISS, "shaders/vulkan/rt_miss.rmiss.spv", m_MissShader);
 		m_GfxDevice.create_shader(ShaderStage::CLOSEST_HIT, "shaders/vulkan/rt_closest_hit.rchit.spv", m_ClosestHitShader);
-
-		const RTPipelineInfo rtPipelineInfo = {
-			.rayGenShader = &m_RayGenShader,
-			.missShader = &m_MissShader,
-			.closestHitShader = &m_ClosestHitShader,
-			.shaderGroups = {
-				RTShaderGroup { RTShaderGroup::Type::GENERAL,    0u, ~0u }, // ray-gen
-				RTShaderGroup { RTShaderGroup::Type::GENERAL,	 1u, ~0u }, // miss
-				RTShaderGroup { RTShaderGroup::Type::TRIANGLES, ~0u,  2u } // closest_hit
-			},
-			.payloadSize = 4 * sizeof(float)
-		};
-
-		m_GfxDevice.create_rt_pipeline(rtPipelineInfo, m_RTPipeline);
 	}
 
 	void RayTracingPass::initialize(Scene& scene, MaterialManager& materialManager) {
-		const auto& entities = scene.get_entities();
+		const auto renderables = ECS::view<const WorldTransform, const Renderable>(); // NOTE: The ECS only holds the entities of this scene
 		const Buffer& materialBuffer = materialManager.get_material_buffer();
 
+		// NOTE: Entities that were already part of the scene keep their
+		// material slots, so that rebuilding the scene does not use up the
+		// material manager
+		std::unordered_map<entity_id, uint32_t> materialSlots = {};
+
+		if (m_MaterialManager == &materialManager) {
+			for (const SceneEntity& sceneEntity : m_SceneEntities) {
+				if (sceneEntity.hasMaterial) {
+					materialSlots.insert({ sceneEntity.entity, sceneEntity.matIndexOverride });
+				}
+			}
+		}
+
+		m_MaterialManager = &materialManager;
+		m_SceneEntities.clear();
+		m_SceneEntityIndexLUT.clear();
+		m_InstanceSources.clear();
+		m_PendingEdits.clear();
+		m_Instances.clear();
+		m_SceneDescBufferData.clear();
+		m_BLASes.clear(); // NOTE: After the instances, which point into it
+
 		// ----------------------------- Create BLASes -----------------------------
 		size_t numBLASes = 0;
 
 		// Count number of BLASes required
-		for (const auto& entity : entities) {
-			const Renderable* renderable = ECS::get_component<Renderable>(entity);
-			const Model* model = renderable->model;
-
-			for (const auto& mesh : model->meshes) {
+		renderables.for_each([&numBLASes](entity_id entity, const WorldTransform& worldTransform, const Renderable& renderable) {
+			for (const auto& mesh : renderable.model->meshes) {
 				numBLASes += mesh.primitives.size();
 			}
-		}
+		});
 
 		m_BLASes.reserve(numBLASes);
 		m_Instances.reserve(numBLASes);
 		m_SceneDescBufferData.reserve(numBLASes);
+		m_SceneEntities.reserve(renderables.count());
+		m_InstanceSources.reserve(numBLASes);
 		m_GfxDevice.create_rt_instance_buffer(m_InstanceBuffer, static_cast<uint32_t>(numBLASes));
 
+		glm::vec3 sceneMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 sceneMax = glm::vec3(std::numeric_limits<float>::lowest());
+
 		// TODO: Rename MeshPrimitive to just "Mesh", GLTF terminology is confusing
-		for (const auto& entity : entities) {
-			const Renderable* renderable = ECS::get_component<Renderable>(entity);
-			const Transform* transform = ECS::get_component<Transform>(entity);
-			const Material* material = ECS::get_component<Material>(entity);
-			const Model* model = renderable->model;
-
-			uint32_t matIndexOverride = material != nullptr ? materialManager.add_material(*material) : 0;
-
-			for (const auto& mesh : model->meshes) {
-				for (const auto& primitive : mesh.primitives) {
-					RTAS& blas = m_BLASes.emplace_back();
-
-					const RTASInfo blasInfo = {
-						.type = RTASType::BLAS,
-						.blas = {
-							.geometries = {
-								RTBLASGeometry {
-									.type = RTBLASGeometry::Type::TRIANGLES,
-									.triangles = {
-										.vertexBuffer = &model->vertexBuffer,
-										.indexBuffer = &model->indexBuffer,
-										.vertexCount = primitive.numVertices,
-										.vertexStride = sizeof(ModelVertex),
-										.vertexByteOffset = sizeof(ModelVertex) * primitive.baseVertex,
-										.indexCount = primitive.numIndices,
-										.indexOffset = primitive.baseIndex,
-										.vertexFormat = Format::R32G32B32_FLOAT
+		// NOTE: Streams the entities chunk by chunk, instead of looking up
+		// the components of every entity on its own
+		renderables.for_each_chunk([&](const ECS::ChunkView& chunk) {
+			const WorldTransform* worldTransforms = chunk.get<const WorldTransform>();
+			const Renderable* renderableColumn = chunk.get<const Renderable>();
+			const Material* materials = chunk.get<const Material>(); // NOTE: Optional
+
+			for (uint32_t i = 0; i < chunk.count; ++i) {
+				const entity_id entity = chunk.entities[i];
+				const Renderable* renderable = &renderableColumn[i];
+				const Material* material = materials != nullptr ? &materials[i] : nullptr;
+				const Model* model = renderable->model;
+
+				uint32_t matIndexOverride = 0;
+
+				if (material != nullptr) {
+					auto slot = materialSlots.find(entity);
+
+					if (slot != materialSlots.end()) {
+						matIndexOverride = slot->second;
+						materialManager.update_material(matIndexOverride, *material);
+					}
+					else {
+						matIndexOverride = materialManager.add_material(*material);
+					}
+				}
+				const glm::mat4& modelMatrix = worldTransforms[i].matrix;
+
+				m_SceneEntityIndexLUT.insert({ entity, static_cast<uint32_t>(m_SceneEntities.size()) });
+
+				SceneEntity& sceneEntity = m_SceneEntities.emplace_back();
+				sceneEntity.entity = entity;
+				sceneEntity.world = modelMatrix;
+				sceneEntity.hasMaterial = material != nullptr;
+				sceneEntity.matIndexOverride = matIndexOverride;
+				sceneEntity.firstInstance = static_cast<uint32_t>(m_Instances.size());
+
+				for (const auto& mesh : model->meshes) {
+					for (const auto& primitive : mesh.primitives) {
+						RTAS& blas = m_BLASes.emplace_back();
+
+						const RTASInfo blasInfo = {
+							.type = RTASType::BLAS,
+							.blas = {
+								.geometries = {
+									RTBLASGeometry {
+										.type = RTBLASGeometry::Type::TRIANGLES,
+										.triangles = {
+											.vertexBuffer = &model->vertexBuffer,
+											.indexBuffer = &model->indexBuffer,
+											.vertexCount = primitive.numVertices,
+											.vertexStride = sizeof(ModelVertex),
+											.vertexByteOffset = sizeof(ModelVertex) * primitive.baseVertex,
+											.indexCount = primitive.numIndices,
+											.indexOffset = primitive.baseIndex,
+											.vertexFormat = Format::R32G32B32_FLOAT
+										}
 									}
 								}
 							}
+						};
+
+						m_GfxDevice.create_rtas(blasInfo, blas);
+
+						// Create BLAS instance data
+						RTTLAS::BLASInstance instance = {
+							.instanceID = static_cast<uint32_t>(m_Instances.size()),
+							.instanceMask = 1,
+							.instanceContributionHitGroupIndex = 0, // TODO: Check out
+							// TODO (REVISIT): Ok, so it SEEMS like this is the SBT index for HIT GROUPS ONLY.
+							// So, for example, if we have the following shader groups:
+							// 0 -> ray-gen shader -> GENERAL
+							// 1 -> miss shader -> GENERAL
+							// 2 -> closest-hit -> TRIANGLES_HIT_GROUP
+							// Then the closest-hit shader at index 2 in the SBT will be the only
+							// hit group, and thus its index within the HIT GROUP SBT will be 0.
+							// That is at least what seems to be the case, so this might not be true
+							.blasResource = &blas
+						};
+
+						// Update the transform data
+						glm::mat4 transformation = glm::transpose(modelMatrix); // TODO: Might be wrong
+
+						std::memcpy(instance.transform, &transformation[0][0], sizeof(instance.transform));
+
+						m_Instances.push_back(instance);
+						m_InstanceSources.push_back({ model, primitive, static_cast<uint32_t>(m_SceneEntities.size() - 1) });
+
+						// Create object for scene desc
+						Object& object = m_SceneDescBufferData.emplace_back();
+						object.verticesBDA = m_GfxDevice.get_bda(model->vertexBuffer) + primitive.baseVertex * sizeof(ModelVertex);
+						object.indicesBDA = m_GfxDevice.get_bda(model->indexBuffer) + primitive.baseIndex * sizeof(uint32_t);
+						object.materialsBDA = m_GfxDevice.get_bda(materialBuffer);
+						object.matIndexOverride = matIndexOverride;
+
+						// NOTE: The corners of the primitive's bounds, which is
+						// conservative but never pages in any geometry
+						for (uint32_t corner = 0; corner < (primitive.numVertices > 0 ? 8u : 0u); ++corner) {
+							const glm::vec3 localCorner = {
+								(corner & 1) ? primitive.boundsMax.x : primitive.boundsMin.x,
+								(corner & 2) ? primitive.boundsMax.y : primitive.boundsMin.y,
+								(corner & 4) ? primitive.boundsMax.z : primitive.boundsMin.z
+							};
+
+							const glm::vec3 position = glm::vec3(modelMatrix * glm::vec4(localCorner, 1.0f));
+							sceneMin = glm::min(sceneMin, position);
+							sceneMax = glm::max(sceneMax, position);
 						}
-					};
-
-					m_GfxDevice.create_rtas(blasInfo, blas);
-
-					// Create BLAS instance data
-					RTTLAS::BLASInstance instance = {
-						.instanceID = static_cast<uint32_t>(m_Instances.size()),
-						.instanceMask = 1,
-						.instanceContributionHitGroupIndex = 0, // TODO: Check out
-						// TODO (REVISIT): Ok, so it SEEMS like this is the SBT index for HIT GROUPS ONLY.
-						// So, for example, if we have the following shader groups:
-						// 0 -> ray-gen shader -> GENERAL
-						// 1 -> miss shader -> GENERAL
-						// 2 -> closest-hit -> TRIANGLES_HIT_GROUP
-						// Then the closest-hit shader at index 2 in the SBT will be the only
-						// hit group, and thus its index within the HIT GROUP SBT will be 0.
-						// That is at least what seems to be the case, so this might not be true
-						.blasResource = &blas
-					};
-
-					// Update the transform data
-					glm::mat4 scale = glm::scale(glm::mat4(1.0f), transform->scale);
-					glm::mat4 rotation = glm::mat4_cast(transform->orientation);
-					glm::mat4 translation = glm::translate(glm::mat4(1.0f), transform->position);
-					glm::mat4 transformation = glm::transpose(translation * rotation * scale); // TODO: Might be wrong
-
-					std::memcpy(instance.transform, &transformation[0][0], sizeof(instance.transform));
-
-					m_Instances.push_back(instance);
-
-					// Create object for scene desc
-					Object& object = m_SceneDescBufferData.emplace_back();
-					object.verticesBDA = m_GfxDevice.get_bda(model->vertexBuffer) + primitive.baseVertex * sizeof(ModelVertex);
-					object.indicesBDA = m_GfxDevice.get_bda(model->indexBuffer) + primitive.baseIndex * sizeof(uint32_t);
-					object.materialsBDA = m_GfxDevice.get_bda(materialBuffer);
-					object.matIndexOverride = matIndexOverride;
+					}
 				}
+
+				sceneEntity.numInstances = static_cast<uint32_t>(m_Instances.size()) - sceneEntity.firstInstance;
 			}
-		}
+		});
 
 		materialManager.update_gpu_buffer();
+		m_HasEmissiveMaterials = has_emissive_materials();
+
+		// NOTE: Everything up to here is part of the initial state
+		m_SceneVersion = ECS::advance_version();
+		m_StructureVersion = ECS::get_structure_version();
+
+		// ---------------------------- Create Light BVH ---------------------------
+		m_LightBVH.build(gather_light_triangles());
+		upload_light_bvh();
+
+		// --------------------------- Create Path Guiding -------------------------
+		m_SDTree.initialize(sceneMin, sceneMax);
+
+		const BufferInfo guidingTreeBufferInfo = {
+			.size = sizeof(SDTree::Header) + SDTree::MAX_SPATIAL_NODES * sizeof(SDTree::SpatialNode),
+			.stride = sizeof(SDTree::SpatialNode),
+			.usage = Usage::UPLOAD,
+			.bindFlags = BindFlag::SHADER_RESOURCE,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED | MiscFlag::PREFER_DEVICE_LOCAL,
+			.persistentMap = true
+		};
+
+		const BufferInfo guidingDirectionalBufferInfo = {
+			.size = SDTree::MAX_DIRECTIONAL_NODES * sizeof(SDTree::DirectionalNode),
+			.stride = sizeof(SDTree::DirectionalNode),
+			.usage = Usage::UPLOAD,
+			.bindFlags = BindFlag::SHADER_RESOURCE,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED | MiscFlag::PREFER_DEVICE_LOCAL,
+			.persistentMap = true
+		};
+
+		// NOTE: Sample counts per spatial node, followed by four energies per
+		// directional node. Written by the GPU, read back between iterations,
+		// so it stays in system memory, which the CPU reads through its caches.
+		const BufferInfo guidingTrainingBufferInfo = {
+			.size = SDTree::MAX_SPATIAL_NODES * sizeof(uint32_t) + SDTree::MAX_DIRECTIONAL_NODES * 4 * sizeof(float),
+			.stride = sizeof(float),
+			.usage = Usage::UPLOAD,
+			.bindFlags = BindFlag::SHADER_RESOURCE | BindFlag::UNORDERED_ACCESS,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED,
+			.persistentMap = true
+		};
+
+		m_GfxDevice.create_buffer(guidingTreeBufferInfo, m_GuidingTreeBuffer, nullptr);
+		m_GfxDevice.create_buffer(guidingDirectionalBufferInfo, m_GuidingDirectionalBuffer, nullptr);
+		m_GfxDevice.create_buffer(guidingTrainingBufferInfo, m_GuidingTrainingBuffer, nullptr);
+		upload_guiding_tree();
 
 
 		// ------------------------------ Create TLAS ------------------------------
@@ -139,19 +283,13 @@ namespace SR {
 			m_GfxDevice.write_blas_instance(m_Instances[i], dataSection);
 		}
 
-		// ------------------------- Shader Binding Tables -------------------------
-		m_GfxDevice.create_shader_binding_table(m_RTPipeline, 0, m_RayGenSBT);
-		m_GfxDevice.create_shader_binding_table(m_RTPipeline, 1, m_MissSBT);
-		m_GfxDevice.create_shader_binding_table(m_RTPipeline, 2, m_HitSBT);
-
 		// --------------------------- Create Scene Desc ---------------------------
 		const BufferInfo sceneDescBufferInfo = {
 			.size = static_cast<uint64_t>(m_Instances.size()) * sizeof(Object),
 			.stride = sizeof(Object),
-			.usage = Usage::UPLOAD,
+			.usage = Usage::DEFAULT,
 			.bindFlags = BindFlag::SHADER_RESOURCE,
-			.miscFlags = MiscFlag::BUFFER_STRUCTURED,
-			.persistentMap = false
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED
 		};
 
 		m_GfxDevice.create_buffer(sceneDescBufferInfo, m_SceneDescBuffer, m_SceneDescBufferData.data());
@@ -165,39 +303,523 @@ namespace SR {
 		m_GfxDevice.build_rtas(m_TLAS, cmdList);
 	}
 
-	void RayTracingPass::execute(PassExecuteInfo& executeInfo, Scene& scene) {
-		static glm::mat4 lastViewMatrix = executeInfo.frameInfo->camera->get_view_matrix();
-		static glm::mat4 lastProjMatrix = executeInfo.frameInfo->camera->get_proj_matrix();
+	const RayTracingPass::PipelineVariant& RayTracingPass::get_pipeline_variant(const Specialization& specialization) {
+		assert(specialization.rayBounces < 256);
+
+		const uint32_t key =
+			specialization.rayBounces |
+			(specialization.useNormalMaps << 8) |
+			(specialization.useSkybox << 9) |
+			(specialization.hasEmissiveMaterials << 10) |
+			(specialization.integrator << 11);
+
+		auto it = m_PipelineVariants.find(key);
+
+		if (it != m_PipelineVariants.end()) {
+			return it->second;
+		}
+
+		// NOTE: Only happens the first time a combination is used, e.g. when a
+		// toggle is flipped, which costs a pipeline compilation
+		PipelineVariant& variant = m_PipelineVariants[key];
+
+		const RTPipelineInfo rtPipelineInfo = {
+			.rayGenShader = &m_RayGenShader,
+			.missShader = &m_MissShader,
+			.closestHitShader = &m_ClosestHitShader,
+			.shaderGroups = {
+				RTShaderGroup { RTShaderGroup::Type::GENERAL,    0u, ~0u }, // ray-gen
+				RTShaderGroup { RTShaderGroup::Type::GENERAL,	 1u, ~0u }, // miss
+				RTShaderGroup { RTShaderGroup::Type::TRIANGLES, ~0u,  2u } // closest_hit
+			},
+			.payloadSize = 4 * sizeof(float),
+			.specializationConstants = {
+				specialization.rayBounces,
+				specialization.useNormalMaps,
+				specialization.useSkybox,
+				specialization.hasEmissiveMaterials,
+				specialization.integrator
+			}
+		};
+
+		m_GfxDevice.create_rt_pipeline(rtPipelineInfo, variant.pipeline);
+		m_GfxDevice.create_shader_binding_table(variant.pipeline, 0, variant.rayGenSBT);
+		m_GfxDevice.create_shader_binding_table(variant.pipeline, 1, variant.missSBT);
+		m_GfxDevice.create_shader_binding_table(variant.pipeline, 2, variant.hitSBT);
+
+		return variant;
+	}
+
+	bool RayTracingPass::has_emissive_materials() const {
+		for (const Material& material : m_MaterialManager->get_materials()) {
+			if (material.type == Material::Type::DIFFUSE_LIGHT) {
+				return true;
+			}
+		}
+
+		return false;
+	}
 
-		// Reset accumulation if camera has moved
-		if (executeInfo.frameInfo->camera->get_view_matrix() != lastViewMatrix ||
-			executeInfo.frameInfo->camera->get_proj_matrix() != lastProjMatrix) {
-			m_TotalSamplesPerPixel = m_SamplesPerPixel; // reset accumulation
+	std::vector<LightTriangle> RayTracingPass::gather_light_triangles() {
+		const auto& materials = m_MaterialManager->get_materials();
+		std::vector<LightTriangle> lightTriangles = {};
+		m_LocalLightTriangles.clear();
+
+		for (SceneEntity& sceneEntity : m_SceneEntities) {
+			sceneEntity.hasLights = false;
+			sceneEntity.numLights = 0;
+		}
+
+		const auto is_emissive = [](const Material& material) {
+			return material.type == Material::Type::DIFFUSE_LIGHT && material.color != glm::vec3(0.0f);
+		};
+
+		// Instances whose material override is not emissive cannot contain
+		// lights, so their geometry is never paged in
+		std::vector<const InstanceSource*> candidates = {};
+		std::vector<uint32_t> candidatePages = {};
+
+		for (const InstanceSource& source : m_InstanceSources) {
+			const uint32_t matIndexOverride = m_SceneEntities[source.sceneEntityIndex].matIndexOverride;
+
+			if (matIndexOverride != 0 && !is_emissive(materials[matIndexOverride])) {
+				continue;
+			}
+
+			candidates.push_back(&source);
+			candidatePages.push_back(source.primitive.geometryPage);
+		}
+
+		GeometryCache& geometryCache = AssetManager::get_geometry_cache();
+
+		// Gather emissive triangles in world space
+		for (size_t c = 0; c < candidates.size(); ++c) {
+			// NOTE: The next batch of pages is read ahead while the current
+			// one is being processed
+			if (c % GEOMETRY_PREFETCH_DISTANCE == 0) {
+				const size_t prefetchBegin = c == 0 ? 0 : c + GEOMETRY_PREFETCH_DISTANCE;
+				const size_t prefetchEnd = std::min(c + 2 * GEOMETRY_PREFETCH_DISTANCE, candidates.size());
+
+				if (prefetchBegin < prefetchEnd) {
+					geometryCache.prefetch(candidatePages.data() + prefetchBegin, prefetchEnd - prefetchBegin);
+				}
+			}
+
+			const InstanceSource& source = *candidates[c];
+			SceneEntity& sceneEntity = m_SceneEntities[source.sceneEntityIndex];
+			const MeshPrimitive& primitive = source.primitive;
+			const glm::mat4& modelMatrix = sceneEntity.world;
+			const GeometryCache::PageView geometry = geometryCache.acquire(primitive.geometryPage);
+
+			for (uint32_t i = 0; i + 2 < primitive.numIndices; i += 3) {
+				const uint32_t* triIndices = geometry.get_indices() + i;
+				const ModelVertex& v0 = geometry.get_vertices()[triIndices[0]];
+				const ModelVertex& v1 = geometry.get_vertices()[triIndices[1]];
+				const ModelVertex& v2 = geometry.get_vertices()[triIndices[2]];
+
+				const uint32_t matIndexOverride = sceneEntity.matIndexOverride;
+				const Material& triMaterial = materials[matIndexOverride != 0 ? matIndexOverride : v0.matIndex];
+
+				if (!is_emissive(triMaterial)) {
+					continue;
+				}
+
+				LightTriangle light = {};
+				light.p0 = glm::vec3(modelMatrix * glm::vec4(v0.position, 1.0f));
+				light.p1 = glm::vec3(modelMatrix * glm::vec4(v1.position, 1.0f));
+				light.p2 = glm::vec3(modelMatrix * glm::vec4(v2.position, 1.0f));
+				light.area = 0.5f * glm::length(glm::cross(light.p1 - light.p0, light.p2 - light.p0));
+				light.emission = triMaterial.color;
+
+				if (light.area == 0.0f) {
+					continue;
+				}
+
+				// NOTE: The instances of an entity are next to each other, and
+				// so are its lights
+				if (!sceneEntity.hasLights) {
+					sceneEntity.firstLight = static_cast<uint32_t>(lightTriangles.size());
+				}
+
+				LightTriangle& localLight = m_LocalLightTriangles.emplace_back(light);
+				localLight.p0 = v0.position;
+				localLight.p1 = v1.position;
+				localLight.p2 = v2.position;
+
+				lightTriangles.push_back(light);
+				sceneEntity.hasLights = true;
+				sceneEntity.numLights++;
+			}
+		}
+
+		return lightTriangles;
+	}
+
+	void RayTracingPass::upload_light_bvh() {
+		if (m_LightBVH.empty()) {
+			return;
+		}
+
+		const auto& nodes = m_LightBVH.get_nodes();
+		const auto& lights = m_LightBVH.get_lights();
+
+		const BufferInfo nodeBufferInfo = {
+			.size = static_cast<uint64_t>(nodes.size()) * sizeof(LightBVH::Node),
+			.stride = sizeof(LightBVH::Node),
+			.usage = Usage::DEFAULT,
+			.bindFlags = BindFlag::SHADER_RESOURCE,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED
+		};
+
+		const BufferInfo lightBufferInfo = {
+			.size = static_cast<uint64_t>(lights.size()) * sizeof(LightTriangle),
+			.stride = sizeof(LightTriangle),
+			.usage = Usage::DEFAULT,
+			.bindFlags = BindFlag::SHADER_RESOURCE,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED
+		};
+
+		m_GfxDevice.create_buffer(nodeBufferInfo, m_LightBVHNodeBuffer, nodes.data());
+		m_GfxDevice.create_buffer(lightBufferInfo, m_LightTriangleBuffer, lights.data());
+	}
+
+	// Moves the lights of the entities in m_MovedLightEntities to their new
+	// world transforms and refits the light BVH, whose lights stay the same.
+	// The GPU buffers are updated in place. NOTE: Returns false if a light
+	// has become degenerate, in which case the light BVH has to be rebuilt.
+	bool RayTracingPass::refit_light_bvh(const CommandList& cmdList) {
+		m_RefitLightTriangles = m_LightBVH.get_lights();
+
+		for (uint32_t sceneEntityIndex : m_MovedLightEntities) {
+			const SceneEntity& sceneEntity = m_SceneEntities[sceneEntityIndex];
+			const glm::mat4& modelMatrix = sceneEntity.world;
+
+			for (uint32_t i = sceneEntity.firstLight; i < sceneEntity.firstLight + sceneEntity.numLights; ++i) {
+				const LightTriangle& localLight = m_LocalLightTriangles[i];
+				LightTriangle& light = m_RefitLightTriangles[i];
+
+				light.p0 = glm::vec3(modelMatrix * glm::vec4(localLight.p0, 1.0f));
+				light.p1 = glm::vec3(modelMatrix * glm::vec4(localLight.p1, 1.0f));
+				light.p2 = glm::vec3(modelMatrix * glm::vec4(localLight.p2, 1.0f));
+				light.area = 0.5f * glm::length(glm::cross(light.p1 - light.p0, light.p2 - light.p0));
+
+				if (light.area == 0.0f) {
+					return false;
+				}
+			}
+		}
+
+		m_LightBVH.refit(m_RefitLightTriangles);
+
+		const auto& nodes = m_LightBVH.get_nodes();
+		const auto& lights = m_LightBVH.get_lights();
+		const uint64_t nodesSize = static_cast<uint64_t>(nodes.size()) * sizeof(LightBVH::Node);
+		const uint64_t lightsSize = static_cast<uint64_t>(lights.size()) * sizeof(LightTriangle);
+
+		if (m_LightBVHStagingBuffer.info.size != nodesSize + lightsSize) {
+			const BufferInfo stagingBufferInfo = {
+				.size = nodesSize + lightsSize,
+				.stride = sizeof(float),
+				.usage = Usage::UPLOAD,
+				.persistentMap = true
+			};
+
+			m_GfxDevice.create_buffer(stagingBufferInfo, m_LightBVHStagingBuffer, nullptr);
+		}
+
+		assert_frames_complete();
+		uint8_t* stagingData = static_cast<uint8_t*>(m_LightBVHStagingBuffer.mappedData);
+		std::memcpy(stagingData, nodes.data(), nodesSize);
+		std::memcpy(stagingData + nodesSize, lights.data(), lightsSize);
+
+		m_GfxDevice.copy_buffer(m_LightBVHStagingBuffer, 0, m_LightBVHNodeBuffer, 0, nodesSize, cmdList);
+		m_GfxDevice.copy_buffer(m_LightBVHStagingBuffer, nodesSize, m_LightTriangleBuffer, 0, lightsSize, cmdList);
+
+		return true;
+	}
+
+	bool RayTracingPass::have_renderables_changed() const {
+		const auto renderables = ECS::view<const WorldTransform, const Renderable>();
+
+		if (renderables.count() != m_SceneEntities.size()) {
+			return true;
 		}
 
+		bool changed = false;
+
+		renderables.for_each_chunk([&](const ECS::ChunkView& chunk) {
+			const bool hasMaterial = chunk.get<const Material>() != nullptr;
+
+			for (uint32_t i = 0; i < chunk.count && !changed; ++i) {
+				auto search = m_SceneEntityIndexLUT.find(chunk.entities[i]);
+
+				// NOTE: Gaining or losing a material changes the instances too
+				changed =
+					search == m_SceneEntityIndexLUT.end() ||
+					m_SceneEntities[search->second].hasMaterial != hasMaterial;
+			}
+		});
+
+		return changed;
+	}
+
+	std::vector<uint32_t> RayTracingPass::apply_scene_edits(Scene& scene, const CommandList& cmdList, bool& lightsChanged) {
+		std::vector<uint32_t> editedInstances = {};
+		bool transformsChanged = false;
+		bool materialsChanged = false;
+		bool emittersChanged = false; // NOTE: Lights may have been added or removed
+		lightsChanged = false;
+		m_MovedLightEntities.clear();
+		assert_frames_complete(); // NOTE: The instances, the TLAS and the materials are updated in place
+
+		// Renderables that were created or destroyed, e.g. through command
+		// buffers or prefabs, change the set of instances. NOTE: The whole
+		// scene is rebuilt, which is slow but rare, and counts as a light
+		// change so that accumulation starts over.
+		if (ECS::get_structure_version() != m_StructureVersion) {
+			m_StructureVersion = ECS::get_structure_version();
+
+			if (have_renderables_changed()) {
+				m_GfxDevice.wait_for_gpu();
+				initialize(scene, *m_MaterialManager);
+				build_acceleration_structures(cmdList);
+
+				lightsChanged = true;
+				return editedInstances;
+			}
+		}
+
+		// NOTE: Only the entities whose components changed since the last
+		// frame are visited, the rest of the scene is never touched
+		const uint32_t lastVersion = m_SceneVersion;
+		m_SceneVersion = ECS::advance_version();
+
+		m_ChangedEntities.clear();
+		ECS::get_changed_entities<WorldTransform, Material>(lastVersion, m_ChangedEntities);
+
+		for (entity_id entity : m_ChangedEntities) {
+			auto search = m_SceneEntityIndexLUT.find(entity);
+
+			if (search == m_SceneEntityIndexLUT.end()) {
+				continue;
+			}
+
+			SceneEntity& sceneEntity = m_SceneEntities[search->second];
+			const WorldTransform* worldTransform = ECS::read_component<WorldTransform>(entity);
+			const Material* material = sceneEntity.hasMaterial ? ECS::read_component<Material>(entity) : nullptr;
+
+			// NOTE: Changes of either component are reported, and the other
+			// one may have been removed without removing the renderable
+			if (worldTransform == nullptr || (sceneEntity.hasMaterial && material == nullptr)) {
+				continue;
+			}
+
+			// NOTE: Still compared, since only one of them may have changed,
+			// or neither if the entity was marked without an actual change
+			const bool transformChanged = worldTransform->matrix != sceneEntity.world;
+			const bool materialChanged = material != nullptr && !is_same_material(*material, m_MaterialManager->get_materials()[sceneEntity.matIndexOverride]);
+
+			if (!transformChanged && !materialChanged) {
+				continue;
+			}
+
+			if (transformChanged) {
+				sceneEntity.world = worldTransform->matrix;
+				const glm::mat4 transformation = glm::transpose(worldTransform->matrix);
+
+				for (uint32_t i = sceneEntity.firstInstance; i < sceneEntity.firstInstance + sceneEntity.numInstances; ++i) {
+					std::memcpy(m_Instances[i].transform, &transformation[0][0], sizeof(m_Instances[i].transform));
+
+					void* dataSection = (uint8_t*)m_InstanceBuffer.mappedData + i * m_InstanceBuffer.info.stride;
+					m_GfxDevice.write_blas_instance(m_Instances[i], dataSection);
+				}
+
+				transformsChanged = true;
+
+				if (sceneEntity.hasLights) {
+					m_MovedLightEntities.push_back(search->second);
+					lightsChanged = true;
+				}
+			}
+
+			if (materialChanged) {
+				// NOTE: Also covers materials that stop or start emitting
+				emittersChanged |=
+					material->type == Material::Type::DIFFUSE_LIGHT ||
+					m_MaterialManager->get_materials()[sceneEntity.matIndexOverride].type == Material::Type::DIFFUSE_LIGHT;
+				lightsChanged |= emittersChanged;
+
+				m_MaterialManager->update_material(sceneEntity.matIndexOverride, *material);
+				materialsChanged = true;
+			}
+
+			for (uint32_t i = sceneEntity.firstInstance; i < sceneEntity.firstInstance + sceneEntity.numInstances; ++i) {
+				editedInstances.push_back(m_Instances[i].instanceID);
+			}
+		}
+
+		if (transformsChanged) {
+			m_GfxDevice.build_rtas(m_TLAS, cmdList);
+		}
+
+		if (materialsChanged) {
+			m_MaterialManager->update_gpu_buffer();
+			m_HasEmissiveMaterials = has_emissive_materials();
+		}
+
+		// NOTE: Lights that only moved keep the topology of the light BVH,
+		// so neither their geometry nor the buffers have to be recreated
+		if (emittersChanged || (!m_MovedLightEntities.empty() && !refit_light_bvh(cmdList))) {
+			m_LightBVH.build(gather_light_triangles());
+			m_GfxDevice.wait_for_gpu();
+			upload_light_bvh();
+		}
+
+		return editedInstances;
+	}
+
+	void RayTracingPass::execute(PassExecuteInfo& executeInfo, Scene& scene) {
+		const Camera& camera = *executeInfo.frameInfo->camera;
 		const CommandList& cmdList = *executeInfo.cmdList;
 		RenderGraph& renderGraph = *executeInfo.renderGraph;
 
+		finish_checkpoint_readback();
+
+		if (m_PendingResume.has_value()) {
+			if (!restore_checkpoint(*m_PendingResume, cmdList, renderGraph, camera)) {
+				std::cerr << "Render checkpoint does not match the current view, discarding it\n";
+			}
+
+			m_PendingResume.reset();
+		}
+
+		// Edits made through the ECS since the last frame. NOTE: Done before
+		// anything else, since moving lights can change the integrator.
+		bool lightsChanged = false;
+		const std::vector<uint32_t> editedInstances = apply_scene_edits(scene, cmdList, lightsChanged);
+
+		const bool cameraMoved =
+			camera.get_view_matrix() != m_LastViewMatrix ||
+			camera.get_proj_matrix() != m_LastProjMatrix;
+
+		// NOTE: Without emitters there is nothing to start light subpaths from
+		const Integrator integrator = m_LightBVH.empty() ? Integrator::PATH_TRACING : m_Integrator;
+		const bool isBidirectional = integrator == Integrator::BIDIRECTIONAL;
+
 		auto rtOutput = renderGraph.get_attachment("RTOutput");
 		auto rtAccumulation = renderGraph.get_attachment("RTAccumulation");
+		auto rtAccumulationHistory = renderGraph.get_attachment("RTAccumulationHistory");
+		auto rtHitInfo = renderGraph.get_attachment("RTHitInfo");
+		auto rtHitInfoHistory = renderGraph.get_attachment("RTHitInfoHistory");
+		auto rtReservoirs = renderGraph.get_attachment("RTReservoirs");
+		auto rtReservoirsHistory = renderGraph.get_attachment("RTReservoirsHistory");
+		auto rtSurface = renderGraph.get_attachment("RTSurface");
+		auto rtSurfaceHistory = renderGraph.get_attachment("RTSurfaceHistory");
+
+		if (isBidirectional) {
+			update_light_film(rtOutput->texture.info.width, rtOutput->texture.info.height);
+		}
+
+		// Reset accumulation if camera has moved, unless the previous
+		// accumulation can be reprojected into the new view. NOTE: Light
+		// tracing splats can land in any pixel, so they can't be reprojected.
+		if (integrator != m_LastIntegrator || (cameraMoved && (!m_UseTemporalReprojection || isBidirectional))) {
+			m_LastIntegrator = integrator;
+			reset_accumulation();
+		}
+
+		// Only the tiles whose paths might have touched an edited instance
+		// start over. NOTE: Light edits change the direct lighting of every
+		// pixel, and light tracing splats can land anywhere.
+		if (!editedInstances.empty() || lightsChanged) {
+			if (!m_UseSparseResets || lightsChanged || isBidirectional || !m_TileFiltersExact) {
+				reset_accumulation();
+			}
+			else {
+				m_EditEpoch++;
+
+				for (uint32_t instanceID : editedInstances) {
+					m_PendingEdits[instanceID] = m_EditEpoch;
+				}
+
+				// NOTE: Tiles that never see an edited instance never start
+				// over, so the edits would otherwise pile up and be checked
+				// every frame
+				if (m_PendingEdits.size() > MAX_PENDING_EDITS) {
+					reset_accumulation();
+				}
+			}
+		}
+
+		// Reprojected history moves between tiles, so the tile filters no
+		// longer describe it
+		if (cameraMoved && m_TotalSamplesPerPixel != 0) {
+			if (!m_PendingEdits.empty()) {
+				reset_accumulation();
+			}
+			else {
+				m_TileFiltersExact = false;
+			}
+		}
+
+		update_tile_states(rtOutput->texture.info.width, rtOutput->texture.info.height);
 
 		m_PushConstant.frameIndex = m_GfxDevice.get_frame_index();
 		m_PushConstant.rtAccumulationIndex = m_GfxDevice.get_descriptor_index(rtAccumulation->texture, SubresourceType::UAV);
 		m_PushConstant.rtImageIndex = m_GfxDevice.get_descriptor_index(rtOutput->texture, SubresourceType::UAV);
 		m_PushConstant.sceneDescBufferIndex = m_GfxDevice.get_descriptor_index(m_SceneDescBuffer, SubresourceType::SRV);
-		m_PushConstant.rayBounces = m_RayBounces;
 		m_PushConstant.samplesPerPixel = m_SamplesPerPixel;
 		m_PushConstant.totalSamplesPerPixel = m_TotalSamplesPerPixel;
-		m_PushConstant.useNormalMaps = m_UseNormalMaps ? 1 : 0;
-		m_PushConstant.useSkybox = m_UseSkybox ? 1 : 0;
+		m_PushConstant.rtAccumulationHistoryIndex = m_GfxDevice.get_descriptor_index(rtAccumulationHistory->texture, SubresourceType::UAV);
+		m_PushConstant.rtHitInfoIndex = m_GfxDevice.get_descriptor_index(rtHitInfo->texture, SubresourceType::UAV);
+		m_PushConstant.rtHitInfoHistoryIndex = m_GfxDevice.get_descriptor_index(rtHitInfoHistory->texture, SubresourceType::UAV);
+		m_PushConstant.reprojectHistory = cameraMoved && !isBidirectional ? 1 : 0;
+		m_PushConstant.maxHistoryLength = m_MaxHistoryLength;
+		m_PushConstant.pixelSpreadAngle = camera.get_pixel_spread_angle(rtOutput->texture.info.height);
+		m_PushConstant.useLightBVH = m_UseLightBVH && !m_LightBVH.empty() ? 1 : 0;
+
+		if (!m_LightBVH.empty()) {
+			m_PushConstant.lightBVHNodesIndex = m_GfxDevice.get_descriptor_index(m_LightBVHNodeBuffer, SubresourceType::SRV);
+			m_PushConstant.lightTrianglesIndex = m_GfxDevice.get_descriptor_index(m_LightTriangleBuffer, SubresourceType::SRV);
+		}
+
+		m_PushConstant.reservoirsIndex = m_GfxDevice.get_descriptor_index(rtReservoirs->texture, SubresourceType::UAV);
+		m_PushConstant.reservoirsHistoryIndex = m_GfxDevice.get_descriptor_index(rtReservoirsHistory->texture, SubresourceType::UAV);
+		m_PushConstant.surfaceIndex = m_GfxDevice.get_descriptor_index(rtSurface->texture, SubresourceType::UAV);
+		m_PushConstant.surfaceHistoryIndex = m_GfxDevice.get_descriptor_index(rtSurfaceHistory->texture, SubresourceType::UAV);
+		m_PushConstant.useReSTIR = m_PushConstant.useLightBVH != 0 && m_UseReSTIR ? 1 : 0;
+		m_PushConstant.useReSTIRBiasCorrection = m_UseReSTIRBiasCorrection ? 1 : 0;
+
+		update_path_guiding();
+		m_PushConstant.guidingTreeIndex = m_GfxDevice.get_descriptor_index(m_GuidingTreeBuffer, SubresourceType::SRV);
+		m_PushConstant.guidingDirectionalIndex = m_GfxDevice.get_descriptor_index(m_GuidingDirectionalBuffer, SubresourceType::SRV);
+		m_PushConstant.guidingTrainingIndex = m_GfxDevice.get_descriptor_index(m_GuidingTrainingBuffer, SubresourceType::SRV);
+
+		if (isBidirectional) {
+			m_PushConstant.lightFilmIndex = m_GfxDevice.get_descriptor_index(m_LightFilmBuffer, SubresourceType::SRV);
+		}
+
+		m_PushConstant.tileStatesIndex = m_GfxDevice.get_descriptor_index(m_TileStatesBuffer, SubresourceType::SRV);
+
+		// Feature toggles are baked into the pipeline, so the shaders carry
+		// no branches for the features that are turned off
+		const Specialization specialization = {
+			.rayBounces = m_RayBounces,
+			.useNormalMaps = m_UseNormalMaps ? 1u : 0u,
+			.useSkybox = m_UseSkybox ? 1u : 0u,
+			.hasEmissiveMaterials = m_HasEmissiveMaterials ? 1u : 0u,
+			.integrator = static_cast<uint32_t>(integrator)
+		};
+
+		const PipelineVariant& variant = get_pipeline_variant(specialization);
 
-		m_GfxDevice.bind_rt_pipeline(m_RTPipeline, cmdList);
-		m_GfxDevice.push_rt_constants(&m_PushConstant, sizeof(m_PushConstant), m_RTPipeline, cmdList);
+		m_GfxDevice.bind_rt_pipeline(variant.pipeline, cmdList);
+		m_GfxDevice.push_rt_constants(&m_PushConstant, sizeof(m_PushConstant), variant.pipeline, cmdList);
 
 		const DispatchRaysInfo dispatchInfo = {
-			.rayGenTable = &m_RayGenSBT,
-			.missTable = &m_MissSBT,
-			.hitGroupTable = &m_HitSBT,
+			.rayGenTable = &variant.rayGenSBT,
+			.missTable = &variant.missSBT,
+			.hitGroupTable = &variant.hitSBT,
 			.width = rtOutput->texture.info.width,
 			.height = rtOutput->texture.info.height
 		};
@@ -205,8 +827,426 @@ namespace SR {
 		m_GfxDevice.dispatch_rays(dispatchInfo, cmdList);
 
 		m_TotalSamplesPerPixel += m_SamplesPerPixel;
+		m_FramesSinceCheckpoint++;
+
+		if (m_CheckpointInterval != 0 && m_FramesSinceCheckpoint >= m_CheckpointInterval) {
+			m_CheckpointRequested = true;
+		}
+
+		// NOTE: A capture only needs the accumulation, unless it shares the
+		// readback with a checkpoint
+		if (m_CheckpointRequested || m_CaptureRequested) {
+			const size_t numAttachments = m_CheckpointRequested ? std::size(CHECKPOINT_ATTACHMENTS) : 1;
+			begin_checkpoint_readback(cmdList, renderGraph, camera, integrator, numAttachments);
+
+			m_PendingReadbackIsCheckpoint = m_CheckpointRequested;
+			m_PendingReadbackIsCapture = m_CaptureRequested;
+			m_CheckpointRequested = false;
+			m_CaptureRequested = false;
+
+			if (m_PendingReadbackIsCheckpoint) {
+				m_FramesSinceCheckpoint = 0;
+			}
+		}
+
+		// This frame's accumulation, first-hit info and reservoirs become next
+		// frame's history. NOTE: Both attachments of each pair are kept in the
+		// same resource state, so swapping the textures is all that is needed.
+		std::swap(rtAccumulation->texture, rtAccumulationHistory->texture);
+		std::swap(rtHitInfo->texture, rtHitInfoHistory->texture);
+		std::swap(rtReservoirs->texture, rtReservoirsHistory->texture);
+		std::swap(rtSurface->texture, rtSurfaceHistory->texture);
+
+		m_LastViewMatrix = camera.get_view_matrix();
+		m_LastProjMatrix = camera.get_proj_matrix();
+	}
+
+	void RayTracingPass::reset_accumulation() {
+		m_TotalSamplesPerPixel = 0;
+
+		if (m_LastIntegrator == Integrator::BIDIRECTIONAL) {
+			clear_light_film();
+		}
+	}
+
+	void RayTracingPass::update_tile_states(uint32_t width, uint32_t height) {
+		const size_t tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		const size_t tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		const size_t numTiles = tilesX * tilesY;
+		const uint64_t size = numTiles * sizeof(TileState);
+
+		if (m_TileStatesBuffer.info.size != size) {
+			// NOTE: The old states might still be in use by frames in flight
+			m_GfxDevice.wait_for_gpu();
+
+			// NOTE: Not device-local, the CPU reads the filters of every tile
+			// every frame, and reads from device-local memory are uncached
+			const BufferInfo tileStatesBufferInfo = {
+				.size = size,
+				.stride = sizeof(TileState),
+				.usage = Usage::UPLOAD,
+				.bindFlags = BindFlag::SHADER_RESOURCE | BindFlag::UNORDERED_ACCESS,
+				.miscFlags = MiscFlag::BUFFER_STRUCTURED,
+				.persistentMap = true
+			};
+
+			m_GfxDevice.create_buffer(tileStatesBufferInfo, m_TileStatesBuffer, nullptr);
+			std::memset(m_TileStatesBuffer.mappedData, 0, size);
+			m_TileResetEpochs.assign(numTiles, m_EditEpoch);
+			m_TileFiltersExact = m_TotalSamplesPerPixel == 0;
+		}
+
+		// Accumulation starts over everywhere, and so do the filters
+		if (m_TotalSamplesPerPixel == 0) {
+			std::memset(m_TileStatesBuffer.mappedData, 0, size);
+			std::fill(m_TileResetEpochs.begin(), m_TileResetEpochs.end(), m_EditEpoch);
+			m_PendingEdits.clear();
+			m_TileFiltersExact = true;
+			return;
+		}
+
+		update_tile_resets();
+	}
+
+	void RayTracingPass::update_tile_resets() {
+		assert_frames_complete();
+		TileState* tiles = static_cast<TileState*>(m_TileStatesBuffer.mappedData);
+
+		auto filter_contains = [](const TileState& tile, uint32_t instanceID) {
+			uint32_t bits[2] = {};
+			tile_filter_bits(instanceID, bits);
+
+			for (uint32_t bit : bits) {
+				if ((tile.filter[bit >> 5] & (1u << (bit & 31))) == 0) {
+					return false;
+				}
+			}
+
+			return true;
+		};
+
+		// The bits of all pending edits, so that the tiles that cannot have
+		// seen any of them are skipped with a single test. NOTE: This is most
+		// of them, e.g. the tiles that only see the sky.
+		uint32_t pendingFilter[TILE_FILTER_WORDS] = {};
+
+		for (const auto& [instanceID, epoch] : m_PendingEdits) {
+			uint32_t bits[2] = {};
+			tile_filter_bits(instanceID, bits);
+
+			for (uint32_t bit : bits) {
+				pendingFilter[bit >> 5] |= 1u << (bit & 31);
+			}
+		}
+
+		uint32_t minResetEpoch = m_EditEpoch;
+
+		for (size_t t = 0; t < m_TileResetEpochs.size(); ++t) {
+			// Resets only last a single frame
+			tiles[t].reset = 0;
+
+			uint32_t overlap = 0;
+
+			for (uint32_t w = 0; w < TILE_FILTER_WORDS; ++w) {
+				overlap |= tiles[t].filter[w] & pendingFilter[w];
+			}
+
+			if (overlap == 0) {
+				minResetEpoch = std::min(minResetEpoch, m_TileResetEpochs[t]);
+				continue;
+			}
+
+			// An edit also affects tiles that only start seeing the instance
+			// afterwards, e.g. when it moves into view. Every edit is therefore
+			// kept until all tiles have started over since, and the tiles are
+			// checked again each frame.
+			for (const auto& [instanceID, epoch] : m_PendingEdits) {
+				if (epoch > m_TileResetEpochs[t] && filter_contains(tiles[t], instanceID)) {
+					tiles[t].reset = 1;
+					std::memset(tiles[t].filter, 0, sizeof(tiles[t].filter));
+					m_TileResetEpochs[t] = m_EditEpoch;
+					break;
+				}
+			}
+
+			minResetEpoch = std::min(minResetEpoch, m_TileResetEpochs[t]);
+		}
+
+		std::erase_if(m_PendingEdits, [minResetEpoch](const auto& edit) { return edit.second <= minResetEpoch; });
+	}
+
+	void RayTracingPass::assert_frames_complete() const {
+		assert(m_GfxDevice.get_completed_frame_count() == m_GfxDevice.get_frame_count() && "The GPU may still use the mapped buffers");
+	}
+
+	void RayTracingPass::update_path_guiding() {
+		// NOTE: Matches GUIDING_MODE_SAMPLE and GUIDING_MODE_TRAIN in shaders
+		constexpr uint32_t GUIDING_MODE_SAMPLE = 1;
+		constexpr uint32_t GUIDING_MODE_TRAIN = 2;
+
+		if (!m_UsePathGuiding) {
+			m_PushConstant.guidingMode = 0;
+			return;
+		}
+
+		// Iteration k trains for 2^k frames, so that later and better trees
+		// get the most samples. Once an iteration is done, the training data is
+		// read back and used to build the tree for the next one.
+		if (m_SDTree.get_iteration() < m_GuidingTrainingIterations &&
+			m_GuidingIterationFrames >= (1u << m_SDTree.get_iteration())) {
+
+			// NOTE: The GPU must be done writing training data
+			m_GfxDevice.wait_for_gpu();
+
+			const uint8_t* trainingData = static_cast<const uint8_t*>(m_GuidingTrainingBuffer.mappedData);
+			m_SDTree.refine(
+				reinterpret_cast<const uint32_t*>(trainingData),
+				reinterpret_cast<const float*>(trainingData + SDTree::MAX_SPATIAL_NODES * sizeof(uint32_t))
+			);
+
+			upload_guiding_tree();
+			m_GuidingIterationFrames = 0;
+		}
+
+		m_GuidingIterationFrames++;
+
+		// NOTE: The first iteration only trains, since the initial tree is
+		// uniform and would just waste samples
+		m_PushConstant.guidingMode = 0;
+
+		if (m_SDTree.get_iteration() > 0) {
+			m_PushConstant.guidingMode |= GUIDING_MODE_SAMPLE;
+		}
+
+		if (m_SDTree.get_iteration() < m_GuidingTrainingIterations) {
+			m_PushConstant.guidingMode |= GUIDING_MODE_TRAIN;
+		}
+	}
+
+	void RayTracingPass::upload_guiding_tree() {
+		const SDTree::Header& header = m_SDTree.get_header();
+		const auto& spatialNodes = m_SDTree.get_spatial_nodes();
+		const auto& directionalNodes = m_SDTree.get_directional_nodes();
+
+		uint8_t* treeData = static_cast<uint8_t*>(m_GuidingTreeBuffer.mappedData);
+		std::memcpy(treeData, &header, sizeof(header));
+		std::memcpy(treeData + sizeof(header), spatialNodes.data(), spatialNodes.size() * sizeof(SDTree::SpatialNode));
+		std::memcpy(m_GuidingDirectionalBuffer.mappedData, directionalNodes.data(), directionalNodes.size() * sizeof(SDTree::DirectionalNode));
+
+		// Clear the training data for the new tree
+		uint8_t* trainingData = static_cast<uint8_t*>(m_GuidingTrainingBuffer.mappedData);
+		std::memset(trainingData, 0, spatialNodes.size() * sizeof(uint32_t));
+		std::memset(trainingData + SDTree::MAX_SPATIAL_NODES * sizeof(uint32_t), 0, directionalNodes.size() * 4 * sizeof(float));
+	}
+
+	void RayTracingPass::request_checkpoint() {
+		m_CheckpointRequested = true;
+	}
+
+	void RayTracingPass::resume_from_checkpoint(RenderCheckpoint&& checkpoint) {
+		m_PendingResume = std::move(checkpoint);
+	}
+
+	void RayTracingPass::request_capture() {
+		m_CaptureRequested = true;
+	}
+
+	std::optional<RenderCheckpoint> RayTracingPass::take_capture() {
+		finish_checkpoint_readback();
+
+		std::optional<RenderCheckpoint> capture = std::move(m_Capture);
+		m_Capture.reset();
+
+		return capture;
+	}
+
+	void RayTracingPass::update_light_film(uint32_t width, uint32_t height) {
+		const uint64_t size = static_cast<uint64_t>(width) * height * 3 * sizeof(float);
+
+		if (m_LightFilmBuffer.info.size == size) {
+			return;
+		}
+
+		// NOTE: The old film might still be in use by frames in flight
+		m_GfxDevice.wait_for_gpu();
+
+		const BufferInfo lightFilmBufferInfo = {
+			.size = size,
+			.stride = sizeof(float),
+			.usage = Usage::UPLOAD,
+			.bindFlags = BindFlag::SHADER_RESOURCE | BindFlag::UNORDERED_ACCESS,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED | MiscFlag::PREFER_DEVICE_LOCAL,
+			.persistentMap = true
+		};
+
+		m_GfxDevice.create_buffer(lightFilmBufferInfo, m_LightFilmBuffer, nullptr);
+		std::memset(m_LightFilmBuffer.mappedData, 0, size);
+	}
+
+	void RayTracingPass::clear_light_film() {
+		if (m_LightFilmBuffer.mappedData == nullptr) {
+			return;
+		}
+
+		// NOTE: Splats are added by the GPU, so it must be done with the film
+		m_GfxDevice.wait_for_gpu();
+		std::memset(m_LightFilmBuffer.mappedData, 0, m_LightFilmBuffer.info.size);
+	}
+
+	void RayTracingPass::update_checkpoint_buffer(uint64_t size) {
+		if (m_CheckpointBuffer.info.size >= size) {
+			return;
+		}
+
+		// NOTE: The old buffer might still be in use by frames in flight
+		m_GfxDevice.wait_for_gpu();
+
+		const BufferInfo checkpointBufferInfo = {
+			.size = size,
+			.stride = sizeof(float),
+			.usage = Usage::UPLOAD,
+			.persistentMap = true
+		};
+
+		m_GfxDevice.create_buffer(checkpointBufferInfo, m_CheckpointBuffer, nullptr);
+	}
+
+	void RayTracingPass::begin_checkpoint_readback(const CommandList& cmdList, RenderGraph& renderGraph, const Camera& camera, Integrator integrator, size_t numAttachments) {
+		const Texture& rtAccumulationTex = renderGraph.get_attachment(CHECKPOINT_ATTACHMENTS[0])->texture;
+		const uint32_t width = rtAccumulationTex.info.width;
+		const uint32_t height = rtAccumulationTex.info.height;
+		const uint64_t imageSize = static_cast<uint64_t>(width) * height * 4 * sizeof(float);
+
+		update_checkpoint_buffer(imageSize * numAttachments);
+
+		// NOTE: Called after dispatching rays, so these hold this frame's
+		// results, which become the history of the next frame
+		for (size_t i = 0; i < numAttachments; ++i) {
+			const Texture& texture = renderGraph.get_attachment(CHECKPOINT_ATTACHMENTS[i])->texture;
+			assert(texture.info.format == Format::R32G32B32A32_FLOAT);
+
+			m_GfxDevice.copy_texture_to_buffer(texture, m_CheckpointBuffer, i * imageSize, cmdList);
+		}
+
+		m_PendingReadback = RenderCheckpoint{
+			.width = width,
+			.height = height,
+			.totalSamplesPerPixel = m_TotalSamplesPerPixel,
+			.integrator = static_cast<uint32_t>(integrator),
+			.rayBounces = m_RayBounces,
+			.useNormalMaps = m_UseNormalMaps,
+			.useSkybox = m_UseSkybox,
+			.useLightBVH = m_UseLightBVH,
+			.useReSTIR = m_UseReSTIR,
+			.useReSTIRBiasCorrection = m_UseReSTIRBiasCorrection,
+			.usePathGuiding = m_UsePathGuiding,
+			.cameraPosition = camera.get_position(),
+			.cameraOrientation = camera.get_orientation(),
+			.cameraVerticalFOV = camera.get_vertical_fov()
+		};
+
+		m_PendingReadback->images.resize(4 * static_cast<size_t>(width) * height * numAttachments);
+	}
+
+	void RayTracingPass::finish_checkpoint_readback() {
+		if (!m_PendingReadback.has_value()) {
+			return;
+		}
+
+		RenderCheckpoint checkpoint = std::move(*m_PendingReadback);
+		m_PendingReadback.reset();
+
+		// Accumulation was reset after the copy was recorded
+		if (checkpoint.totalSamplesPerPixel != m_TotalSamplesPerPixel) {
+			return;
+		}
+
+		assert_frames_complete();
+		const size_t numPixels = static_cast<size_t>(checkpoint.width) * checkpoint.height;
+		const float* images = static_cast<const float*>(m_CheckpointBuffer.mappedData);
+		std::memcpy(checkpoint.images.data(), images, checkpoint.images.size() * sizeof(float));
+
+		// NOTE: The film holds exactly the splats of the copied frames as well
+		if (checkpoint.integrator == static_cast<uint32_t>(Integrator::BIDIRECTIONAL)) {
+			const float* lightFilm = static_cast<const float*>(m_LightFilmBuffer.mappedData);
+			checkpoint.lightFilm.assign(lightFilm, lightFilm + 3 * numPixels);
+		}
+
+		if (!m_PendingReadbackIsCheckpoint) {
+			m_Capture = std::move(checkpoint);
+			return;
+		}
+
+		if (m_PendingReadbackIsCapture) {
+			m_Capture = checkpoint;
+		}
+
+		// Compression and disk I/O happen on the writer's thread
+		m_CheckpointWriter.write_async(m_CheckpointPath, std::move(checkpoint));
+	}
+
+	bool RayTracingPass::restore_checkpoint(const RenderCheckpoint& checkpoint, const CommandList& cmdList, RenderGraph& renderGraph, const Camera& camera) {
+		const Texture& rtAccumulationTex = renderGraph.get_attachment(CHECKPOINT_ATTACHMENTS[0])->texture;
+		const uint32_t width = rtAccumulationTex.info.width;
+		const uint32_t height = rtAccumulationTex.info.height;
+		const size_t numPixels = static_cast<size_t>(width) * height;
+		const uint64_t imageSize = numPixels * 4 * sizeof(float);
+		const bool isBidirectional = checkpoint.integrator == static_cast<uint32_t>(Integrator::BIDIRECTIONAL);
+
+		// NOTE: Accumulated samples are only valid for the exact same view
+		if (checkpoint.width != width || checkpoint.height != height ||
+			checkpoint.images.size() != 4 * numPixels * std::size(CHECKPOINT_ATTACHMENTS) ||
+			checkpoint.cameraPosition != camera.get_position() ||
+			checkpoint.cameraOrientation != camera.get_orientation() ||
+			checkpoint.cameraVerticalFOV != camera.get_vertical_fov()) {
+			return false;
+		}
+
+		if (checkpoint.integrator > static_cast<uint32_t>(Integrator::BIDIRECTIONAL) ||
+			(isBidirectional && (m_LightBVH.empty() || checkpoint.lightFilm.size() != 3 * numPixels))) {
+			return false;
+		}
+
+		// NOTE: The staging buffer and the film might still be in use by frames in flight
+		m_GfxDevice.wait_for_gpu();
+
+		update_checkpoint_buffer(imageSize * std::size(CHECKPOINT_ATTACHMENTS));
+		std::memcpy(m_CheckpointBuffer.mappedData, checkpoint.images.data(), checkpoint.images.size() * sizeof(float));
+
+		// The checkpointed frame's results are the history of the next frame
+		for (size_t i = 0; i < std::size(CHECKPOINT_ATTACHMENTS); ++i) {
+			const std::string historyName = std::string(CHECKPOINT_ATTACHMENTS[i]) + "History";
+			const Texture& texture = renderGraph.get_attachment(historyName)->texture;
+
+			m_GfxDevice.copy_buffer_to_texture(m_CheckpointBuffer, i * imageSize, texture, cmdList);
+		}
+
+		m_Integrator = static_cast<Integrator>(checkpoint.integrator);
+		m_LastIntegrator = m_Integrator;
+		m_RayBounces = checkpoint.rayBounces;
+		m_UseNormalMaps = checkpoint.useNormalMaps;
+		m_UseSkybox = checkpoint.useSkybox;
+		m_UseLightBVH = checkpoint.useLightBVH;
+		m_UseReSTIR = checkpoint.useReSTIR;
+		m_UseReSTIRBiasCorrection = checkpoint.useReSTIRBiasCorrection;
+		m_UsePathGuiding = checkpoint.usePathGuiding;
+
+		if (isBidirectional) {
+			update_light_film(width, height);
+			std::memcpy(m_LightFilmBuffer.mappedData, checkpoint.lightFilm.data(), checkpoint.lightFilm.size() * sizeof(float));
+		}
+
+		// NOTE: Also seeds the random numbers. The path guiding tree is not
+		// saved and retrains, and the samples per pixel may differ, so the
+		// render converges to the same result rather than taking the same
+		// samples as an uninterrupted one.
+		m_TotalSamplesPerPixel = checkpoint.totalSamplesPerPixel;
+		m_FramesSinceCheckpoint = 0;
+		m_PendingEdits.clear();
+		m_TileFiltersExact = false; // NOTE: The tiles never saw the restored samples
+		m_LastViewMatrix = camera.get_view_matrix();
+		m_LastProjMatrix = camera.get_proj_matrix();
 
-		lastViewMatrix = executeInfo.frameInfo->camera->get_view_matrix();
-		lastProjMatrix = executeInfo.frameInfo->camera->get_proj_matrix();
+		return true;
 	}
 }
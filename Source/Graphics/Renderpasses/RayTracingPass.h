@@ -2,26 +2,78 @@
 
 #include "Graphics/GraphicsDevice.h"
 #include "Graphics/RenderGraph.h"
+#include "Data/Camera.h"
+#include "Data/LightBVH.h"
+#include "Data/RenderCheckpoint.h"
 #include "Data/Scene.h"
+#include "Data/SDTree.h"
 #include "ECS/ECS.h"
 #include "Managers/MaterialManager.h"
 
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 
+#include <glm/glm.hpp>
+
 namespace SR {
+	// NOTE: The CPU writes and reads the mapped buffers of this pass in
+	// place, e.g. the instances, the tile states and the checkpoint staging.
+	// That is only safe because every submitted frame has completed before
+	// the next one is recorded, see GraphicsDevice::submit_command_lists(),
+	// which assert_frames_complete() checks wherever it is relied on.
 	class RayTracingPass {
 	public:
+		// NOTE: Matches the INTEGRATOR_* constants in shaders
+		enum class Integrator : uint32_t {
+			PATH_TRACING = 0,
+			BIDIRECTIONAL = 1 // NOTE: For caustics, requires emissive geometry
+		};
+
 		RayTracingPass(GraphicsDevice& gfxDevice);
 		~RayTracingPass() {}
 
 		void initialize(Scene& scene, MaterialManager& materialManager);
 		void build_acceleration_structures(const CommandList& cmdList);
 		void execute(PassExecuteInfo& executeInfo, Scene& scene);
+		void reset_accumulation();
+
+		// Writes the accumulation state to m_CheckpointPath once the current
+		// frame has completed
+		void request_checkpoint();
+
+		// Continues accumulating from a checkpoint, starting with the next
+		// frame, with the settings the checkpoint was taken with. NOTE: The
+		// camera has to be restored from the checkpoint first, otherwise the
+		// checkpoint is discarded.
+		void resume_from_checkpoint(RenderCheckpoint&& checkpoint);
+
+		// Reads back the accumulation once the current frame has completed,
+		// see take_capture()
+		void request_capture();
+
+		// The capture requested for a completed frame, if any. NOTE: Only the
+		// accumulation and the light film are filled in.
+		std::optional<RenderCheckpoint> take_capture();
+
+		inline uint32_t get_total_samples_per_pixel() const { return m_TotalSamplesPerPixel; } // NOTE: Accumulated before the next frame
 
 		uint32_t m_RayBounces = 8;
 		uint32_t m_SamplesPerPixel = 1;
+		uint32_t m_MaxHistoryLength = 256; // NOTE: Upper bound on samples per pixel carried over by reprojection
 		bool m_UseNormalMaps = true;
 		bool m_UseSkybox = true;
+		bool m_UseTemporalReprojection = true;
+		bool m_UseLightBVH = true; // NOTE: Next event estimation with light BVH sampling
+		bool m_UseReSTIR = true; // NOTE: Only used together with light BVH sampling
+		bool m_UseReSTIRBiasCorrection = true;
+		bool m_UsePathGuiding = true;
+		uint32_t m_GuidingTrainingIterations = 10; // NOTE: Iteration k trains for 2^k frames, the tree is frozen afterwards
+		Integrator m_Integrator = Integrator::PATH_TRACING;
+		std::filesystem::path m_CheckpointPath = "render_checkpoint.srck"; // NOTE: Relative to the working directory
+		uint32_t m_CheckpointInterval = 0; // NOTE: In frames, 0 disables periodic checkpoints
+		bool m_UseSparseResets = true; // NOTE: Scene edits only reset the tiles they affect
 
 	private:
 		struct PushConstant {
@@ -29,11 +81,29 @@ namespace SR {
 			uint32_t rtAccumulationIndex;
 			uint32_t rtImageIndex;
 			uint32_t sceneDescBufferIndex;
-			uint32_t rayBounces;
 			uint32_t samplesPerPixel;
 			uint32_t totalSamplesPerPixel;
-			uint32_t useNormalMaps;
-			uint32_t useSkybox;
+			uint32_t rtAccumulationHistoryIndex;
+			uint32_t rtHitInfoIndex;
+			uint32_t rtHitInfoHistoryIndex;
+			uint32_t reprojectHistory;
+			uint32_t maxHistoryLength;
+			float pixelSpreadAngle;
+			uint32_t lightBVHNodesIndex;
+			uint32_t lightTrianglesIndex;
+			uint32_t useLightBVH;
+			uint32_t reservoirsIndex;
+			uint32_t reservoirsHistoryIndex;
+			uint32_t surfaceIndex;
+			uint32_t surfaceHistoryIndex;
+			uint32_t useReSTIR;
+			uint32_t useReSTIRBiasCorrection;
+			uint32_t guidingTreeIndex;
+			uint32_t guidingDirectionalIndex;
+			uint32_t guidingTrainingIndex;
+			uint32_t guidingMode;
+			uint32_t lightFilmIndex;
+			uint32_t tileStatesIndex;
 		} m_PushConstant = {};
 
 		struct Object {
@@ -43,15 +113,88 @@ namespace SR {
 			uint64_t matIndexOverride = 0;
 		};
 
+		// NOTE: Matches the constants in specialization.glsl
+		struct Specialization {
+			uint32_t rayBounces = 8;
+			uint32_t useNormalMaps = 1;
+			uint32_t useSkybox = 1;
+			uint32_t hasEmissiveMaterials = 1;
+			uint32_t integrator = 0;
+		};
+
+		// The pipeline compiled for one combination of feature toggles,
+		// together with its shader binding tables
+		struct PipelineVariant {
+			RTPipeline pipeline = {};
+			ShaderBindingTable rayGenSBT = {};
+			ShaderBindingTable missSBT = {};
+			ShaderBindingTable hitSBT = {};
+		};
+
+		// NOTE: Matches the constants and TileState in tile_tracking.glsl
+		static constexpr uint32_t TILE_SIZE = 16;
+		static constexpr uint32_t TILE_FILTER_WORDS = 8;
+
+		struct TileState {
+			uint32_t reset = 0;
+			uint32_t filter[TILE_FILTER_WORDS] = {};
+		};
+
+		// The state of an entity when its instances were last written. NOTE:
+		// Its material is the one at `matIndexOverride`.
+		struct SceneEntity {
+			entity_id entity = ECS::INVALID_ENTITY;
+			glm::mat4 world = glm::mat4(1.0f);
+			bool hasMaterial = false;
+			bool hasLights = false; // NOTE: Contributes triangles to the light BVH
+			uint32_t matIndexOverride = 0;
+			uint32_t firstInstance = 0;
+			uint32_t numInstances = 0;
+			uint32_t firstLight = 0; // NOTE: Into the lights of the light BVH
+			uint32_t numLights = 0;
+		};
+
+		struct InstanceSource {
+			const Model* model = nullptr;
+			MeshPrimitive primitive = {};
+			uint32_t sceneEntityIndex = 0;
+		};
+
+		const PipelineVariant& get_pipeline_variant(const Specialization& specialization);
+		bool has_emissive_materials() const;
+		std::vector<LightTriangle> gather_light_triangles();
+		void upload_light_bvh();
+		bool refit_light_bvh(const CommandList& cmdList);
+		bool have_renderables_changed() const;
+		std::vector<uint32_t> apply_scene_edits(Scene& scene, const CommandList& cmdList, bool& lightsChanged);
+		void update_tile_states(uint32_t width, uint32_t height);
+		void update_tile_resets();
+		void assert_frames_complete() const;
+		void update_path_guiding();
+		void upload_guiding_tree();
+		void update_light_film(uint32_t width, uint32_t height);
+		void clear_light_film();
+		void update_checkpoint_buffer(uint64_t size);
+		void begin_checkpoint_readback(const CommandList& cmdList, RenderGraph& renderGraph, const Camera& camera, Integrator integrator, size_t numAttachments);
+		void finish_checkpoint_readback();
+		bool restore_checkpoint(const RenderCheckpoint& checkpoint, const CommandList& cmdList, RenderGraph& renderGraph, const Camera& camera);
+
+		// NOTE: The attachments that make up the accumulation state, each of
+		// them has a history counterpart with a "History" suffix
+		static constexpr const char* CHECKPOINT_ATTACHMENTS[] = {
+			"RTAccumulation",
+			"RTHitInfo",
+			"RTReservoirs",
+			"RTSurface"
+		};
+
 		GraphicsDevice& m_GfxDevice;
 
-		RTPipeline m_RTPipeline = {};
 		Shader m_RayGenShader = {};
 		Shader m_MissShader = {};
 		Shader m_ClosestHitShader = {};
-		ShaderBindingTable m_RayGenSBT = {};
-		ShaderBindingTable m_MissSBT = {};
-		ShaderBindingTable m_HitSBT = {};
+		std::unordered_map<uint32_t, PipelineVariant> m_PipelineVariants = {}; // NOTE: Compiled on first use
+		bool m_HasEmissiveMaterials = true;
 
 		std::vector<RTAS> m_BLASes = {};
 		RTAS m_TLAS = {};
@@ -59,7 +202,50 @@ namespace SR {
 		Buffer m_InstanceBuffer = {};
 		Buffer m_SceneDescBuffer = {};
 		std::vector<Object> m_SceneDescBufferData = {};
+		std::vector<SceneEntity> m_SceneEntities = {};
+		std::unordered_map<entity_id, uint32_t> m_SceneEntityIndexLUT = {};
+		uint32_t m_SceneVersion = 0; // NOTE: ECS version the scene entities are up to date with
+		uint32_t m_StructureVersion = 0; // NOTE: ECS structure version the set of scene entities was checked at
+		std::vector<entity_id> m_ChangedEntities = {}; // NOTE: Scratch buffer, kept between frames
+		std::vector<InstanceSource> m_InstanceSources = {};
+		MaterialManager* m_MaterialManager = nullptr;
+
+		Buffer m_TileStatesBuffer = {};
+		std::vector<uint32_t> m_TileResetEpochs = {}; // NOTE: Edit epoch at which each tile last started over
+		std::unordered_map<uint32_t, uint32_t> m_PendingEdits = {}; // NOTE: Instance ID to the epoch it was last edited in
+		uint32_t m_EditEpoch = 0;
+		bool m_TileFiltersExact = true; // NOTE: False once history has moved between tiles, e.g. by reprojection
+
+		LightBVH m_LightBVH = {};
+		Buffer m_LightBVHNodeBuffer = {};
+		Buffer m_LightTriangleBuffer = {};
+		Buffer m_LightBVHStagingBuffer = {}; // NOTE: Nodes followed by lights, for refits
+		std::vector<LightTriangle> m_LocalLightTriangles = {}; // NOTE: The lights of the light BVH in object space, so that moving them never pages in geometry
+		std::vector<LightTriangle> m_RefitLightTriangles = {}; // NOTE: Scratch buffer, kept between frames
+		std::vector<uint32_t> m_MovedLightEntities = {}; // NOTE: Scratch buffer, kept between frames
+
+		SDTree m_SDTree = {};
+		Buffer m_GuidingTreeBuffer = {};
+		Buffer m_GuidingDirectionalBuffer = {};
+		Buffer m_GuidingTrainingBuffer = {};
+		uint32_t m_GuidingIterationFrames = 0;
+
+		Buffer m_LightFilmBuffer = {}; // NOTE: Light tracing splats of the bidirectional integrator
+		Integrator m_LastIntegrator = Integrator::PATH_TRACING;
+
+		Buffer m_CheckpointBuffer = {}; // NOTE: Staging for both checkpoint readback and upload
+		CheckpointWriter m_CheckpointWriter = {};
+		std::optional<RenderCheckpoint> m_PendingReadback = {}; // NOTE: Everything but the GPU data, which is copied once the frame has completed
+		bool m_PendingReadbackIsCheckpoint = false;
+		bool m_PendingReadbackIsCapture = false;
+		std::optional<RenderCheckpoint> m_PendingResume = {};
+		std::optional<RenderCheckpoint> m_Capture = {};
+		bool m_CheckpointRequested = false;
+		bool m_CaptureRequested = false;
+		uint32_t m_FramesSinceCheckpoint = 0;
 
-		uint32_t m_TotalSamplesPerPixel = m_SamplesPerPixel;
+		uint32_t m_TotalSamplesPerPixel = 0; // NOTE: Samples accumulated before the current frame
+		glm::mat4 m_LastViewMatrix = { 1.0f };
+		glm::mat4 m_LastProjMatrix = { 1.0f };
 	};
 }
\ No newline at end of file
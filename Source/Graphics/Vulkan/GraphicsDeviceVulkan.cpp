@@ -135,6 +135,7 @@ namespace SR {
 		void create_destruction_handler();
 		void create_command_pool();
 		void create_sync_objects();
+		void create_query_pools();
 		void create_descriptors();
 
 		bool check_validation_layers();
@@ -159,6 +160,8 @@ namespace SR {
 
 		QueueFamilyIndices find_queue_families(VkPhysicalDevice device);
 		uint32_t find_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		bool has_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		void copy_buffer_immediate(VkBuffer src, VkBuffer dst, VkDeviceSize size);
 		SwapChainSupportInfo query_swapchain_support(VkPhysicalDevice device);
 
 		DestructionHandler m_DestructionHandler = {};
@@ -200,6 +203,11 @@ namespace SR {
 		std::vector<VkSemaphore> m_RenderFinishedSemaphores = {};
 		std::vector<VkFence> m_InFlightFences = {};
 
+		// GPU Timing
+		std::vector<VkQueryPool> m_TimestampQueryPools = {}; // NOTE: One per frame in flight
+		std::array<uint64_t, 2 * MAX_TIMESTAMP_QUERIES> m_TimestampResults = {}; // NOTE: Value and availability pairs
+		float m_TimestampPeriod = 0.0f; // NOTE: Nanoseconds per timestamp tick
+
 		VkSurfaceKHR m_Surface = nullptr;
 		VkDebugUtilsMessengerEXT m_DebugMessenger = nullptr;
 
@@ -214,6 +222,8 @@ namespace SR {
 			// Ray Tracing
 			VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
 			VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+			VK_KHR_RAY_QUERY_EXTENSION_NAME,
+			VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME,
 			VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
 		};
 
@@ -321,6 +331,7 @@ namespace SR {
 		create_destruction_handler();
 		create_command_pool();
 		create_sync_objects();
+		create_query_pools();
 		create_descriptors();
 	}
 
@@ -338,6 +349,7 @@ namespace SR {
 			m_DestructionHandler.semaphores.push_back({ m_ImageAvailableSemaphores[i], frameCount });
 			m_DestructionHandler.semaphores.push_back({ m_RenderFinishedSemaphores[i], frameCount });
 			m_DestructionHandler.fences.push_back({ m_InFlightFences[i], frameCount });
+			m_DestructionHandler.queryPools.push_back({ m_TimestampQueryPools[i], frameCount });
 		}
 
 		// Destroy descriptor objects
@@ -513,9 +525,19 @@ namespace SR {
 			.pNext = &accelerationFeatures
 		};
 
+		VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR,
+			.pNext = &rtPipelineFeatures
+		};
+
+		VkPhysicalDeviceShaderAtomicFloatFeaturesEXT atomicFloatFeatures = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT,
+			.pNext = &rayQueryFeatures
+		};
+
 		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures = {
 			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
-			.pNext = &rtPipelineFeatures
+			.pNext = &atomicFloatFeatures
 		};
 
 		VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {
@@ -553,6 +575,8 @@ namespace SR {
 		// Assert that device features are supported
 		assert(accelerationFeatures.accelerationStructure);
 		assert(rtPipelineFeatures.rayTracingPipeline);
+		assert(rayQueryFeatures.rayQuery);
+		assert(atomicFloatFeatures.shaderBufferFloat32AtomicAdd);
 
 		assert(descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing);
 		assert(descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind);
@@ -634,6 +658,26 @@ namespace SR {
 		}
 	}
 
+	void GraphicsDeviceVulkan::Impl::create_query_pools() {
+		VkPhysicalDeviceProperties deviceProperties = {};
+		vkGetPhysicalDeviceProperties(m_PhysicalDevice, &deviceProperties);
+		m_TimestampPeriod = deviceProperties.limits.timestampPeriod;
+
+		m_TimestampQueryPools.resize(FRAMES_IN_FLIGHT);
+
+		const VkQueryPoolCreateInfo queryPoolInfo = {
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = MAX_TIMESTAMP_QUERIES
+		};
+
+		for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+			if (vkCreateQueryPool(m_Device, &queryPoolInfo, nullptr, &m_TimestampQueryPools[i]) != VK_SUCCESS) {
+				throw std::runtime_error("VULKAN ERROR: Failed to create timestamp query pool!");
+			}
+		}
+	}
+
 	void GraphicsDeviceVulkan::Impl::create_descriptors() {
 		// Descriptor pool
 		const std::array<VkDescriptorPoolSize, 6> poolSizes = {
@@ -1014,6 +1058,60 @@ namespace SR {
 		throw std::runtime_error("VULKAN ERROR: Failed to find suitable memory type!");
 	}
 
+	bool GraphicsDeviceVulkan::Impl::has_memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// NOTE: Records the copy into a temporary command list and waits for it,
+	// so it is only meant for uploads outside of a frame
+	void GraphicsDeviceVulkan::Impl::copy_buffer_immediate(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
+		const VkCommandBufferAllocateInfo tempAllocInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = m_CommandPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+
+		VkCommandBuffer tempCommandBuffer;
+		vkAllocateCommandBuffers(m_Device, &tempAllocInfo, &tempCommandBuffer);
+
+		const VkCommandBufferBeginInfo tempBeginInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		};
+
+		vkBeginCommandBuffer(tempCommandBuffer, &tempBeginInfo);
+		{
+			const VkBufferCopy copyRegion = {
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = size
+			};
+
+			vkCmdCopyBuffer(tempCommandBuffer, src, dst, 1, &copyRegion);
+		}
+		vkEndCommandBuffer(tempCommandBuffer);
+
+		const VkSubmitInfo submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &tempCommandBuffer
+		};
+
+		vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, nullptr);
+		vkQueueWaitIdle(m_GraphicsQueue);
+		vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &tempCommandBuffer);
+	}
+
 	bool GraphicsDeviceVulkan::Impl::check_device_extension_support(VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -1365,26 +1463,46 @@ namespace SR {
 			break;
 		}
 
-		const uint32_t memoryType = m_Impl->find_memory_type(memRequirements.memoryTypeBits, memPropertyFlags);
 		const VkMemoryAllocateFlagsInfo allocFlagsInfo = {
 			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
 			.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
 		};
 
-		const VkMemoryAllocateInfo allocInfo = {
-			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-			.pNext = &allocFlagsInfo,
-			.allocationSize = memRequirements.size,
-			.memoryTypeIndex = memoryType
+		auto allocate_memory = [&](VkMemoryPropertyFlags propertyFlags) {
+			const VkMemoryAllocateInfo allocInfo = {
+				.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				.pNext = &allocFlagsInfo,
+				.allocationSize = memRequirements.size,
+				.memoryTypeIndex = m_Impl->find_memory_type(memRequirements.memoryTypeBits, propertyFlags)
+			};
+
+			return vkAllocateMemory(m_Impl->m_Device, &allocInfo, nullptr, &internalState->bufferMemory);
 		};
 
-		if (vkAllocateMemory(m_Impl->m_Device, &allocInfo, nullptr, &internalState->bufferMemory) != VK_SUCCESS) {
+		// NOTE: Device-local memory that the CPU can map (resizable BAR) is
+		// much faster for the GPU to access than system memory across the
+		// bus. It can be a small heap, so system memory is the fallback.
+		const VkMemoryPropertyFlags deviceLocalFlags = memPropertyFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		VkResult allocResult = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+		if (info.usage == Usage::UPLOAD && has_flag(info.miscFlags, MiscFlag::PREFER_DEVICE_LOCAL) &&
+			m_Impl->has_memory_type(memRequirements.memoryTypeBits, deviceLocalFlags)) {
+			allocResult = allocate_memory(deviceLocalFlags);
+		}
+
+		if (allocResult != VK_SUCCESS) {
+			allocResult = allocate_memory(memPropertyFlags);
+		}
+
+		if (allocResult != VK_SUCCESS) {
 			throw std::runtime_error("VULKAN ERROR: Failed to allocate buffer memory!");
 		}
 
 		vkBindBufferMemory(m_Impl->m_Device, internalState->buffer, internalState->bufferMemory, 0);
 
-		if (info.usage == Usage::DEFAULT) {
+		// NOTE: Without data there is nothing to upload, the contents are
+		// undefined either way
+		if (info.usage == Usage::DEFAULT && data != nullptr) {
 			// Create staging buffer
 			const BufferInfo stagingBufferInfo{
 				.size = info.size,
@@ -1395,51 +1513,7 @@ namespace SR {
 
 			Buffer stagingBuffer = {};
 			create_buffer(stagingBufferInfo, stagingBuffer, data);
-			auto internalStagingBuffer = m_Impl->to_internal(stagingBuffer);
-
-			// Temporary command list for copy
-			const VkCommandBufferAllocateInfo tempAllocInfo = {
-				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-				.commandPool = m_Impl->m_CommandPool,
-				.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				.commandBufferCount = 1
-			};
-
-			VkCommandBuffer tempCommandBuffer;
-			vkAllocateCommandBuffers(m_Impl->m_Device, &tempAllocInfo, &tempCommandBuffer);
-
-			const VkCommandBufferBeginInfo tempBeginInfo = {
-				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-			};
-
-			vkBeginCommandBuffer(tempCommandBuffer, &tempBeginInfo);
-			{
-				const VkBufferCopy copyRegion = {
-					.srcOffset = 0,
-					.dstOffset = 0,
-					.size = info.size
-				};
-
-				vkCmdCopyBuffer(
-					tempCommandBuffer,
-					internalStagingBuffer->buffer,
-					internalState->buffer,
-					1,
-					&copyRegion
-				);
-			}
-			vkEndCommandBuffer(tempCommandBuffer);
-
-			const VkSubmitInfo submitInfo = {
-				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &tempCommandBuffer
-			};
-
-			vkQueueSubmit(m_Impl->m_GraphicsQueue, 1, &submitInfo, nullptr);
-			vkQueueWaitIdle(m_Impl->m_GraphicsQueue);
-			vkFreeCommandBuffers(m_Impl->m_Device, m_Impl->m_CommandPool, 1, &tempCommandBuffer);
+			m_Impl->copy_buffer_immediate(m_Impl->to_internal(stagingBuffer)->buffer, internalState->buffer, info.size);
 		}
 		else if (info.usage == Usage::UPLOAD) {
 			vkMapMemory(m_Impl->m_Device, internalState->bufferMemory, 0, info.size, 0, &buffer.mappedData);
@@ -1470,6 +1544,14 @@ namespace SR {
 		}
 	}
 
+	void GraphicsDeviceVulkan::create_buffer_from_staging(const BufferInfo& info, Buffer& buffer, const Buffer& stagingBuffer) {
+		assert(info.usage == Usage::DEFAULT);
+		assert(stagingBuffer.info.usage == Usage::UPLOAD && stagingBuffer.info.size >= info.size);
+
+		create_buffer(info, buffer, nullptr);
+		m_Impl->copy_buffer_immediate(m_Impl->to_internal(stagingBuffer)->buffer, m_Impl->to_internal(buffer)->buffer, info.size);
+	}
+
 	void GraphicsDeviceVulkan::create_shader(ShaderStage stage, const std::string& path, Shader& shader) {
 		auto internalState = std::make_shared<Shader_Vulkan>();
 		internalState->destructionHandler = &m_Impl->m_DestructionHandler;
@@ -1508,6 +1590,8 @@ namespace SR {
 	}
 
 	void GraphicsDeviceVulkan::create_texture(const TextureInfo& info, Texture& texture, const SubresourceData* data) {
+		assert(info.mipLevels >= 1);
+
 		auto internalState = std::make_shared<Impl::Texture_Vulkan>();
 		internalState->destructionHandler = &m_Impl->m_DestructionHandler;
 
@@ -1537,7 +1621,7 @@ namespace SR {
 		imageInfo.extent.width = info.width;
 		imageInfo.extent.height = info.height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1; // Also hardcoded, look into it
+		imageInfo.mipLevels = info.mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = to_vk_format(info.format);
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -1611,7 +1695,7 @@ namespace SR {
 			.subresourceRange = {
 				.aspectMask = aspectFlag,
 				.baseMipLevel = 0,
-				.levelCount = 1,
+				.levelCount = info.mipLevels,
 				.baseArrayLayer = 0,
 				.layerCount = 1
 			}
@@ -1622,6 +1706,17 @@ namespace SR {
 		}
 
 		if (data != nullptr && data->data != nullptr) {
+			// NOTE: Only the top level is uploaded, the rest of the mip chain
+			// is generated on the GPU by successive linear blits
+			if (info.mipLevels > 1) {
+				VkFormatProperties formatProperties = {};
+				vkGetPhysicalDeviceFormatProperties(m_Impl->m_PhysicalDevice, imageInfo.format, &formatProperties);
+
+				if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+					throw std::runtime_error("VULKAN ERROR: Texture format does not support linear blitting for mip generation!");
+				}
+			}
+
 			Buffer stagingBuffer{};
 			BufferInfo stagingBufferInfo{};
 			stagingBufferInfo.size = static_cast<uint64_t>(data->rowPitch * info.height);
@@ -1657,8 +1752,10 @@ namespace SR {
 				transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
 				transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
 				transitionInfo.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+				transitionInfo.levelCount = info.mipLevels;
 
 				vk_helpers::transition_image_layout(transitionInfo, tempCommandBuffer);
+				transitionInfo.levelCount = 1;
 
 				VkBufferImageCopy copyRegion = {};
 				copyRegion.bufferOffset = 0;
@@ -1680,6 +1777,64 @@ namespace SR {
 					&copyRegion
 				);
 
+				// Mip chain generation
+				int32_t mipWidth = static_cast<int32_t>(info.width);
+				int32_t mipHeight = static_cast<int32_t>(info.height);
+
+				for (uint32_t mip = 1; mip < info.mipLevels; ++mip) {
+					transitionInfo.baseMipLevel = mip - 1;
+					transitionInfo.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+					transitionInfo.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					transitionInfo.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+					transitionInfo.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+					transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+					transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+
+					vk_helpers::transition_image_layout(transitionInfo, tempCommandBuffer);
+
+					const int32_t nextMipWidth = std::max(mipWidth / 2, 1);
+					const int32_t nextMipHeight = std::max(mipHeight / 2, 1);
+
+					VkImageBlit blit = {};
+					blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					blit.srcSubresource.mipLevel = mip - 1;
+					blit.srcSubresource.baseArrayLayer = 0;
+					blit.srcSubresource.layerCount = 1;
+					blit.srcOffsets[0] = { 0, 0, 0 };
+					blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+					blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					blit.dstSubresource.mipLevel = mip;
+					blit.dstSubresource.baseArrayLayer = 0;
+					blit.dstSubresource.layerCount = 1;
+					blit.dstOffsets[0] = { 0, 0, 0 };
+					blit.dstOffsets[1] = { nextMipWidth, nextMipHeight, 1 };
+
+					vkCmdBlitImage(
+						tempCommandBuffer,
+						internalState->image,
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						internalState->image,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						1,
+						&blit,
+						VK_FILTER_LINEAR
+					);
+
+					transitionInfo.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+					transitionInfo.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					transitionInfo.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+					transitionInfo.dstAccessMask = resourceState;
+					transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+					transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+					vk_helpers::transition_image_layout(transitionInfo, tempCommandBuffer);
+
+					mipWidth = nextMipWidth;
+					mipHeight = nextMipHeight;
+				}
+
+				// The last mip level was only ever written to
+				transitionInfo.baseMipLevel = info.mipLevels - 1;
 				transitionInfo.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 				transitionInfo.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				transitionInfo.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
@@ -1729,6 +1884,7 @@ namespace SR {
 				transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
 				transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
 				transitionInfo.aspectFlags = is_depth_format(info.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+				transitionInfo.levelCount = info.mipLevels;
 
 				vk_helpers::transition_image_layout(transitionInfo, tempCommandBuffer);
 			}
@@ -2147,6 +2303,27 @@ namespace SR {
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = {};
 
+		// Specialization constants
+		std::vector<VkSpecializationMapEntry> specializationEntries = {};
+		specializationEntries.reserve(info.specializationConstants.size());
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(info.specializationConstants.size()); ++i) {
+			specializationEntries.push_back({
+				.constantID = i,
+				.offset = i * static_cast<uint32_t>(sizeof(uint32_t)),
+				.size = sizeof(uint32_t)
+			});
+		}
+
+		const VkSpecializationInfo specializationInfo = {
+			.mapEntryCount = static_cast<uint32_t>(specializationEntries.size()),
+			.pMapEntries = specializationEntries.data(),
+			.dataSize = info.specializationConstants.size() * sizeof(uint32_t),
+			.pData = info.specializationConstants.data()
+		};
+
+		const VkSpecializationInfo* pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+
 		// Ray-generation shader
 		{
 			auto internalShader = to_internal(*info.rayGenShader);
@@ -2157,7 +2334,7 @@ namespace SR {
 			shaderStageInfo.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 			shaderStageInfo.module = internalShader->shaderModule;
 			shaderStageInfo.pName = "main";
-			shaderStageInfo.pSpecializationInfo = nullptr;
+			shaderStageInfo.pSpecializationInfo = pSpecializationInfo;
 		}
 
 		// Miss shader
@@ -2170,7 +2347,7 @@ namespace SR {
 			shaderStageInfo.stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 			shaderStageInfo.module = internalShader->shaderModule;
 			shaderStageInfo.pName = "main";
-			shaderStageInfo.pSpecializationInfo = nullptr;
+			shaderStageInfo.pSpecializationInfo = pSpecializationInfo;
 		}
 
 		// Closest-hit shader
@@ -2183,7 +2360,7 @@ namespace SR {
 			shaderStageInfo.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
 			shaderStageInfo.module = internalShader->shaderModule;
 			shaderStageInfo.pName = "main";
-			shaderStageInfo.pSpecializationInfo = nullptr;
+			shaderStageInfo.pSpecializationInfo = pSpecializationInfo;
 		}
 
 		// Shader groups
@@ -2616,7 +2793,8 @@ namespace SR {
 					.dstAccessMask = to_vk_resource_access(barrier.image.stateAfter),
 					.srcStageMask = to_vk_pipeline_stage(barrier.image.stateBefore),
 					.dstStageMask = to_vk_pipeline_stage(barrier.image.stateAfter),
-					.aspectFlags = aspectFlag
+					.aspectFlags = aspectFlag,
+					.levelCount = textureInfo.mipLevels
 				};
 
 				vk_helpers::transition_image_layout(transitionInfo, internalCmdList->commandBuffers[m_CurrentFrame]);
@@ -2668,6 +2846,17 @@ namespace SR {
 			throw std::runtime_error("VULKAN ERROR: Failed to begin recording of command buffer.");
 		}
 
+		// The first command list of a frame makes its timestamps unavailable
+		// again, so that stale ones are never read back
+		if (currCmdListIndex == 0) {
+			vkCmdResetQueryPool(
+				internalCmdList->commandBuffers[m_CurrentFrame],
+				m_Impl->m_TimestampQueryPools[m_CurrentFrame],
+				0,
+				MAX_TIMESTAMP_QUERIES
+			);
+		}
+
 		return cmdList;
 	}
 
@@ -2913,6 +3102,20 @@ namespace SR {
 
 		vkWaitForFences(m_Impl->m_Device, 1, &m_Impl->m_InFlightFences[m_CurrentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
 		vkResetFences(m_Impl->m_Device, 1, &m_Impl->m_InFlightFences[m_CurrentFrame]);
+		m_CompletedFrameCount = m_FrameCount;
+
+		// NOTE: Returns VK_NOT_READY when some queries weren't written this
+		// frame, which the availability values account for
+		vkGetQueryPoolResults(
+			m_Impl->m_Device,
+			m_Impl->m_TimestampQueryPools[m_CurrentFrame],
+			0,
+			MAX_TIMESTAMP_QUERIES,
+			sizeof(m_Impl->m_TimestampResults),
+			m_Impl->m_TimestampResults.data(),
+			2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+		);
 
 		m_CurrentFrame = (m_CurrentFrame + 1) % FRAMES_IN_FLIGHT;
 
@@ -2950,6 +3153,166 @@ namespace SR {
 		);
 	}
 
+	void GraphicsDeviceVulkan::copy_texture_to_buffer(const Texture& src, const Buffer& dst, uint64_t dstOffset, const CommandList& cmdList) {
+		auto internalCmdList = to_internal(cmdList);
+		auto internalTexture = m_Impl->to_internal(src);
+		auto internalBuffer = m_Impl->to_internal(dst);
+		const VkCommandBuffer commandBuffer = internalCmdList->commandBuffers[m_CurrentFrame];
+
+		// NOTE: Storage images stay in the general layout, so the transitions
+		// below only make the shader writes and the copy visible to each other
+		vk_helpers::ImageTransitionInfo transitionInfo = {
+			.image = internalTexture->image,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+			.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT
+		};
+
+		vk_helpers::transition_image_layout(transitionInfo, commandBuffer);
+
+		const VkBufferImageCopy copyRegion = {
+			.bufferOffset = dstOffset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { src.info.width, src.info.height, 1 }
+		};
+
+		vkCmdCopyImageToBuffer(commandBuffer, internalTexture->image, VK_IMAGE_LAYOUT_GENERAL, internalBuffer->buffer, 1, &copyRegion);
+
+		transitionInfo.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+		transitionInfo.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+		transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		vk_helpers::transition_image_layout(transitionInfo, commandBuffer);
+
+		// Make the copied data visible to the CPU once the frame's fence has
+		// been signaled
+		const VkMemoryBarrier2 hostBarrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+			.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+		};
+
+		const VkDependencyInfo dependencyInfo = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &hostBarrier
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+
+	void GraphicsDeviceVulkan::copy_buffer_to_texture(const Buffer& src, uint64_t srcOffset, const Texture& dst, const CommandList& cmdList) {
+		auto internalCmdList = to_internal(cmdList);
+		auto internalBuffer = m_Impl->to_internal(src);
+		auto internalTexture = m_Impl->to_internal(dst);
+		const VkCommandBuffer commandBuffer = internalCmdList->commandBuffers[m_CurrentFrame];
+
+		vk_helpers::ImageTransitionInfo transitionInfo = {
+			.image = internalTexture->image,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT
+		};
+
+		vk_helpers::transition_image_layout(transitionInfo, commandBuffer);
+
+		const VkBufferImageCopy copyRegion = {
+			.bufferOffset = srcOffset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.imageOffset = { 0, 0, 0 },
+			.imageExtent = { dst.info.width, dst.info.height, 1 }
+		};
+
+		vkCmdCopyBufferToImage(commandBuffer, internalBuffer->buffer, internalTexture->image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+
+		transitionInfo.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		transitionInfo.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+		transitionInfo.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		transitionInfo.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		vk_helpers::transition_image_layout(transitionInfo, commandBuffer);
+	}
+
+	void GraphicsDeviceVulkan::copy_buffer(const Buffer& src, uint64_t srcOffset, const Buffer& dst, uint64_t dstOffset, uint64_t size, const CommandList& cmdList) {
+		auto internalCmdList = to_internal(cmdList);
+		auto internalSrc = m_Impl->to_internal(src);
+		auto internalDst = m_Impl->to_internal(dst);
+		const VkCommandBuffer commandBuffer = internalCmdList->commandBuffers[m_CurrentFrame];
+
+		VkMemoryBarrier2 memoryBarrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT
+		};
+
+		const VkDependencyInfo dependencyInfo = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &memoryBarrier
+		};
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+		const VkBufferCopy copyRegion = {
+			.srcOffset = srcOffset,
+			.dstOffset = dstOffset,
+			.size = size
+		};
+
+		vkCmdCopyBuffer(commandBuffer, internalSrc->buffer, internalDst->buffer, 1, &copyRegion);
+
+		memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+
+	void GraphicsDeviceVulkan::write_timestamp(uint32_t queryIndex, const CommandList& cmdList) {
+		assert(queryIndex < MAX_TIMESTAMP_QUERIES);
+		auto internalCommandBuffer = to_internal(cmdList);
+
+		vkCmdWriteTimestamp(
+			internalCommandBuffer->commandBuffers[m_CurrentFrame],
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			m_Impl->m_TimestampQueryPools[m_CurrentFrame],
+			queryIndex
+		);
+	}
+
+	bool GraphicsDeviceVulkan::get_timestamp_elapsed(uint32_t beginQuery, uint32_t endQuery, double& milliseconds) {
+		assert(beginQuery < MAX_TIMESTAMP_QUERIES && endQuery < MAX_TIMESTAMP_QUERIES);
+		const auto& results = m_Impl->m_TimestampResults;
+
+		if (results[2 * beginQuery + 1] == 0 || results[2 * endQuery + 1] == 0) {
+			return false;
+		}
+
+		const uint64_t ticks = results[2 * endQuery] - results[2 * beginQuery];
+		milliseconds = static_cast<double>(ticks) * m_Impl->m_TimestampPeriod * 1e-6;
+
+		return true;
+	}
+
 	uint32_t GraphicsDeviceVulkan::get_descriptor_index(const Resource& resource, SubresourceType type) {
 		if (resource.type == Resource::Type::TEXTURE) {
 			auto internalTexture = (Impl::Texture_Vulkan*)resource.internalState.get();
@@ -2980,5 +3343,6 @@ namespace SR {
 
 	void GraphicsDeviceVulkan::wait_for_gpu() {
 		vkDeviceWaitIdle(m_Impl->m_Device);
+		m_CompletedFrameCount = m_FrameCount;
 	}
 }
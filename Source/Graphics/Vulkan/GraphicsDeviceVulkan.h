@@ -18,6 +18,7 @@ namespace SR {
 		void create_swapchain(const SwapChainInfo& info, SwapChain& swapChain) override;
 		void create_pipeline(const PipelineInfo& info, Pipeline& pipeline) override;
 		void create_buffer(const BufferInfo& info, Buffer& buffer, const void* data) override;
+		void create_buffer_from_staging(const BufferInfo& info, Buffer& buffer, const Buffer& stagingBuffer) override;
 		void create_shader(ShaderStage stage, const std::string& path, Shader& shader) override;
 		void create_texture(const TextureInfo& info, Texture& texture, const SubresourceData* data) override;
 		void create_sampler(const SamplerInfo& info, Sampler& sampler) override;
@@ -55,6 +56,15 @@ namespace SR {
 		void draw_indexed(uint32_t indexCount, uint32_t startIndex, uint32_t baseVertex, const CommandList& cmdList) override;
 		void draw_instanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance, const CommandList& cmdList) override;
 
+		// ----------------------------- Copy Commands -----------------------------
+		void copy_texture_to_buffer(const Texture& src, const Buffer& dst, uint64_t dstOffset, const CommandList& cmdList) override;
+		void copy_buffer_to_texture(const Buffer& src, uint64_t srcOffset, const Texture& dst, const CommandList& cmdList) override;
+		void copy_buffer(const Buffer& src, uint64_t srcOffset, const Buffer& dst, uint64_t dstOffset, uint64_t size, const CommandList& cmdList) override;
+
+		// ------------------------------ GPU Timing -------------------------------
+		void write_timestamp(uint32_t queryIndex, const CommandList& cmdList) override;
+		bool get_timestamp_elapsed(uint32_t beginQuery, uint32_t endQuery, double& milliseconds) override;
+
 		// ----------------------------- Miscellaneous -----------------------------
 		uint32_t get_descriptor_index(const Resource& resource, SubresourceType type) override;
 		uint64_t get_bda(const Buffer& buffer) override;
@@ -25,6 +25,7 @@ namespace SR {
 		std::deque<std::pair<VkImageView, uint64_t>> imageViews = {};
 		std::deque<std::pair<VkPipeline, uint64_t>> pipelines = {};
 		std::deque<std::pair<VkPipelineLayout, uint64_t>> pipelineLayouts = {};
+		std::deque<std::pair<VkQueryPool, uint64_t>> queryPools = {};
 		std::deque<std::pair<VkSampler, uint64_t>> samplers = {};
 		std::deque<std::pair<VkSemaphore, uint64_t>> semaphores = {};
 		std::deque<std::pair<VkShaderModule, uint64_t>> shaderModules = {};
@@ -104,6 +105,10 @@ namespace SR {
 				vkDestroyPipelineLayout(device, item, nullptr);
 				});
 
+			destroy(queryPools, [&](auto& item) {
+				vkDestroyQueryPool(device, item, nullptr);
+				});
+
 			destroy(swapchains, [&](auto& item) {
 				vkDestroySwapchainKHR(device, item, nullptr);
 				});
@@ -587,14 +592,16 @@ namespace SR {
 			VkPipelineStageFlags2 srcStageMask = VK_PIPELINE_STAGE_2_NONE;
 			VkPipelineStageFlags2 dstStageMask = VK_PIPELINE_STAGE_2_NONE;
 			VkImageAspectFlags aspectFlags = 0;
+			uint32_t baseMipLevel = 0;
+			uint32_t levelCount = 1;
 		};
 
 		void transition_image_layout(const ImageTransitionInfo& info, VkCommandBuffer commandBuffer) {
 			// TODO: Doesn't work for depth attachments
 			const VkImageSubresourceRange subresourceRange = {
 				.aspectMask = info.aspectFlags,
-				.baseMipLevel = 0,
-				.levelCount = 1,
+				.baseMipLevel = info.baseMipLevel,
+				.levelCount = info.levelCount,
 				.baseArrayLayer = 0,
 				.layerCount = 1
 			};
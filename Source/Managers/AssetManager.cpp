@@ -1,6 +1,7 @@
 #include "AssetManager.h"
 
 #include "Core/Platform.h"
+#include "Math/SRMath.h"
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -11,6 +12,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <cstring>
 #include <stdexcept>
 
 namespace SR {
@@ -34,6 +36,7 @@ namespace SR {
 		GLOBAL std::unordered_map<std::string, std::weak_ptr<AssetInternal>> g_Assets = {};
 		GLOBAL std::unordered_map<std::string, Font*> g_Fonts = {};
 		GLOBAL tinygltf::TinyGLTF g_GltfLoader = {};
+		GLOBAL std::unique_ptr<GeometryCache> g_GeometryCache = nullptr;
 
 		static const std::unordered_map<std::string, DataType> g_Types = {
 			{ "jpg", DataType::IMAGE },
@@ -48,6 +51,8 @@ namespace SR {
 		void initialize(GraphicsDevice& gfxDevice, MaterialManager& materialManager) {
 			g_GfxDevice = &gfxDevice;
 			g_MaterialManager = &materialManager;
+
+			g_GeometryCache = std::make_unique<GeometryCache>(std::filesystem::temp_directory_path());
 		}
 
 		void destroy() {
@@ -57,6 +62,7 @@ namespace SR {
 			}
 
 			g_Fonts.clear();
+			g_GeometryCache.reset();
 		}
 
 		std::unique_ptr<Model> create_plane(float width, float depth) {
@@ -124,6 +130,7 @@ namespace SR {
 
 			g_GfxDevice->create_buffer(vertexBufferInfo, model->vertexBuffer, model->vertices.data());
 			g_GfxDevice->create_buffer(indexBufferInfo, model->indexBuffer, model->indices.data());
+			g_GeometryCache->page_out(*model);
 
 			return model;
 		}
@@ -221,6 +228,7 @@ namespace SR {
 
 			g_GfxDevice->create_buffer(vertexBufferInfo, model->vertexBuffer, model->vertices.data());
 			g_GfxDevice->create_buffer(indexBufferInfo, model->indexBuffer, model->indices.data());
+			g_GeometryCache->page_out(*model);
 
 			return model;
 		}
@@ -249,6 +257,10 @@ namespace SR {
 				const TextureInfo textureInfo = {
 					.width = static_cast<uint32_t>(gltfImage.width),
 					.height = static_cast<uint32_t>(gltfImage.height),
+					.mipLevels = Math::get_mip_levels(
+						static_cast<uint32_t>(gltfImage.width),
+						static_cast<uint32_t>(gltfImage.height)
+					),
 					.format = Format::R8G8B8A8_UNORM,
 					.usage = Usage::DEFAULT,
 					.bindFlags = BindFlag::SHADER_RESOURCE
@@ -265,6 +277,11 @@ namespace SR {
 			uint32_t baseVertex = 0;
 			uint32_t baseIndex = 0;
 
+			// NOTE: Every primitive is written to the geometry cache as soon as
+			// it is converted, so only the largest one is ever held in memory
+			std::vector<ModelVertex> vertices = {};
+			std::vector<uint32_t> indices = {};
+
 			// Load model data
 			for (size_t i = 0; i < gltfModel.meshes.size(); ++i) {
 				tinygltf::Mesh gltfMesh = gltfModel.meshes[i];
@@ -332,7 +349,7 @@ namespace SR {
 					const tinygltf::Buffer& indexBuffer = gltfModel.buffers[indexBufferView.buffer];
 
 					assert(indicesAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
-					const uint16_t* indices = reinterpret_cast<const uint16_t*>(
+					const uint16_t* gltfIndices = reinterpret_cast<const uint16_t*>(
 						&indexBuffer.data[indexBufferView.byteOffset + indicesAccessor.byteOffset]
 						);
 
@@ -363,6 +380,9 @@ namespace SR {
 						materialIndex = g_MaterialManager->add_material(material);
 					}
 
+					vertices.clear();
+					indices.clear();
+
 					for (size_t k = 0; k < posAccessor.count; ++k) {
 						ModelVertex vertex{};
 
@@ -393,24 +413,28 @@ namespace SR {
 
 						vertex.matIndex = materialIndex;
 
-						asset->model.vertices.push_back(vertex);
+						vertices.push_back(vertex);
 					}
 
 					for (size_t k = 0; k < indicesAccessor.count; ++k) {
-						asset->model.indices.push_back(static_cast<uint32_t>(indices[k]));
+						indices.push_back(static_cast<uint32_t>(gltfIndices[k]));
 					}
 
 					primitive.numVertices = static_cast<uint32_t>(posAccessor.count);
 					primitive.numIndices = static_cast<uint32_t>(indicesAccessor.count);
+					g_GeometryCache->page_out(primitive, vertices.data(), indices.data());
 
 					baseVertex += static_cast<uint32_t>(posAccessor.count);
 					baseIndex += static_cast<uint32_t>(indicesAccessor.count);
 				}
 			}
 
+			vertices = {};
+			indices = {};
+
 			// Create related buffers for the GPU
 			const BufferInfo vertexBufferInfo = {
-				.size = asset->model.vertices.size() * sizeof(ModelVertex),
+				.size = baseVertex * sizeof(ModelVertex),
 				.stride = sizeof(ModelVertex),
 				.usage = Usage::DEFAULT,
 				.bindFlags = BindFlag::VERTEX_BUFFER,
@@ -418,15 +442,54 @@ namespace SR {
 			};
 
 			const BufferInfo indexBufferInfo = {
-				.size = asset->model.indices.size() * sizeof(uint32_t),
+				.size = baseIndex * sizeof(uint32_t),
 				.stride = sizeof(uint32_t),
 				.usage = Usage::DEFAULT,
 				.bindFlags = BindFlag::INDEX_BUFFER,
 				.miscFlags = MiscFlag::RAY_TRACING
 			};
 
-			g_GfxDevice->create_buffer(vertexBufferInfo, asset->model.vertexBuffer, asset->model.vertices.data());
-			g_GfxDevice->create_buffer(indexBufferInfo, asset->model.indexBuffer, asset->model.indices.data());
+			// The staging memory is filled straight from the mapped pages, one
+			// primitive at a time, which lets the cache evict them as it goes
+			const BufferInfo vertexStagingBufferInfo = {
+				.size = vertexBufferInfo.size,
+				.stride = sizeof(ModelVertex),
+				.usage = Usage::UPLOAD,
+				.persistentMap = true
+			};
+
+			const BufferInfo indexStagingBufferInfo = {
+				.size = indexBufferInfo.size,
+				.stride = sizeof(uint32_t),
+				.usage = Usage::UPLOAD,
+				.persistentMap = true
+			};
+
+			Buffer vertexStagingBuffer = {};
+			Buffer indexStagingBuffer = {};
+			g_GfxDevice->create_buffer(vertexStagingBufferInfo, vertexStagingBuffer, nullptr);
+			g_GfxDevice->create_buffer(indexStagingBufferInfo, indexStagingBuffer, nullptr);
+
+			for (const Mesh& mesh : asset->model.meshes) {
+				for (const MeshPrimitive& primitive : mesh.primitives) {
+					const GeometryCache::PageView page = g_GeometryCache->acquire(primitive.geometryPage);
+
+					std::memcpy(
+						static_cast<ModelVertex*>(vertexStagingBuffer.mappedData) + primitive.baseVertex,
+						page.get_vertices(),
+						sizeof(ModelVertex) * page.get_num_vertices()
+					);
+
+					std::memcpy(
+						static_cast<uint32_t*>(indexStagingBuffer.mappedData) + primitive.baseIndex,
+						page.get_indices(),
+						sizeof(uint32_t) * page.get_num_indices()
+					);
+				}
+			}
+
+			g_GfxDevice->create_buffer_from_staging(vertexBufferInfo, asset->model.vertexBuffer, vertexStagingBuffer);
+			g_GfxDevice->create_buffer_from_staging(indexBufferInfo, asset->model.indexBuffer, indexStagingBuffer);
 
 			outAsset.internalState = asset;
 		}
@@ -448,6 +511,7 @@ namespace SR {
 			TextureInfo textureInfo{};
 			textureInfo.width = static_cast<uint32_t>(width);
 			textureInfo.height = static_cast<uint32_t>(height);
+			textureInfo.mipLevels = Math::get_mip_levels(textureInfo.width, textureInfo.height);
 			textureInfo.format = Format::R8G8B8A8_UNORM;
 			textureInfo.bindFlags = BindFlag::SHADER_RESOURCE;
 
@@ -499,6 +563,11 @@ namespace SR {
 			}
 		}
 
+		GeometryCache& get_geometry_cache() {
+			assert(g_GeometryCache != nullptr);
+			return *g_GeometryCache;
+		}
+
 		Font* load_font_from_file(const std::string& path, int ptSize) {
 			assert(g_GfxDevice != nullptr);
 			assert(ptSize > 0);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Data/Font.h"
+#include "Data/GeometryCache.h"
 #include "Data/Model.h"
 #include "Graphics/GraphicsDevice.h"
 #include "Managers/MaterialManager.h"
@@ -26,6 +27,7 @@ namespace SR {
 		std::unique_ptr<Model> create_sphere(float radius, int latitudeSplits, int longitudeSplits, const Material* material = nullptr);
 
 		void load_from_file(Asset& outAsset, const std::string& path);
+		GeometryCache& get_geometry_cache();
 		Font* load_font_from_file(const std::string& path, int ptSize);
 	}
 }
\ No newline at end of file
@@ -22,7 +22,7 @@ namespace SR {
 			.stride = sizeof(Material),
 			.usage = Usage::UPLOAD,
 			.bindFlags = BindFlag::SHADER_RESOURCE,
-			.miscFlags = MiscFlag::BUFFER_STRUCTURED,
+			.miscFlags = MiscFlag::BUFFER_STRUCTURED | MiscFlag::PREFER_DEVICE_LOCAL,
 			.persistentMap = true
 		};
 
@@ -36,6 +36,12 @@ namespace SR {
 		return m_Materials.size() - 1;
 	}
 
+	void MaterialManager::update_material(uint32_t index, const Material& material) {
+		assert(index < m_Materials.size());
+
+		m_Materials[index] = material;
+	}
+
 	void MaterialManager::update_gpu_buffer() {
 		std::memcpy(m_MaterialBuffer.mappedData, m_Materials.data(), m_Materials.size() * sizeof(Material));
 	}
@@ -15,6 +15,7 @@ namespace SR {
 		~MaterialManager() {}
 
 		uint32_t add_material(const Material& material);
+		void update_material(uint32_t index, const Material& material); // NOTE: Call update_gpu_buffer() afterwards
 		void update_gpu_buffer();
 
 		inline const std::vector<Material>& get_materials() const { return m_Materials; }
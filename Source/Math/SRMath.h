@@ -9,4 +9,17 @@ namespace SR::Math {
 		//return ((value + alignment - 1) / alignment) * alignment;
 		return (value + alignment - 1) & ~(alignment - 1);
 	}
+
+	// Number of levels in a full mip chain, down to and including 1x1
+	inline uint32_t get_mip_levels(uint32_t width, uint32_t height) {
+		uint32_t levels = 1;
+		uint32_t maxDim = width > height ? width : height;
+
+		while (maxDim > 1) {
+			maxDim >>= 1;
+			++levels;
+		}
+
+		return levels;
+	}
 }
\ No newline at end of file
@@ -2,8 +2,13 @@
 #include "Core/Platform.h"
 #include "Core/Window.h"
 #include "Data/Camera.h"
+#include "Data/RenderCheckpoint.h"
+#include "Data/RenderJob.h"
 #include "Data/Scene.h"
 #include "ECS/ECS.h"
+#include "ECS/SystemScheduler.h"
+#include "ECS/TransformHierarchy.h"
+#include "Graphics/FrameGovernor.h"
 #include "Graphics/RenderGraph.h"
 #include "Graphics/Renderpasses/FullscreenTriPass.h"
 #include "Graphics/Renderpasses/RayTracingPass.h"
@@ -13,12 +18,15 @@
 #include "Managers/AssetManager.h"
 #include "Managers/MaterialManager.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <format>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 #include <Windows.h>
 
@@ -35,6 +43,9 @@ struct PerFrameData {
 	glm::mat4 invViewProjection = { 1.0f };
 	glm::vec3 cameraPosition = { 0.0f, 0.0f, 0.0f };
 	uint32_t pad1 = 0;
+	glm::mat4 prevViewProjection = { 1.0f };
+	glm::vec3 prevCameraPosition = { 0.0f, 0.0f, 0.0f };
+	uint32_t pad2 = 0;
 };
 
 GLOBAL GraphicsAPI g_API = GraphicsAPI::VULKAN;
@@ -61,6 +72,7 @@ GLOBAL uint64_t g_LastFrameCount = 0;
 GLOBAL uint64_t g_CurrentFPS = 0;
 GLOBAL std::chrono::high_resolution_clock::time_point g_FPSStartTime = {};
 GLOBAL Scene* g_ActiveScene = nullptr;
+GLOBAL std::unique_ptr<ECS::SystemScheduler> g_SystemScheduler = {};
 
 // Resources
 GLOBAL Texture g_DefaultAlbedoMap = {};
@@ -72,6 +84,33 @@ GLOBAL Asset g_SponzaModel = {};
 GLOBAL std::unique_ptr<Model> g_FlatPlaneModel = {};
 GLOBAL std::unique_ptr<Model> g_Sphere = {};
 
+// Frame time governor
+GLOBAL FrameGovernor g_FrameGovernor = {};
+GLOBAL bool g_UseFrameGovernor = false;
+GLOBAL double g_RTFrameTime = 0.0; // NOTE: GPU time of the ray tracing pass, in milliseconds
+GLOBAL float g_RTResolutionScale = 1.0f;
+GLOBAL uint32_t g_RTViewportWidth = 0; // NOTE: Display size, ray tracing happens at this size times the resolution scale
+GLOBAL uint32_t g_RTViewportHeight = 0;
+
+// Render checkpoints
+GLOBAL bool g_ResumeRequested = false;
+constexpr uint32_t CHECKPOINT_INTERVAL = 600; // NOTE: In frames
+
+// Render jobs
+GLOBAL std::unique_ptr<RenderJob> g_RenderJob = {};
+constexpr uint32_t RENDER_JOB_SAMPLES = 256; // NOTE: Per pixel, for every view
+constexpr uint32_t RENDER_JOB_TURNTABLE_VIEWS = 36;
+constexpr const char* RENDER_JOB_PATH = "render_job.txt"; // NOTE: See RenderJob::read_views()
+constexpr const char* RENDER_JOB_OUTPUT_DIRECTORY = "render_job_output";
+
+// Look development, edits an entity while the render keeps accumulating
+GLOBAL entity_id g_LookDevEntity = ECS::INVALID_ENTITY; // NOTE: INVALID_ENTITY if the scene has none
+GLOBAL float g_LookDevRotation = 0.0f; // NOTE: In degrees, around the y-axis
+
+// NOTE: Timestamp query indices
+constexpr uint32_t RT_BEGIN_TIMESTAMP = 0;
+constexpr uint32_t RT_END_TIMESTAMP = 1;
+
 // --------------------------- Function Declarations ---------------------------
 INTERNAL void init_window();
 INTERNAL void init_gfx();
@@ -80,6 +119,11 @@ INTERNAL void init_render_graph();
 INTERNAL void create_cornell_scene();
 INTERNAL void create_sponza_scene();
 INTERNAL void on_update(FrameInfo& frameInfo);
+INTERNAL void update_frame_governor();
+INTERNAL void resume_from_checkpoint(Camera& camera);
+INTERNAL void start_render_job(std::vector<RenderJobView>&& views);
+INTERNAL void update_render_job(Camera& camera);
+INTERNAL void resize_rt_attachments();
 INTERNAL void resize_callback(int width, int height);
 INTERNAL void mouse_position_callback(int x, int y);
 INTERNAL void mouse_button_callback(MouseButton button, ButtonAction action, ButtonMods mods);
@@ -140,6 +184,7 @@ int APIENTRY wWinMain(
 
 		g_RenderGraph->execute(g_SwapChain, cmdList, g_FrameInfo);
 		g_GfxDevice->submit_command_lists(g_SwapChain);
+		update_frame_governor();
 
 		if (firstFrame) {
 			g_Window->show();
@@ -149,6 +194,7 @@ int APIENTRY wWinMain(
 	g_GfxDevice->wait_for_gpu();
 
 	// Shutdown
+	g_SystemScheduler.reset();
 	ECS::destroy();
 	AssetManager::destroy();
 	#if defined(_DEBUG)
@@ -218,6 +264,7 @@ INTERNAL void init_gfx() {
 		.stride = sizeof(PerFrameData),
 		.usage = Usage::UPLOAD,
 		.bindFlags = BindFlag::UNIFORM_BUFFER,
+		.miscFlags = MiscFlag::PREFER_DEVICE_LOCAL,
 		.persistentMap = true
 	};
 
@@ -257,6 +304,16 @@ INTERNAL void init_objects() {
 	g_MaterialManager = std::make_unique<MaterialManager>(*g_GfxDevice, 1024);
 	AssetManager::initialize(*g_GfxDevice, *g_MaterialManager);
 	ECS::initialize();
+	g_SystemScheduler = std::make_unique<ECS::SystemScheduler>();
+
+	// NOTE: Added last, so that it waits for the systems that move entities
+	ECS::System* worldTransformSystem = g_SystemScheduler->add_system("WorldTransforms");
+	worldTransformSystem->add_read<Transform>();
+	worldTransformSystem->add_read<Parent>();
+	worldTransformSystem->add_write<WorldTransform>();
+	worldTransformSystem->set_execute_callback([](float dt) {
+		ECS::update_world_transforms();
+	});
 
 	g_Camera = std::make_unique<Camera>(
 		glm::vec3(0.0f, 3.0f, -4.0f),
@@ -279,15 +336,26 @@ INTERNAL void init_render_graph() {
 	const uint32_t uHeight = static_cast<uint32_t>(g_Window->get_client_height());
 	const uint32_t uRTWidth = static_cast<uint32_t>(uWidth * 0.6f - 2 * UIPass::UI_PADDING);
 	const uint32_t uRTHeight = static_cast<uint32_t>(uRTWidth * (9.0f / 16));
+	g_RTViewportWidth = uRTWidth;
+	g_RTViewportHeight = uRTHeight;
 
 	g_RenderGraph = std::make_unique<RenderGraph>(*g_GfxDevice);
 
 	auto rtPass = g_RenderGraph->add_pass("RayTracingPass");
 	rtPass->add_output_attachment("RTOutput", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R8G8B8A8_UNORM });
 	rtPass->add_output_attachment("RTAccumulation", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTAccumulationHistory", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTHitInfo", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTHitInfoHistory", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTReservoirs", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTReservoirsHistory", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTSurface", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
+	rtPass->add_output_attachment("RTSurfaceHistory", AttachmentInfo{ uRTWidth, uRTHeight, AttachmentType::RW_TEXTURE, Format::R32G32B32A32_FLOAT });
 	rtPass->set_execute_callback([&](PassExecuteInfo& executeInfo) {
 		if (g_ActiveScene != nullptr) {
+			g_GfxDevice->write_timestamp(RT_BEGIN_TIMESTAMP, *executeInfo.cmdList);
 			g_RayTracingPass->execute(executeInfo, *g_ActiveScene);
+			g_GfxDevice->write_timestamp(RT_END_TIMESTAMP, *executeInfo.cmdList);
 		}
 	});
 
@@ -348,6 +416,9 @@ INTERNAL void create_cornell_scene() {
 		.roughness = 0.3f,
 		});
 
+	g_LookDevEntity = lucy;
+	g_LookDevRotation = 120.0f;
+
 	const entity_id floor = scene->add_entity("Floor");
 	ECS::add_component<Renderable>(floor, Renderable{ g_PlaneModel.get_model() });
 	ECS::get_component<Transform>(floor)->position = { 0.0f, 0.0f, 0.0f };
@@ -395,6 +466,7 @@ INTERNAL void create_cornell_scene() {
 		});
 
 	g_RayTracingPass->m_UseSkybox = false;
+	ECS::update_world_transforms();
 	g_RayTracingPass->initialize(*scene, *g_MaterialManager);
 }
 
@@ -417,7 +489,10 @@ INTERNAL void create_sponza_scene() {
 	ECS::add_component<Renderable>(sponza, Renderable{ g_SponzaModel.get_model() });
 	ECS::get_component<Transform>(sponza)->position = { 0.0f, 0.0f, 0.0f };
 
+	g_LookDevEntity = ECS::INVALID_ENTITY;
+
 	g_RayTracingPass->m_UseSkybox = true;
+	ECS::update_world_transforms();
 	g_RayTracingPass->initialize(*scene, *g_MaterialManager);
 }
 
@@ -425,6 +500,14 @@ INTERNAL void on_update(FrameInfo& frameInfo) {
 	// Input
 	Input::update();
 	Camera& camera = *frameInfo.camera;
+
+	// NOTE: Done before any camera movement, so that the camera matches the
+	// checkpoint when the frame is rendered
+	if (g_ResumeRequested) {
+		resume_from_checkpoint(camera);
+		g_ResumeRequested = false;
+	}
+
 	const float cameraMoveSpeed = 5.0f;
 	const float mouseSensitivity = 0.001f;
 
@@ -469,9 +552,17 @@ INTERNAL void on_update(FrameInfo& frameInfo) {
 		newPosition.y -= cameraMoveSpeed * frameInfo.dt;
 	}
 	camera.set_position(newPosition);
+
+	// NOTE: Overrides the camera controls while a job is running
+	update_render_job(camera);
+
 	camera.set_aspect_ratio(16.0f / 9);
 	camera.update();
 
+	// Keep the previous frame's camera around for temporal reprojection
+	g_PerFrameData.prevViewProjection = g_PerFrameData.projectionMatrix * g_PerFrameData.viewMatrix;
+	g_PerFrameData.prevCameraPosition = g_PerFrameData.cameraPosition;
+
 	g_PerFrameData.projectionMatrix = camera.get_proj_matrix();
 	g_PerFrameData.viewMatrix = camera.get_view_matrix();
 	g_PerFrameData.invViewProjection = camera.get_inv_view_proj_matrix();
@@ -522,12 +613,95 @@ INTERNAL void on_update(FrameInfo& frameInfo) {
 			g_UIPass->widget_text("Path Tracing:");
 			g_UIPass->widget_checkbox("Use normal maps", &g_RayTracingPass->m_UseNormalMaps);
 			g_UIPass->widget_checkbox("Use skybox", &g_RayTracingPass->m_UseSkybox);
+			g_UIPass->widget_checkbox("Temporal reprojection", &g_RayTracingPass->m_UseTemporalReprojection);
+			g_UIPass->widget_checkbox("Light BVH sampling", &g_RayTracingPass->m_UseLightBVH);
+			g_UIPass->widget_checkbox("ReSTIR direct lighting", &g_RayTracingPass->m_UseReSTIR);
+			g_UIPass->widget_checkbox("ReSTIR bias correction", &g_RayTracingPass->m_UseReSTIRBiasCorrection);
+			g_UIPass->widget_checkbox("Path guiding", &g_RayTracingPass->m_UsePathGuiding);
+
+			bool useBidirectional = g_RayTracingPass->m_Integrator == RayTracingPass::Integrator::BIDIRECTIONAL;
+			if (g_UIPass->widget_checkbox("Bidirectional (caustics)", &useBidirectional)) {
+				g_RayTracingPass->m_Integrator = useBidirectional ?
+					RayTracingPass::Integrator::BIDIRECTIONAL :
+					RayTracingPass::Integrator::PATH_TRACING;
+			}
+
+			if (g_UIPass->widget_checkbox("Frame time governor", &g_UseFrameGovernor)) {
+				g_FrameGovernor.reset();
+			}
+			g_UIPass->widget_checkbox("Governor: adjust bounces", &g_FrameGovernor.m_AdjustRayBounces);
+			g_UIPass->widget_checkbox("Governor: adjust resolution", &g_FrameGovernor.m_AdjustResolutionScale);
+
+			LOCAL_PERSIST bool usePeriodicCheckpoints = false;
+			if (g_UIPass->widget_checkbox("Periodic checkpoints", &usePeriodicCheckpoints)) {
+				g_RayTracingPass->m_CheckpointInterval = usePeriodicCheckpoints ? CHECKPOINT_INTERVAL : 0;
+			}
+			if (g_UIPass->widget_button("Save checkpoint")) {
+				g_RayTracingPass->request_checkpoint();
+			}
+			if (g_UIPass->widget_button("Resume checkpoint")) {
+				g_ResumeRequested = true;
+			}
+
+			g_UIPass->widget_checkbox("Sparse edit resets", &g_RayTracingPass->m_UseSparseResets);
+
+			// NOTE: Components are only accessed mutably when they change, the
+			// ray tracing pass picks up exactly those changes
+			if (g_LookDevEntity != ECS::INVALID_ENTITY) {
+				float roughness = ECS::read_component<Material>(g_LookDevEntity)->roughness;
 
-			LOCAL_PERSIST float fov = g_Camera->get_vertical_fov();
+				if (g_UIPass->widget_slider_float("Roughness", &roughness, 0.0f, 1.0f)) {
+					ECS::get_component<Material>(g_LookDevEntity)->roughness = roughness;
+				}
+				if (g_UIPass->widget_slider_float("Rotation", &g_LookDevRotation, 0.0f, 360.0f)) {
+					ECS::get_component<Transform>(g_LookDevEntity)->orientation = glm::angleAxis(glm::radians(g_LookDevRotation), glm::vec3(0.0f, 1.0f, 0.0f));
+				}
+			}
+
+			if (g_RenderJob == nullptr) {
+				if (g_UIPass->widget_button("Render turntable")) {
+					start_render_job(RenderJob::make_turntable(
+						glm::vec3(0.0f, 3.0f, 0.0f),
+						4.0f,
+						0.0f,
+						g_Camera->get_vertical_fov(),
+						RENDER_JOB_TURNTABLE_VIEWS
+					));
+				}
+				if (g_UIPass->widget_button("Run render job")) {
+					std::vector<RenderJobView> views = {};
+
+					if (RenderJob::read_views(RENDER_JOB_PATH, views)) {
+						start_render_job(std::move(views));
+					}
+					else {
+						std::cerr << "Failed to read render job from " << RENDER_JOB_PATH << '\n';
+					}
+				}
+			}
+			else {
+				g_UIPass->widget_text(std::format(
+					"Render job: view {}/{}",
+					g_RenderJob->get_current_view_index() + 1,
+					g_RenderJob->get_num_views()
+				));
+				if (g_UIPass->widget_button("Cancel render job")) {
+					g_RenderJob.reset();
+				}
+			}
+
+			float fov = g_Camera->get_vertical_fov();
 			if (g_UIPass->widget_slider_float("FOV", &fov, 10.0f, 110.0f)) {
 				g_Camera->set_vertical_fov(fov);
 			}
 			g_UIPass->widget_text(std::format("FPS: {}", g_CurrentFPS));
+			g_UIPass->widget_text(std::format("Ray tracing: {:.2f} ms", g_RTFrameTime));
+			g_UIPass->widget_text(std::format(
+				"SPP: {}, bounces: {}, scale: {:.2f}",
+				g_RayTracingPass->m_SamplesPerPixel,
+				g_RayTracingPass->m_RayBounces,
+				g_RTResolutionScale
+			));
 
 			if (g_UIPass->widget_button("Reload")) {
 				std::cout << "Reload\n";
@@ -539,7 +713,7 @@ INTERNAL void on_update(FrameInfo& frameInfo) {
 		{
 			auto* rtOutputAttachment = g_RenderGraph->get_attachment("RTOutput");
 			const Texture& rtOutputTex = rtOutputAttachment->texture;
-			g_UIPass->widget_image(rtOutputTex, rtOutputTex.info.width, rtOutputTex.info.height);
+			g_UIPass->widget_image(rtOutputTex, g_RTViewportWidth, g_RTViewportHeight);
 		}
 		g_UIPass->end_panel();
 
@@ -549,6 +723,10 @@ INTERNAL void on_update(FrameInfo& frameInfo) {
 		g_UIPass->end_panel();
 	}
 	g_UIPass->end_split();
+
+	// Simulation and world transforms, done after the UI edits and before
+	// rendering reads the components
+	g_SystemScheduler->run(frameInfo.dt);
 }
 
 INTERNAL void resize_callback(int width, int height) {
@@ -560,33 +738,140 @@ INTERNAL void resize_callback(int width, int height) {
 		.vsync = true
 	};
 
-	width = static_cast<int>(width * 0.6f - 2 * UIPass::UI_PADDING);
-	height = static_cast<int>(width * (9.0f / 16));
 	// Recreate swapchain
 	g_GfxDevice->create_swapchain(swapChainInfo, g_SwapChain);
 
+	g_RTViewportWidth = static_cast<uint32_t>(width * 0.6f - 2 * UIPass::UI_PADDING);
+	g_RTViewportHeight = static_cast<uint32_t>(g_RTViewportWidth * (9.0f / 16));
+	resize_rt_attachments();
+}
+
+INTERNAL void update_frame_governor() {
+	// NOTE: The GPU time is measured instead of the CPU frame time, since
+	// vsync hides how much of the frame budget is actually spent
+	if (!g_GfxDevice->get_timestamp_elapsed(RT_BEGIN_TIMESTAMP, RT_END_TIMESTAMP, g_RTFrameTime) ||
+		!g_UseFrameGovernor) {
+		return;
+	}
+
+	FrameGovernor::Settings settings = {
+		.samplesPerPixel = g_RayTracingPass->m_SamplesPerPixel,
+		.rayBounces = g_RayTracingPass->m_RayBounces,
+		.resolutionScale = g_RTResolutionScale
+	};
+
+	if (!g_FrameGovernor.update(g_RTFrameTime, settings)) {
+		return;
+	}
+
+	// NOTE: The accumulation stores its sample count, so samples per pixel
+	// can change freely. Paths of a different length converge to a different
+	// image however, so the accumulation has to start over.
+	g_RayTracingPass->m_SamplesPerPixel = settings.samplesPerPixel;
+
+	if (settings.rayBounces != g_RayTracingPass->m_RayBounces) {
+		g_RayTracingPass->m_RayBounces = settings.rayBounces;
+		g_RayTracingPass->reset_accumulation();
+	}
+
+	if (settings.resolutionScale != g_RTResolutionScale) {
+		g_RTResolutionScale = settings.resolutionScale;
+		resize_rt_attachments();
+	}
+}
+
+INTERNAL void resume_from_checkpoint(Camera& camera) {
+	RenderCheckpoint checkpoint = {};
+
+	if (!RenderCheckpoint::read(g_RayTracingPass->m_CheckpointPath, checkpoint)) {
+		std::cerr << "Failed to read render checkpoint\n";
+		return;
+	}
+
+	camera.set_position(checkpoint.cameraPosition);
+	camera.set_orientation(checkpoint.cameraOrientation);
+	camera.set_vertical_fov(checkpoint.cameraVerticalFOV);
+
+	g_RayTracingPass->resume_from_checkpoint(std::move(checkpoint));
+}
+
+INTERNAL void start_render_job(std::vector<RenderJobView>&& views) {
+	g_RenderJob = std::make_unique<RenderJob>(std::move(views), RENDER_JOB_SAMPLES, RENDER_JOB_OUTPUT_DIRECTORY);
+	g_RayTracingPass->reset_accumulation();
+}
+
+INTERNAL void update_render_job(Camera& camera) {
+	if (g_RenderJob == nullptr) {
+		return;
+	}
+
+	// The capture of the previous frame completes the current view. NOTE:
+	// Captures of any other view, e.g. from a cancelled job, are dropped.
+	std::optional<RenderCheckpoint> capture = g_RayTracingPass->take_capture();
+	const RenderJobView& currentView = g_RenderJob->get_current_view();
+
+	if (capture.has_value() &&
+		capture->cameraPosition == currentView.position &&
+		capture->cameraOrientation == currentView.orientation &&
+		capture->cameraVerticalFOV == currentView.verticalFOV) {
+
+		g_RenderJob->complete_view(std::move(*capture));
+
+		if (g_RenderJob->is_finished()) {
+			std::cout << "Render job finished\n";
+			g_RenderJob.reset();
+			return;
+		}
+
+		// NOTE: Reprojection would carry samples over from the previous view
+		g_RayTracingPass->reset_accumulation();
+	}
+
+	const RenderJobView& view = g_RenderJob->get_current_view();
+	camera.set_position(view.position);
+	camera.set_orientation(view.orientation);
+	camera.set_vertical_fov(view.verticalFOV);
+
+	// The frame that reaches the sample count is the one captured
+	if (g_RayTracingPass->get_total_samples_per_pixel() + g_RayTracingPass->m_SamplesPerPixel >= g_RenderJob->get_samples_per_pixel()) {
+		g_RayTracingPass->request_capture();
+	}
+}
+
+INTERNAL void resize_rt_attachments() {
+	const uint32_t width = std::max(static_cast<uint32_t>(g_RTViewportWidth * g_RTResolutionScale), 1u);
+	const uint32_t height = std::max(static_cast<uint32_t>(g_RTViewportHeight * g_RTResolutionScale), 1u);
+
 	// Recreate resources with new sizes
-	auto rtOutput = g_RenderGraph->get_attachment("RTOutput");
-	auto rtAccumulation = g_RenderGraph->get_attachment("RTAccumulation");
-
-	TextureInfo newRtOutputTexInfo = rtOutput->texture.info;
-	newRtOutputTexInfo.width = static_cast<uint32_t>(width);
-	newRtOutputTexInfo.height = static_cast<uint32_t>(height);
-	rtOutput->info.width = newRtOutputTexInfo.width;
-	rtOutput->info.height = newRtOutputTexInfo.height;
-
-	TextureInfo newRtAccumulationTexInfo = rtAccumulation->texture.info;
-	newRtAccumulationTexInfo.width = static_cast<uint32_t>(width);
-	newRtAccumulationTexInfo.height = static_cast<uint32_t>(height);
-	rtAccumulation->info.width = newRtAccumulationTexInfo.width;
-	rtAccumulation->info.height = newRtAccumulationTexInfo.height;
-
-	g_GfxDevice->create_texture(newRtOutputTexInfo, rtOutput->texture, nullptr);
-	g_GfxDevice->create_texture(newRtAccumulationTexInfo, rtAccumulation->texture, nullptr);
-
-	// Update the attachment infos in the render graph
-	rtOutput->currentState = ResourceState::UNORDERED_ACCESS;
-	rtAccumulation->currentState = ResourceState::UNORDERED_ACCESS;
+	const char* rtAttachmentNames[] = {
+		"RTOutput",
+		"RTAccumulation",
+		"RTAccumulationHistory",
+		"RTHitInfo",
+		"RTHitInfoHistory",
+		"RTReservoirs",
+		"RTReservoirsHistory",
+		"RTSurface",
+		"RTSurfaceHistory"
+	};
+
+	for (const char* name : rtAttachmentNames) {
+		auto attachment = g_RenderGraph->get_attachment(name);
+
+		TextureInfo newTexInfo = attachment->texture.info;
+		newTexInfo.width = width;
+		newTexInfo.height = height;
+		attachment->info.width = newTexInfo.width;
+		attachment->info.height = newTexInfo.height;
+
+		g_GfxDevice->create_texture(newTexInfo, attachment->texture, nullptr);
+
+		// Update the attachment infos in the render graph
+		attachment->currentState = ResourceState::UNORDERED_ACCESS;
+	}
+
+	// The history no longer matches the new resolution
+	g_RayTracingPass->reset_accumulation();
 }
 
 INTERNAL void mouse_position_callback(int x, int y) {